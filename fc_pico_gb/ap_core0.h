@@ -28,6 +28,8 @@ void BLINK_LED() {
 
 // 割り込みハンドラ
 void pio0_itr0() {
+	uint32_t t0 = rp2040.getCycleCount();
+
 	// IRQ命令でセットされた値を取得
 	uint32_t irq = pio0_hw->irq;
 	// 各ビットは１書き込む事でクリアできます
@@ -40,6 +42,8 @@ void pio0_itr0() {
 //	BLINK_LED();
 	// 割り込み要求のクリア
 	irq_clear(PIO0_IRQ_0);
+
+	sys.addIrqCycles( rp2040.getCycleCount() - t0 );
 }
 
 void enable_pico_ir() {
@@ -171,6 +175,9 @@ void setup() {
 }
 
 void loop() {
+	// FC commands the IRQ left for the main loop
+	sys.jobRcvQueue();
+
 	if( sys.frame_draw == 0 ) {
 		WDT_update();
 		TRACE(DTR_ROOT)
@@ -178,6 +185,12 @@ void loop() {
 		TRACE(DTR_ROOT)
 		sys.frame_draw++;
 		sys.update();
+#if GB_EMU_MODE
+		// The next GB frame is emulated while this one is shown. Started
+		// after update() so that core1 does not touch the APU registers
+		// while they are sent.
+		gbemu.startFrame();
+#endif
 		TRACE(DTR_ROOT)
 		TRACE_END(DTR_ROOT)
 	}
@@ -8,6 +8,13 @@ void setup1() {
 
 void loop1() {
 	WDT_check();
+#if GB_EMU_MODE && GB_EMU_CORE1
+	// GB emulation: run each frame as soon as core0 starts it
+	if ( !gbemu.serviceFrame() ) {
+		sleep_us( 50 );
+	}
+#else
 	sleep_ms(LOOP_MS);
+#endif
 }
 
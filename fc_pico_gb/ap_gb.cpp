@@ -5,7 +5,10 @@
 #include "ap_gb.h"
 #include "rp_gbemu.h"
 #include "rp_gbapu.h"
+#include "rp_apulog.h"
+#include "rp_wavecache.h"
 #include "rp_system.h"
+#include "rp_dmacopy.h"
 #include "Canvas.h"
 #include "ap_data.h"
 
@@ -39,6 +42,9 @@ static const uint8_t DMG_PALETTE[] = {
 ap_gb ap_g_gb;
 
 void ap_gb::init() {
+    // The Canvas is cleared below, and core1 reads it in convVram()
+    gbemu.waitFrame();
+
     m_sub_state = 0;
     m_frame_count = 0;
     m_status_message = STATUS_NONE;
@@ -46,6 +52,8 @@ void ap_gb::init() {
     // Start with Game palette if available, otherwise DMG green
     m_palette_mode = gbemu.hasGamePalette() ? PALETTE_MODE_GAME : PALETTE_MODE_DMG;
     m_prev_key = 0;
+    m_stat_frames = 0;
+    m_dirty_line_sum = 0;
 
     // Clear FC frame buffer
     uint8_t* fc_fb = c.bitmap();
@@ -62,6 +70,11 @@ void ap_gb::init() {
 
     // Draw border around GB screen area
     drawBorder();
+
+    // GB lines are written straight into the PPU buffer by the emulator,
+    // which also converts the Canvas and publishes each frame
+    sys.setDirectRect(GB_OFFSET_X, GB_OFFSET_Y, GB_LCD_WIDTH, GB_LCD_HEIGHT);
+    sys.setExternalFrames(true);
 }
 
 void ap_gb::main() {
@@ -82,19 +95,19 @@ void ap_gb::main() {
                 m_status_message = STATUS_NO_FS;
                 m_status_display_frames = 60;
             } else if (gbemu.isSaveDirty()) {
+                // saveSave() reads the cart RAM, which core1 writes
+                gbemu.waitFrame();
                 gbemu.saveSave();
                 m_status_message = STATUS_RAM_SAVED;
                 m_status_display_frames = 60;
             }
         }
-
-        // Don't pass SELECT combo buttons to game
-        gbemu.setJoypad(key_now & 0x0F);  // Only pass direction keys
-    } else {
-        // Normal input - pass all keys to game
-        gbemu.setJoypad(key_now);
     }
 
+    // SELECT combo buttons are not passed to the game. With GB_JOYPAD_LATE
+    // the game reads the keys from the FC IRQ instead (latchJoypad()).
+    gbemu.setJoypad(key_now);
+
     // Palette switch: SELECT + LEFT/RIGHT (on key press)
     if ((key_now & KEY_SELECT) && (key_pressed & (KEY_LEFT | KEY_RIGHT))) {
         // Cycle through palette modes
@@ -113,58 +126,79 @@ void ap_gb::main() {
 
     m_prev_key = key_now;
 
-    // Run one frame of GB emulation
-    gbemu.runFrame();
-
-    // APU: Pulse優先更新 (メロディ重視)
-    // Pulse1+Pulse2: 60Hz, Wave+Noise: 20Hz (3フレームに1回)
-    static uint8_t apu_tick = 0;
-    gbapu.updatePulsePriority(apu_tick);
-    apu_tick = (apu_tick + 1) % 3;
+    // The GB frame itself is started after sys.update() (see loop()), and
+    // runs on core1 together with the APU mapping.
 
-    // Render GB frame to FC frame buffer
-    renderToFC();
-
-    // Show status message if active
-    if (m_status_display_frames > 0) {
+    // Show status message if active. The message covers the GB screen, so
+    // the whole Canvas is converted while it is shown. The Canvas is read by
+    // core1, so it only changes between GB frames.
+    if (m_status_display_frames > 0 && !gbemu.isFrameBusy()) {
+        sys.setDirectRect(0, 0, 0, 0);
+        gbemu.pauseDisplay(true);
         drawStatusMessage();
         m_status_display_frames--;
         if (m_status_display_frames == 0) {
             m_status_message = STATUS_NONE;
+            sys.setDirectRect(GB_OFFSET_X, GB_OFFSET_Y, GB_LCD_WIDTH, GB_LCD_HEIGHT);
+            gbemu.pauseDisplay(false);
         }
     }
 
-    m_frame_count++;
-}
-
-void ap_gb::renderToFC() {
-    uint8_t* gb_fb = gbemu.getFrameBuffer();
-    uint8_t* fc_fb = c.bitmap();
-
-    // Copy GB pixels to FC frame buffer with offset
-    for (int y = 0; y < GB_LCD_HEIGHT; y++) {
-        int fc_y = y + GB_OFFSET_Y;
-        uint8_t* src = &gb_fb[y * GB_LCD_WIDTH];
-        uint8_t* dst = &fc_fb[fc_y * CANVAS_WIDTH + GB_OFFSET_X];
-
-        for (int x = 0; x < GB_LCD_WIDTH; x++) {
-            dst[x] = src[x] & 0x03;
-        }
+    // Average number of GB lines converted per frame, frames dropped or
+    // repeated by the PPU triple buffer, GB frame pacing, the FC command
+    // scheduler and the FC IRQ, every 10 seconds with GB_STATS
+#if GB_STATS
+    m_dirty_line_sum += gbemu.getDirtyLines();
+    if (++m_stat_frames == 600) {
+        const rp_gbpace& pace = gbemu.getPace();
+        Serial.printf("GB dirty lines: %lu/%d per frame, frames dropped %lu, repeated %lu\n",
+                      (unsigned long)(m_dirty_line_sum / m_stat_frames), GB_LCD_HEIGHT,
+                      (unsigned long)sys.getFramesDropped(),
+                      (unsigned long)sys.getFramesRepeated());
+        Serial.printf("GB pace: %lu GB / %lu FC frames, idle %lu, double %lu, lost %lu\n",
+                      (unsigned long)pace.getGbFrames(), (unsigned long)pace.getFcFrames(),
+                      (unsigned long)pace.getIdleFrames(), (unsigned long)pace.getDoubleFrames(),
+                      (unsigned long)pace.getLostFrames());
+        Serial.printf("FC commands: extended area %s, PAL/ATR deferred in %lu frames, %lu vsyncs without a frame\n",
+                      sys.isComExt() ? "on" : "off", (unsigned long)sys.getComDeferred(),
+                      (unsigned long)sys.getLinkFramesLost());
+        Serial.printf("FC IRQ: %lu calls, %lu cycles average, %lu max, %lu commands dropped\n",
+                      (unsigned long)sys.getIrqCount(), (unsigned long)sys.getIrqCyclesAvg(),
+                      (unsigned long)sys.getIrqCyclesMax(), (unsigned long)sys.getRcvDropped());
+        sys.resetIrqStats();
+#if GB_INPUT_LATENCY
+        gb_input_stats input = gbemu.takeInputStats();
+        Serial.printf("GB input: %lu key changes, read after %lu us average (%lu max), shown after %lu us (%lu max)\n",
+                      (unsigned long)input.edges, (unsigned long)input.poll_avg,
+                      (unsigned long)input.poll_max, (unsigned long)input.shown_avg,
+                      (unsigned long)input.shown_max);
+#endif
+        uint32_t apu_packets = sys.getApuExtPackets();
+        Serial.printf("FC commands: %lu APU packets, %lu bytes each on average\n",
+                      (unsigned long)apu_packets,
+                      (unsigned long)(apu_packets ? sys.getApuExtBytes() / apu_packets : 0));
+        Serial.printf("GB APU: %lu short notes played, %lu writes not logged\n",
+                      (unsigned long)gbapu.getShortNotes(),
+                      (unsigned long)gbapu.getWriteLog().getLost());
+        Serial.printf("GB APU: wave types %lu cached, %lu analyzed\n",
+                      (unsigned long)gbapu.getWaveCache().getHits(),
+                      (unsigned long)gbapu.getWaveCache().getMisses());
+        m_dirty_line_sum = 0;
+        m_stat_frames = 0;
     }
+#endif
+
+    m_frame_count++;
 }
 
 void ap_gb::drawBorder() {
     uint8_t* fc_fb = c.bitmap();
 
-    // Top border
-    for (int y = 0; y < GB_OFFSET_Y; y++) {
-        memset(&fc_fb[y * CANVAS_WIDTH], 0, CANVAS_WIDTH);
-    }
-
-    // Bottom border
-    for (int y = GB_OFFSET_Y + GB_LCD_HEIGHT; y < CANVAS_HEIGHT; y++) {
-        memset(&fc_fb[y * CANVAS_WIDTH], 0, CANVAS_WIDTH);
-    }
+    // Top and bottom borders are whole lines, filled by DMA while the CPU
+    // does the left and right borders
+    dma_job top = dmaFillAsync(fc_fb, 0, GB_OFFSET_Y * CANVAS_WIDTH);
+    dma_job bottom = dmaFillAsync(&fc_fb[(GB_OFFSET_Y + GB_LCD_HEIGHT) * CANVAS_WIDTH], 0,
+                                  (CANVAS_HEIGHT - GB_OFFSET_Y - GB_LCD_HEIGHT) * CANVAS_WIDTH);
 
     // Left and right borders
     for (int y = GB_OFFSET_Y; y < GB_OFFSET_Y + GB_LCD_HEIGHT; y++) {
@@ -172,6 +206,8 @@ void ap_gb::drawBorder() {
         memset(&fc_fb[y * CANVAS_WIDTH + GB_OFFSET_X + GB_LCD_WIDTH], 0,
                CANVAS_WIDTH - GB_OFFSET_X - GB_LCD_WIDTH);
     }
+    dmaWait(top);
+    dmaWait(bottom);
 
     // Frame around GB screen
     for (int x = GB_OFFSET_X - 1; x <= GB_OFFSET_X + GB_LCD_WIDTH; x++) {
@@ -25,9 +25,6 @@ public:
     void main();
 
 private:
-    // Render GB frame buffer to FC frame buffer
-    void renderToFC();
-
     // Draw border/frame around GB screen
     void drawBorder();
 
@@ -43,6 +40,8 @@ private:
     uint8_t m_status_display_frames;  // Frames remaining to show message
     uint8_t m_palette_mode;          // 0=Game, 1=DMG green, 2=Mono
     uint8_t m_prev_key;              // Previous key state for edge detection
+    uint16_t m_stat_frames;          // Frames counted into the stats below
+    uint32_t m_dirty_line_sum;       // GB lines converted in those frames
 };
 
 extern ap_gb ap_g_gb;
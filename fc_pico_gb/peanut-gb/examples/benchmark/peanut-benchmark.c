@@ -3,7 +3,10 @@
  * Copyright (c) 2018-2023 Mahyar Koshkouei
  *
  * Performs a benchmark of Peanut-GB with a specified ROM.
- * Plays the ROM five times and prints the FPS for each play.
+ * Plays the ROM five times and prints the FPS for each play, followed by the
+ * average. Build with PEANUT_GB_COMPUTED_GOTO=1 to compare opcode dispatch
+ * methods. When idle loop skipping is enabled, the number of skipped loops
+ * and the share of emulated cycles they covered are also printed.
  */
 #ifndef ENABLE_LCD
 # define ENABLE_LCD 1
@@ -140,6 +143,8 @@ int main(int argc, char **argv)
 {
 	/* Must be freed */
 	char *rom_file_name = NULL;
+	const unsigned int runs = 5;
+	double fps_total = 0.0;
 
 	switch(argc)
 	{
@@ -152,7 +157,12 @@ int main(int argc, char **argv)
 			exit(EXIT_FAILURE);
 	}
 
-	for(unsigned int i = 0; i < 5; i++)
+	printf("Dispatch: %s\n",
+		PEANUT_GB_COMPUTED_GOTO ? "computed goto" : "switch");
+	printf("Idle loop skip: %s\n",
+		PEANUT_GB_IDLE_LOOP_SKIP ? "on" : "off");
+
+	for(unsigned int i = 0; i < runs; i++)
 	{
 		/* Start benchmark. */
 		struct gb_s gb;
@@ -203,11 +213,21 @@ int main(int argc, char **argv)
 				(double)(clock() - start_time) / CLOCKS_PER_SEC;
 			double fps = frames / duration;
 			printf("%f FPS, dur: %f\n", fps, duration);
+			fps_total += fps;
 		}
 
+#if PEANUT_GB_IDLE_LOOP_SKIP
+		printf("       idle loops: %lu, skipped: %.2f%% of cycles\n",
+			(unsigned long)gb.idle.hits,
+			100.0 * (double)gb.idle.skipped_cycles /
+				((double)frames * LCD_FRAME_CYCLES));
+#endif
+
 		free(priv.cart_ram);
 		free(priv.rom);
 	}
 
+	printf("Average: %f FPS\n", fps_total / runs);
+
 	return EXIT_SUCCESS;
 }
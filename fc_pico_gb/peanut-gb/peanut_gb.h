@@ -41,7 +41,7 @@
 # define __has_include(x) 0
 #endif
 
-#include <stdlib.h>	/* Required for qsort and abort */
+#include <stdlib.h>	/* Required for abort */
 #include <stdbool.h>	/* Required for bool types */
 #include <stdint.h>	/* Required for int types */
 #include <string.h>	/* Required for memset */
@@ -84,6 +84,13 @@
 # define ENABLE_SOUND 0
 #endif
 
+/* Pass the cycle counter to audio_write() as a third argument, so that the
+ * sound library can place each register write within the frame. The counter
+ * is the value at the start of the writing instruction and wraps around. */
+#ifndef PEANUT_GB_AUDIO_WRITE_CYCLES
+# define PEANUT_GB_AUDIO_WRITE_CYCLES 0
+#endif
+
 /* Enable LCD drawing. On by default. May be turned off for testing purposes. */
 #ifndef ENABLE_LCD
 # define ENABLE_LCD 1
@@ -100,6 +107,35 @@
 # define PEANUT_GB_HIGH_LCD_ACCURACY 1
 #endif
 
+/* Dispatch CPU opcodes through a table of label addresses (computed goto)
+ * instead of a switch statement. Requires the "labels as values" extension
+ * found in GCC and Clang. */
+#ifndef PEANUT_GB_COMPUTED_GOTO
+# define PEANUT_GB_COMPUTED_GOTO 0
+#endif
+#if PEANUT_GB_COMPUTED_GOTO && !defined(__GNUC__)
+# error "PEANUT_GB_COMPUTED_GOTO requires a GCC compatible compiler"
+#endif
+
+/* Skip iterations of short busy-wait loops that poll memory which cannot change
+ * before the next timer or LCD event, such as waiting on LY or a flag set by
+ * an interrupt handler. Emulation results are unchanged. */
+#ifndef PEANUT_GB_IDLE_LOOP_SKIP
+# define PEANUT_GB_IDLE_LOOP_SKIP 1
+#endif
+
+/* Keep a decoded copy of the 384 VRAM tiles, so that __gb_draw_line() does not
+ * extract pixels from the two bitplanes one bit at a time. Costs 6 KiB of RAM
+ * per emulator context, and VRAM writes go through the slow path of
+ * __gb_write(). Off by default; enable where the RAM can be spared. */
+#ifndef PEANUT_GB_TILE_CACHE
+# define PEANUT_GB_TILE_CACHE 0
+#endif
+#if PEANUT_GB_TILE_CACHE && !ENABLE_LCD
+# undef PEANUT_GB_TILE_CACHE
+# define PEANUT_GB_TILE_CACHE 0
+#endif
+
 /* Use intrinsic functions. This may produce smaller and faster code. */
 #ifndef PEANUT_GB_USE_INTRINSICS
 # define PEANUT_GB_USE_INTRINSICS 1
@@ -221,6 +257,8 @@
 #define VRAM_BMAP_2         (0x9C00 - VRAM_ADDR)
 #define VRAM_TILES_3        (0x8000 - VRAM_ADDR + VRAM_BANK_SIZE)
 #define VRAM_TILES_4        (0x8800 - VRAM_ADDR + VRAM_BANK_SIZE)
+/* Number of tiles in 0x8000-0x97FF. */
+#define VRAM_NUM_TILES      384
 
 /* Interrupt jump addresses */
 #define VBLANK_INTR_ADDR    0x0040
@@ -494,6 +532,12 @@ struct count_s
 	uint_fast16_t serial_count;	/* Serial Counter */
 	uint_fast32_t rtc_count;	/* RTC Counter */
 	uint_fast32_t lcd_off_count;	/* Cycles LCD has been disabled */
+
+	/* The counters above are only brought up to date when the next event
+	 * is reached or when the CPU accesses a register depending on them. */
+	uint32_t cycles;		/* Total cycles executed, wraps around */
+	uint32_t sync_cycles;		/* Value of cycles at last update */
+	uint32_t next_event;		/* Value of cycles at next event */
 };
 
 #if ENABLE_LCD
@@ -621,6 +665,18 @@ struct gb_s
 	/* Read byte from boot ROM at given address. */
 	uint8_t (*gb_bootrom_read)(struct gb_s*, const uint_fast16_t addr);
 
+	/* Return the joypad state (as direct.joypad) when the game reads P1.
+	 * NULL when direct.joypad is used. */
+	uint8_t (*gb_joypad_read)(struct gb_s*);
+
+	/* Whole ROM image when set by gb_init_rom_ptr(), otherwise NULL and
+	 * all ROM reads go through gb_rom_read(). */
+	const uint8_t *rom_ptr;
+	uint_fast32_t rom_size;
+	/* Copy of bank 0 set by gb_set_rom_bank0(), otherwise NULL and bank 0
+	 * is read from rom_ptr. */
+	const uint8_t *rom_bank0;
+
 	struct
 	{
 		bool gb_halt	: 1;
@@ -656,12 +712,57 @@ struct gb_s
 	//struct gb_registers_s gb_reg;
 	struct count_s counter;
 
+	/* Memory map with one entry per 4 KiB page of the address space.
+	 * Non-NULL entries point to the host memory backing that page, so
+	 * that the access is a single indexed load or store. NULL entries are
+	 * handled by the slow path in __gb_read() and __gb_write() (cart RAM,
+	 * RTC, OAM, IO). Rebuilt by __gb_update_mem_map(). */
+	const uint8_t *map_read[0x10];
+	uint8_t *map_write[0x10];
+
 	/* TODO: Allow implementation to allocate WRAM, VRAM and Frame Buffer. */
 	uint8_t wram[WRAM_SIZE];
 	uint8_t vram[VRAM_SIZE];
 	uint8_t oam[OAM_SIZE];
 	uint8_t hram_io[HRAM_IO_SIZE];
 
+#if PEANUT_GB_IDLE_LOOP_SKIP
+	/* Idle loop statistics. May be read and cleared by the front-end. */
+	struct
+	{
+		/* Number of times an idle loop was skipped. */
+		uint_fast32_t hits;
+		/* Number of cycles that were not emulated instruction by
+		 * instruction. */
+		uint64_t skipped_cycles;
+	} idle;
+#endif
+
+#if PEANUT_GB_TILE_CACHE
+	/* Decoded tiles. Each row holds the 2-bit colour indices of its 8
+	 * pixels, with the leftmost pixel in bits 15-14. A tile is decoded
+	 * again on first use after a write to its 16 bytes in VRAM. */
+	struct
+	{
+		uint16_t row[VRAM_NUM_TILES][8];
+		uint32_t dirty[VRAM_NUM_TILES / 32];
+	} tile_cache;
+#endif
+
+#if ENABLE_LCD && PEANUT_GB_HIGH_LCD_ACCURACY
+	/* OAM index of the sprites on each line, sorted by X coordinate and
+	 * then OAM index, and limited to MAX_SPRITES_LINE. Rebuilt by
+	 * __gb_update_sprite_lines() when OAM or the sprite size changes. */
+	struct
+	{
+		uint8_t count[LCD_HEIGHT];
+		uint8_t number[LCD_HEIGHT][MAX_SPRITES_LINE];
+		/* Sprite size the lists were built for. Set to 0xFF when OAM
+		 * is written. */
+		uint8_t obj_size;
+	} sprite_lines;
+#endif
+
 	struct
 	{
 		/**
@@ -774,12 +875,292 @@ struct gb_s
 #define IO_STAT_MODE_LCD_DRAW		3
 #define IO_STAT_MODE_VBLANK_OR_TRANSFER_MASK 0x1
 
+/**
+ * Internal function used to rebuild the memory map. Must be called whenever
+ * the selected ROM bank, banking mode or boot ROM state changes.
+ */
+void __gb_update_mem_map(struct gb_s *gb)
+{
+	uint_fast8_t page;
+
+	for(page = 0x0; page <= 0xF; page++)
+	{
+		gb->map_read[page] = NULL;
+		gb->map_write[page] = NULL;
+	}
+
+	/* ROM is mapped only if the front-end supplied a direct pointer with
+	 * gb_init_rom_ptr(). Otherwise it is read through gb_rom_read(). */
+	if(gb->rom_ptr != NULL)
+	{
+		uint_fast32_t bank = gb->selected_rom_bank;
+		const uint8_t *bank0 = gb->rom_bank0 != NULL ?
+				gb->rom_bank0 : gb->rom_ptr;
+
+		/* The boot ROM overlays the start of page 0 until it is
+		 * switched off. */
+		if(gb->hram_io[IO_BOOT] != 0)
+			gb->map_read[0x0] = bank0;
+
+		gb->map_read[0x1] = bank0 + 0x1000;
+		gb->map_read[0x2] = bank0 + 0x2000;
+		gb->map_read[0x3] = bank0 + 0x3000;
+
+		if(gb->mbc == 1 && gb->cart_mode_select)
+			bank &= 0x1F;
+
+		/* Banks outside of the image are left to gb_rom_read(). */
+		if((bank + 1) * ROM_BANK_SIZE <= gb->rom_size)
+		{
+			const uint8_t *base = gb->rom_ptr + bank * ROM_BANK_SIZE;
+
+			gb->map_read[0x4] = base;
+			gb->map_read[0x5] = base + 0x1000;
+			gb->map_read[0x6] = base + 0x2000;
+			gb->map_read[0x7] = base + 0x3000;
+		}
+	}
+
+	gb->map_read[0x8] = &gb->vram[0x0000];
+	gb->map_read[0x9] = &gb->vram[0x1000];
+#if !PEANUT_GB_TILE_CACHE
+	/* With the tile cache, VRAM writes must invalidate the tile. */
+	gb->map_write[0x8] = &gb->vram[0x0000];
+	gb->map_write[0x9] = &gb->vram[0x1000];
+#endif
+	gb->map_read[0xC] = gb->map_write[0xC] = &gb->wram[0x0000];
+	gb->map_read[0xD] = gb->map_write[0xD] = &gb->wram[0x1000];
+	/* Echo RAM. Page 0xF also holds OAM and IO, so it is not mapped. */
+	gb->map_read[0xE] = gb->map_write[0xE] = &gb->wram[0x0000];
+}
+
+/**
+ * Internal function used to bring the DIV, TIMA, serial, RTC and LCD counters
+ * up to date with the cycle counter. Registers that depend on these counters
+ * are only updated here, either when the next scheduled event is reached or
+ * just before the CPU accesses them.
+ */
+void __gb_sync_counters(struct gb_s *gb)
+{
+	static const uint_fast16_t TAC_CYCLES[4] = {1024, 16, 64, 256};
+	const uint_fast32_t elapsed =
+		(uint32_t)(gb->counter.cycles - gb->counter.sync_cycles);
+
+	gb->counter.sync_cycles = gb->counter.cycles;
+
+	/* DIV register timing */
+	gb->counter.div_count += elapsed;
+	gb->hram_io[IO_DIV] += gb->counter.div_count / DIV_CYCLES;
+	gb->counter.div_count %= DIV_CYCLES;
+
+	/* Check for RTC tick. */
+	if(gb->mbc == 3 && (gb->rtc_real.reg.high & 0x40) == 0)
+	{
+		gb->counter.rtc_count += elapsed;
+		while(PGB_UNLIKELY(gb->counter.rtc_count >= RTC_CYCLES))
+		{
+			gb->counter.rtc_count -= RTC_CYCLES;
+
+			/* Detect invalid rollover. */
+			if(PGB_UNLIKELY(gb->rtc_real.reg.sec == 63))
+			{
+				gb->rtc_real.reg.sec = 0;
+				continue;
+			}
+
+			if(++gb->rtc_real.reg.sec != 60)
+				continue;
+
+			gb->rtc_real.reg.sec = 0;
+			if(gb->rtc_real.reg.min == 63)
+			{
+				gb->rtc_real.reg.min = 0;
+				continue;
+			}
+			if(++gb->rtc_real.reg.min != 60)
+				continue;
+
+			gb->rtc_real.reg.min = 0;
+			if(gb->rtc_real.reg.hour == 31)
+			{
+				gb->rtc_real.reg.hour = 0;
+				continue;
+			}
+			if(++gb->rtc_real.reg.hour != 24)
+				continue;
+
+			gb->rtc_real.reg.hour = 0;
+			if(++gb->rtc_real.reg.yday != 0)
+				continue;
+
+			if(gb->rtc_real.reg.high & 1)  /* Bit 8 of days*/
+				gb->rtc_real.reg.high |= 0x80; /* Overflow bit */
+
+			gb->rtc_real.reg.high ^= 1;
+		}
+	}
+
+	/* Check serial transmission. */
+	if(gb->hram_io[IO_SC] & SERIAL_SC_TX_START)
+	{
+		/* If new transfer, call TX function. */
+		if(gb->counter.serial_count == 0 &&
+			gb->gb_serial_tx != NULL)
+			(gb->gb_serial_tx)(gb, gb->hram_io[IO_SB]);
+
+		gb->counter.serial_count += elapsed;
+
+		/* If it's time to receive byte, call RX function. */
+		if(gb->counter.serial_count >= SERIAL_CYCLES)
+		{
+			/* If RX can be done, do it. */
+			/* If RX failed, do not change SB if using external
+			 * clock, or set to 0xFF if using internal clock. */
+			uint8_t rx;
+
+			if(gb->gb_serial_rx != NULL &&
+				(gb->gb_serial_rx(gb, &rx) ==
+					GB_SERIAL_RX_SUCCESS))
+			{
+				gb->hram_io[IO_SB] = rx;
+
+				/* Inform game of serial TX/RX completion. */
+				gb->hram_io[IO_SC] &= 0x01;
+				gb->hram_io[IO_IF] |= SERIAL_INTR;
+			}
+			else if(gb->hram_io[IO_SC] & SERIAL_SC_CLOCK_SRC)
+			{
+				/* If using internal clock, and console is not
+				 * attached to any external peripheral, shifted
+				 * bits are replaced with logic 1. */
+				gb->hram_io[IO_SB] = 0xFF;
+
+				/* Inform game of serial TX/RX completion. */
+				gb->hram_io[IO_SC] &= 0x01;
+				gb->hram_io[IO_IF] |= SERIAL_INTR;
+			}
+			else
+			{
+				/* If using external clock, and console is not
+				 * attached to any external peripheral, bits are
+				 * not shifted, so SB is not modified. */
+			}
+
+			gb->counter.serial_count = 0;
+		}
+	}
+
+	/* TIMA register timing */
+	/* TODO: Change tac_enable to struct of TAC timer control bits. */
+	if(gb->hram_io[IO_TAC] & IO_TAC_ENABLE_MASK)
+	{
+		gb->counter.tima_count += elapsed;
+
+		while(gb->counter.tima_count >=
+			TAC_CYCLES[gb->hram_io[IO_TAC] & IO_TAC_RATE_MASK])
+		{
+			gb->counter.tima_count -=
+				TAC_CYCLES[gb->hram_io[IO_TAC] & IO_TAC_RATE_MASK];
+
+			if(++gb->hram_io[IO_TIMA] == 0)
+			{
+				gb->hram_io[IO_IF] |= TIMER_INTR;
+				/* On overflow, set TMA to TIMA. */
+				gb->hram_io[IO_TIMA] = gb->hram_io[IO_TMA];
+			}
+		}
+	}
+
+	/* LCD Timing */
+	if(gb->hram_io[IO_LCDC] & LCDC_ENABLE)
+		gb->counter.lcd_count += elapsed;
+	else
+		gb->counter.lcd_off_count += elapsed;
+}
+
+/**
+ * Internal function used to schedule the next event: a TIMA overflow, serial
+ * completion, LCD mode change or new line. Until then the CPU is stepped
+ * without any bookkeeping.
+ */
+void __gb_schedule_event(struct gb_s *gb)
+{
+	static const uint_fast16_t TAC_CYCLES[4] = {1024, 16, 64, 256};
+	int_fast32_t next;
+
+	if(gb->hram_io[IO_LCDC] & LCDC_ENABLE)
+	{
+		switch(gb->hram_io[IO_STAT] & STAT_MODE)
+		{
+		case IO_STAT_MODE_OAM_SCAN:
+			next = LCD_MODE2_OAM_SCAN_END;
+			break;
+
+		case IO_STAT_MODE_LCD_DRAW:
+			next = LCD_MODE3_LCD_DRAW_END;
+			break;
+
+		default:
+			next = LCD_LINE_CYCLES;
+			break;
+		}
+
+		next -= gb->counter.lcd_count;
+	}
+	else
+		next = LCD_FRAME_CYCLES - gb->counter.lcd_off_count;
+
+	if(gb->hram_io[IO_SC] & SERIAL_SC_TX_START)
+	{
+		/* A new transfer is started on the next update. */
+		int_fast32_t serial_cycles = 0;
+
+		if(gb->counter.serial_count != 0)
+			serial_cycles = SERIAL_CYCLES - gb->counter.serial_count;
+
+		if(serial_cycles < next)
+			next = serial_cycles;
+	}
+
+	if(gb->hram_io[IO_TAC] & IO_TAC_ENABLE_MASK)
+	{
+		int_fast32_t tima_cycles =
+			(0x100 - gb->hram_io[IO_TIMA]) *
+			TAC_CYCLES[gb->hram_io[IO_TAC] & IO_TAC_RATE_MASK] -
+			gb->counter.tima_count;
+
+		if(tima_cycles < next)
+			next = tima_cycles;
+	}
+
+	if(next < 0)
+		next = 0;
+
+	gb->counter.next_event = gb->counter.sync_cycles + (uint32_t)next;
+}
+
+/**
+ * Internal function used to synchronise the counters before the CPU writes to
+ * a register that changes how they advance, and to re-evaluate the next
+ * event at the end of the current instruction.
+ */
+void __gb_sync_reschedule(struct gb_s *gb)
+{
+	__gb_sync_counters(gb);
+	gb->counter.next_event = gb->counter.cycles;
+}
+
 /**
  * Internal function used to read bytes.
  * addr is host platform endian.
  */
 uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
 {
+	const uint8_t *page = gb->map_read[PEANUT_GB_GET_MSN16(addr)];
+
+	if(PGB_LIKELY(page != NULL))
+		return page[addr & 0x0FFF];
+
 	switch(PEANUT_GB_GET_MSN16(addr))
 	{
 	case 0x0:
@@ -806,10 +1187,6 @@ uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
 		else
 			return gb->gb_rom_read(gb, addr + (gb->selected_rom_bank - 1) * ROM_BANK_SIZE);
 
-	case 0x8:
-	case 0x9:
-		return gb->vram[addr - VRAM_ADDR];
-
 	case 0xA:
 	case 0xB:
 		if(gb->mbc == 3 && gb->cart_ram_bank >= 0x08)
@@ -836,13 +1213,6 @@ uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
 
 		return 0xFF;
 
-	case 0xC:
-	case 0xD:
-		return gb->wram[addr - WRAM_0_ADDR];
-
-	case 0xE:
-		return gb->wram[addr - ECHO_ADDR];
-
 	case 0xF:
 		if(addr < OAM_ADDR)
 			return gb->wram[addr - ECHO_ADDR];
@@ -884,6 +1254,10 @@ uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
 				uint8_t joypad_val = gb->direct.joypad;
 				uint8_t result = 0x0F;
 
+				if(gb->gb_joypad_read != NULL)
+					joypad_val = gb->direct.joypad =
+						gb->gb_joypad_read(gb);
+
 				/* If D-Pad selection line is low, AND the D-pad state */
 				if((p1_val & 0x10) == 0)
 					result &= (joypad_val >> 4) & 0x0F;
@@ -894,6 +1268,11 @@ uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
 
 				return 0xC0 | p1_val | result;
 			}
+
+			/* DIV and TIMA are advanced lazily. */
+			if(addr == 0xFF04 || addr == 0xFF05)
+				__gb_sync_counters(gb);
+
 			return gb->hram_io[addr - IO_ADDR];
 		}
 	}
@@ -909,6 +1288,14 @@ uint8_t __gb_read(struct gb_s *gb, uint16_t addr)
  */
 void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 {
+	uint8_t *page = gb->map_write[PEANUT_GB_GET_MSN16(addr)];
+
+	if(PGB_LIKELY(page != NULL))
+	{
+		page[addr & 0x0FFF] = val;
+		return;
+	}
+
 	switch(PEANUT_GB_GET_MSN16(addr))
 	{
 	case 0x0:
@@ -927,6 +1314,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 			gb->selected_rom_bank = (gb->selected_rom_bank & 0x100) | val;
 			gb->selected_rom_bank =
 				gb->selected_rom_bank & gb->num_rom_banks_mask;
+			__gb_update_mem_map(gb);
 			return;
 		}
 
@@ -968,6 +1356,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 			gb->selected_rom_bank = (val & 0x01) << 8 | (gb->selected_rom_bank & 0xFF);
 
 		gb->selected_rom_bank = gb->selected_rom_bank & gb->num_rom_banks_mask;
+		__gb_update_mem_map(gb);
 		return;
 
 	case 0x4:
@@ -983,22 +1372,35 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 		else if(gb->mbc == 5)
 			gb->cart_ram_bank = (val & 0x0F);
 
+		__gb_update_mem_map(gb);
 		return;
 
 	case 0x6:
 	case 0x7:
 		val &= 1;
 		if(gb->mbc == 3 && val && gb->cart_mode_select == 0)
+		{
+			__gb_sync_counters(gb);
 			memcpy(&gb->rtc_latched.bytes, &gb->rtc_real.bytes, sizeof(gb->rtc_latched.bytes));
+		}
 
 		/* Set banking mode select. */
 		gb->cart_mode_select = val;
+		__gb_update_mem_map(gb);
 		return;
 
+#if PEANUT_GB_TILE_CACHE
 	case 0x8:
 	case 0x9:
-		gb->vram[addr - VRAM_ADDR] = val;
+		addr -= VRAM_ADDR;
+		gb->vram[addr] = val;
+
+		/* Invalidate the decoded tile. Tile maps are not cached. */
+		if(addr < VRAM_NUM_TILES * 0x10)
+			gb->tile_cache.dirty[addr >> 9] |= 1UL << ((addr >> 4) & 31);
+
 		return;
+#endif
 
 	case 0xA:
 	case 0xB:
@@ -1010,6 +1412,8 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 			uint8_t reg = gb->cart_ram_bank - 0x08;
 			//if(reg == 0) gb->counter.rtc_count = 0;
 
+			/* Writing may halt the RTC, so count the time before. */
+			__gb_sync_counters(gb);
 			gb->rtc_real.bytes[reg] = val & rtc_reg_mask[reg];
 		}
 		/* Do not write to RAM if unavailable or disabled. */
@@ -1040,18 +1444,6 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 
 		return;
 
-	case 0xC:
-		gb->wram[addr - WRAM_0_ADDR] = val;
-		return;
-
-	case 0xD:
-		gb->wram[addr - WRAM_1_ADDR + WRAM_BANK_SIZE] = val;
-		return;
-
-	case 0xE:
-		gb->wram[addr - ECHO_ADDR] = val;
-		return;
-
 	case 0xF:
 		if(addr < OAM_ADDR)
 		{
@@ -1062,6 +1454,9 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 		if(addr < UNUSED_ADDR)
 		{
 			gb->oam[addr - OAM_ADDR] = val;
+#if ENABLE_LCD && PEANUT_GB_HIGH_LCD_ACCURACY
+			gb->sprite_lines.obj_size = 0xFF;
+#endif
 			return;
 		}
 
@@ -1077,7 +1472,9 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 
 		if((addr >= 0xFF10) && (addr <= 0xFF3F))
 		{
-#if ENABLE_SOUND
+#if ENABLE_SOUND && PEANUT_GB_AUDIO_WRITE_CYCLES
+			audio_write(addr, val, gb->counter.cycles);
+#elif ENABLE_SOUND
 			audio_write(addr, val);
 #else
 			gb->hram_io[addr - IO_ADDR] = val;
@@ -1110,23 +1507,28 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 			return;
 
 		case 0x02:
+			__gb_sync_reschedule(gb);
 			gb->hram_io[IO_SC] = val;
 			return;
 
 		/* Timer Registers */
 		case 0x04:
+			__gb_sync_reschedule(gb);
 			gb->hram_io[IO_DIV] = 0x00;
 			return;
 
 		case 0x05:
+			__gb_sync_reschedule(gb);
 			gb->hram_io[IO_TIMA] = val;
 			return;
 
 		case 0x06:
+			__gb_sync_reschedule(gb);
 			gb->hram_io[IO_TMA] = val;
 			return;
 
 		case 0x07:
+			__gb_sync_reschedule(gb);
 			gb->hram_io[IO_TAC] = val;
 			return;
 
@@ -1142,6 +1544,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 
 			/* Check if LCD is already enabled. */
 			lcd_enabled = (gb->hram_io[IO_LCDC] & LCDC_ENABLE);
+			__gb_sync_reschedule(gb);
 
 			gb->hram_io[IO_LCDC] = val;
 
@@ -1204,6 +1607,10 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 				gb->oam[i] = __gb_read(gb, dma_addr + i);
 			}
 
+#if ENABLE_LCD && PEANUT_GB_HIGH_LCD_ACCURACY
+			gb->sprite_lines.obj_size = 0xFF;
+#endif
+
 			return;
 		}
 
@@ -1244,6 +1651,7 @@ void __gb_write(struct gb_s *gb, uint_fast16_t addr, uint8_t val)
 		/* Turn off boot ROM */
 		case 0x50:
 			gb->hram_io[IO_BOOT] = 0x01;
+			__gb_update_mem_map(gb);
 			return;
 
 		/* Interrupt Enable Register */
@@ -1445,30 +1853,131 @@ uint8_t __gb_execute_cb(struct gb_s *gb)
 }
 
 #if ENABLE_LCD
-struct sprite_data {
-	uint8_t sprite_number;
-	uint8_t x;
-};
-
 #if PEANUT_GB_HIGH_LCD_ACCURACY
-static int compare_sprites(const void *in1, const void *in2)
+/**
+ * Internal function used to sort the sprites on each line by X coordinate and
+ * OAM index, keeping the first MAX_SPRITES_LINE of each line. Called before
+ * drawing a line after OAM or the sprite size changed, so that this is
+ * usually done once per frame instead of once per line.
+ */
+void __gb_update_sprite_lines(struct gb_s *gb)
+{
+	const uint8_t obj_size = gb->hram_io[IO_LCDC] & LCDC_OBJ_SIZE;
+	const int_fast16_t height = obj_size ? 16 : 8;
+	uint8_t order[NUM_SPRITES];
+	uint_fast8_t i;
+
+	/* Insertion sort by X coordinate. Sprites with the same X coordinate
+	 * stay in OAM order. */
+	for(i = 0; i < NUM_SPRITES; i++)
+	{
+		const uint8_t OX = gb->oam[4 * i + 1];
+		uint_fast8_t n = i;
+
+		while(n > 0 && gb->oam[4 * order[n - 1] + 1] > OX)
+		{
+			order[n] = order[n - 1];
+			n--;
+		}
+
+		order[n] = i;
+	}
+
+	memset(gb->sprite_lines.count, 0, sizeof(gb->sprite_lines.count));
+
+	for(i = 0; i < NUM_SPRITES; i++)
+	{
+		const uint8_t s = order[i];
+		/* A sprite covers lines OY - 16 to OY - 16 + height - 1. */
+		int_fast16_t ly = (int_fast16_t)gb->oam[4 * s + 0] - 16;
+		int_fast16_t end = ly + height;
+
+		if(ly < 0)
+			ly = 0;
+		if(end > LCD_HEIGHT)
+			end = LCD_HEIGHT;
+
+		for(; ly < end; ly++)
+		{
+			uint8_t *count = &gb->sprite_lines.count[ly];
+
+			if(*count < MAX_SPRITES_LINE)
+				gb->sprite_lines.number[ly][(*count)++] = s;
+		}
+	}
+
+	gb->sprite_lines.obj_size = obj_size;
+}
+#endif
+
+#if PEANUT_GB_TILE_CACHE
+/**
+ * Internal function used to return row py of a tile, decoding the tile first
+ * if VRAM changed since it was last used.
+ *
+ * \param tile	Tile number, where 0 is at 0x8000 and 383 is at 0x97F0.
+ * \param py	Row of the tile, 0-7.
+ */
+uint_fast16_t __gb_tile_row(struct gb_s *gb, uint_fast16_t tile,
+		uint_fast8_t py)
 {
-	const struct sprite_data *sd1, *sd2;
-	int x_res;
+	uint32_t *dirty = &gb->tile_cache.dirty[tile >> 5];
+	const uint32_t bit = 1UL << (tile & 31);
+
+	if(PGB_UNLIKELY(*dirty & bit))
+	{
+		const uint8_t *t = &gb->vram[VRAM_TILES_1 + tile * 0x10];
+		uint_fast8_t y;
 
-	sd1 = (struct sprite_data *)in1;
-	sd2 = (struct sprite_data *)in2;
-	x_res = (int)sd1->x - (int)sd2->x;
-	if(x_res != 0)
-		return x_res;
+		for(y = 0; y < 8; y++)
+		{
+			/* Interleave the low and high bitplanes, so that bit n
+			 * of each plane becomes bits 2n+1 and 2n. */
+			uint_fast16_t lo = t[2 * y];
+			uint_fast16_t hi = t[2 * y + 1];
+
+			lo = (lo | (lo << 4)) & 0x0F0F;
+			lo = (lo | (lo << 2)) & 0x3333;
+			lo = (lo | (lo << 1)) & 0x5555;
+			hi = (hi | (hi << 4)) & 0x0F0F;
+			hi = (hi | (hi << 2)) & 0x3333;
+			hi = (hi | (hi << 1)) & 0x5555;
+			gb->tile_cache.row[tile][y] = lo | (hi << 1);
+		}
+
+		*dirty &= ~bit;
+	}
+
+	return gb->tile_cache.row[tile][py];
+}
 
-	return (int)sd1->sprite_number - (int)sd2->sprite_number;
+/**
+ * Internal function used to write the 8 pixels of a decoded tile row with the
+ * given palette.
+ */
+void __gb_draw_tile_row(uint8_t *dst, uint_fast16_t row, const uint8_t *pal)
+{
+	dst[0] = pal[(row >> 14) & 0x3];
+	dst[1] = pal[(row >> 12) & 0x3];
+	dst[2] = pal[(row >> 10) & 0x3];
+	dst[3] = pal[(row >> 8) & 0x3];
+	dst[4] = pal[(row >> 6) & 0x3];
+	dst[5] = pal[(row >> 4) & 0x3];
+	dst[6] = pal[(row >> 2) & 0x3];
+	dst[7] = pal[row & 0x3];
 }
 #endif
 
 void __gb_draw_line(struct gb_s *gb)
 {
+#if PEANUT_GB_TILE_CACHE
+	/* Whole tiles are drawn, so allow them to overhang both edges. */
+	uint8_t line[8 + LCD_WIDTH + 8] = {0};
+	uint8_t *const pixels = &line[8];
+	uint8_t pal[4];
+#else
 	uint8_t pixels[160] = {0};
+#endif
 
 	/* If LCD not initialised by front-end, don't render anything. */
 	if(gb->display.lcd_draw_line == NULL)
@@ -1496,9 +2005,47 @@ void __gb_draw_line(struct gb_s *gb)
 		}
 	}
 
+#if PEANUT_GB_TILE_CACHE
+	/* Background and window use the same palette. */
+# if PEANUT_GB_12_COLOUR
+	pal[0] = gb->display.bg_palette[0] | LCD_PALETTE_BG;
+	pal[1] = gb->display.bg_palette[1] | LCD_PALETTE_BG;
+	pal[2] = gb->display.bg_palette[2] | LCD_PALETTE_BG;
+	pal[3] = gb->display.bg_palette[3] | LCD_PALETTE_BG;
+# else
+	memcpy(pal, gb->display.bg_palette, sizeof(pal));
+# endif
+#endif
+
 	/* If background is enabled, draw it. */
 	if(gb->hram_io[IO_LCDC] & LCDC_BG_ENABLE)
 	{
+#if PEANUT_GB_TILE_CACHE
+		const uint8_t bg_y = gb->hram_io[IO_LY] + gb->hram_io[IO_SCY];
+		const uint8_t bg_x = gb->hram_io[IO_SCX];
+		const uint16_t bg_map =
+			((gb->hram_io[IO_LCDC] & LCDC_BG_MAP) ?
+			 VRAM_BMAP_2 : VRAM_BMAP_1)
+			+ (bg_y >> 3) * 0x20;
+		/* The first tile may start up to 7 pixels left of the
+		 * screen, so 21 tiles cover the line. */
+		uint8_t *dst = pixels - (bg_x & 0x07);
+		uint_fast8_t n;
+
+		for(n = 0; n <= LCD_WIDTH / 8; n++, dst += 8)
+		{
+			uint8_t idx = gb->vram[bg_map + (((bg_x >> 3) + n) & 0x1F)];
+			uint_fast16_t tile;
+
+			if(gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT)
+				tile = idx;
+			else
+				tile = 0x100 + (int8_t)idx;
+
+			__gb_draw_tile_row(dst,
+				__gb_tile_row(gb, tile, bg_y & 0x07), pal);
+		}
+#else
 		uint8_t bg_y, disp_x, bg_x, idx, py, px, t1, t2;
 		uint16_t bg_map, tile;
 
@@ -1573,6 +2120,7 @@ void __gb_draw_line(struct gb_s *gb)
 			t2 = t2 >> 1;
 			px++;
 		}
+#endif
 	}
 
 	/* draw window */
@@ -1580,6 +2128,31 @@ void __gb_draw_line(struct gb_s *gb)
 			&& gb->hram_io[IO_LY] >= gb->display.WY
 			&& gb->hram_io[IO_WX] <= 166)
 	{
+#if PEANUT_GB_TILE_CACHE
+		const uint16_t win_line =
+			((gb->hram_io[IO_LCDC] & LCDC_WINDOW_MAP) ?
+			 VRAM_BMAP_2 : VRAM_BMAP_1)
+			+ (gb->display.window_clear >> 3) * 0x20;
+		/* The window starts at WX - 7, which may be left of the
+		 * screen. */
+		int_fast16_t x = (int_fast16_t)gb->hram_io[IO_WX] - 7;
+		uint_fast8_t n;
+
+		for(n = 0; x < LCD_WIDTH; n++, x += 8)
+		{
+			uint8_t idx = gb->vram[win_line + n];
+			uint_fast16_t tile;
+
+			if(gb->hram_io[IO_LCDC] & LCDC_TILE_SELECT)
+				tile = idx;
+			else
+				tile = 0x100 + (int8_t)idx;
+
+			__gb_draw_tile_row(&pixels[x],
+				__gb_tile_row(gb, tile,
+					gb->display.window_clear & 0x07), pal);
+		}
+#else
 		uint16_t win_line, tile;
 		uint8_t disp_x, win_x, py, px, idx, t1, t2, end;
 
@@ -1641,6 +2214,7 @@ void __gb_draw_line(struct gb_s *gb)
 			t2 = t2 >> 1;
 			px++;
 		}
+#endif
 
 		gb->display.window_clear++; // advance window line
 	}
@@ -1650,40 +2224,19 @@ void __gb_draw_line(struct gb_s *gb)
 	{
 		uint8_t sprite_number;
 #if PEANUT_GB_HIGH_LCD_ACCURACY
-		uint8_t number_of_sprites = 0;
-
-		struct sprite_data sprites_to_render[NUM_SPRITES];
-
-		/* Record number of sprites on the line being rendered, limited
-		 * to the maximum number sprites that the Game Boy is able to
-		 * render on each line (10 sprites). */
-		for(sprite_number = 0;
-				sprite_number < PEANUT_GB_ARRAYSIZE(sprites_to_render);
-				sprite_number++)
-		{
-			/* Sprite Y position. */
-			uint8_t OY = gb->oam[4 * sprite_number + 0];
-			/* Sprite X position. */
-			uint8_t OX = gb->oam[4 * sprite_number + 1];
-
-			/* If sprite isn't on this line, continue. */
-			if (gb->hram_io[IO_LY] +
-				(gb->hram_io[IO_LCDC] & LCDC_OBJ_SIZE ? 0 : 8) >= OY
-					|| gb->hram_io[IO_LY] + 16 < OY)
-				continue;
-
-
-			sprites_to_render[number_of_sprites].sprite_number = sprite_number;
-			sprites_to_render[number_of_sprites].x = OX;
-			number_of_sprites++;
-		}
-
-		/* If maximum number of sprites reached, prioritise X
-		 * coordinate and object location in OAM. */
-		qsort(&sprites_to_render[0], number_of_sprites,
-				sizeof(sprites_to_render[0]), compare_sprites);
-		if(number_of_sprites > MAX_SPRITES_LINE)
-			number_of_sprites = MAX_SPRITES_LINE;
+		const uint8_t *sprites_to_render;
+		uint8_t number_of_sprites;
+
+		/* The sprites on each line, limited to the maximum number of
+		 * sprites that the Game Boy is able to render on each line
+		 * (10 sprites), prioritised by X coordinate and object
+		 * location in OAM. */
+		if(gb->sprite_lines.obj_size !=
+				(gb->hram_io[IO_LCDC] & LCDC_OBJ_SIZE))
+			__gb_update_sprite_lines(gb);
+
+		sprites_to_render = gb->sprite_lines.number[gb->hram_io[IO_LY]];
+		number_of_sprites = gb->sprite_lines.count[gb->hram_io[IO_LY]];
 #endif
 
 		/* Render each sprite, from low priority to high priority. */
@@ -1693,7 +2246,7 @@ void __gb_draw_line(struct gb_s *gb)
 				sprite_number != 0xFF;
 				sprite_number--)
 		{
-			uint8_t s = sprites_to_render[sprite_number].sprite_number;
+			uint8_t s = sprites_to_render[sprite_number];
 #else
 		for (sprite_number = NUM_SPRITES - 1;
 			sprite_number != 0xFF;
@@ -1701,7 +2254,12 @@ void __gb_draw_line(struct gb_s *gb)
 		{
 			uint8_t s = sprite_number;
 #endif
-			uint8_t py, t1, t2, dir, start, end, shift, disp_x;
+			uint8_t py, dir, start, end, shift, disp_x;
+#if PEANUT_GB_TILE_CACHE
+			uint_fast16_t row;
+#else
+			uint8_t t1, t2;
+#endif
 			/* Sprite Y position. */
 			uint8_t OY = gb->oam[4 * s + 0];
 			/* Sprite X position. */
@@ -1731,8 +2289,16 @@ void __gb_draw_line(struct gb_s *gb)
 				py = (gb->hram_io[IO_LCDC] & LCDC_OBJ_SIZE ? 15 : 7) - py;
 
 			// fetch the tile
+#if PEANUT_GB_TILE_CACHE
+			row = __gb_tile_row(gb, OT + (py >> 3), py & 0x07);
+
+			/* Skip fully transparent rows. */
+			if(row == 0)
+				continue;
+#else
 			t1 = gb->vram[VRAM_TILES_1 + OT * 0x10 + 2 * py];
 			t2 = gb->vram[VRAM_TILES_1 + OT * 0x10 + 2 * py + 1];
+#endif
 
 			// handle x flip
 			if(OF & OBJ_FLIP_X)
@@ -1751,15 +2317,23 @@ void __gb_draw_line(struct gb_s *gb)
 			}
 
 			// copy tile
+#if PEANUT_GB_TILE_CACHE
+			row >>= 2 * shift;
+#else
 			t1 >>= shift;
 			t2 >>= shift;
+#endif
 
 			/* TODO: Put for loop within the to if statements
 			 * because the BG priority bit will be the same for
 			 * all the pixels in the tile. */
 			for(disp_x = start; disp_x != end; disp_x += dir)
 			{
+#if PEANUT_GB_TILE_CACHE
+				uint8_t c = row & 0x3;
+#else
 				uint8_t c = (t1 & 0x1) | ((t2 & 0x1) << 1);
+#endif
 				// check transparency / sprite overlap / background overlap
 
 				if(c && !(OF & OBJ_PRIORITY && !((pixels[disp_x] & 0x3) == gb->display.bg_palette[0])))
@@ -1774,8 +2348,12 @@ void __gb_draw_line(struct gb_s *gb)
 #endif
 				}
 
+#if PEANUT_GB_TILE_CACHE
+				row >>= 2;
+#else
 				t1 = t1 >> 1;
 				t2 = t2 >> 1;
+#endif
 			}
 		}
 	}
@@ -1784,6 +2362,236 @@ void __gb_draw_line(struct gb_s *gb)
 }
 #endif
 
+#if PEANUT_GB_IDLE_LOOP_SKIP
+/**
+ * Internal function used to check whether a busy-wait loop may read from the
+ * given address. WRAM, VRAM and HRAM only change when the CPU writes to them.
+ * LY, STAT and IF only change on scheduled events.
+ */
+bool __gb_idle_addr(uint_fast16_t addr)
+{
+	return (addr >= VRAM_ADDR && addr < CART_RAM_ADDR) ||
+		(addr >= WRAM_0_ADDR && addr < OAM_ADDR) ||
+		(addr >= HRAM_ADDR && addr < INTR_EN_ADDR) ||
+		addr == 0xFF00 + IO_LY || addr == 0xFF00 + IO_STAT ||
+		addr == 0xFF00 + IO_IF;
+}
+
+/**
+ * Internal function used to return register r of an 8-bit ALU or CB opcode.
+ * Returns false for (HL).
+ */
+bool __gb_idle_reg(struct gb_s *gb, uint8_t r, uint8_t *val)
+{
+	switch(r & 0x07)
+	{
+	case 0: *val = gb->cpu_reg.bc.bytes.b; return true;
+	case 1: *val = gb->cpu_reg.bc.bytes.c; return true;
+	case 2: *val = gb->cpu_reg.de.bytes.d; return true;
+	case 3: *val = gb->cpu_reg.de.bytes.e; return true;
+	case 4: *val = gb->cpu_reg.hl.bytes.h; return true;
+	case 5: *val = gb->cpu_reg.hl.bytes.l; return true;
+	case 7: *val = gb->cpu_reg.a; return true;
+	default: return false;
+	}
+}
+
+/**
+ * Internal function called when a JR jumps backwards. If the loop body only
+ * loads A from memory that is stable until the next event and tests it, every
+ * iteration until then is identical. Those iterations are skipped by advancing
+ * the cycle counter.
+ *
+ * \param jr_addr	Address of the JR opcode, which ends the loop.
+ * \param jr_cycles	Cycles taken by the JR.
+ */
+void __gb_idle_loop_skip(struct gb_s *gb, uint_fast16_t jr_addr,
+		uint_fast16_t jr_cycles)
+{
+	const uint8_t jr_op = __gb_read(gb, jr_addr);
+	const uint8_t a = gb->cpu_reg.a;
+	const uint8_t f = gb->cpu_reg.f.reg;
+	const uint32_t now = gb->counter.cycles + jr_cycles;
+	uint_fast16_t loop_cycles = 0;
+	uint32_t iterations;
+	uint_fast8_t pass;
+
+	if(jr_addr - gb->cpu_reg.pc.reg > 16)
+		return;
+
+	/* An interrupt is taken before the next iteration. */
+	if(gb->gb_ime && (gb->hram_io[IO_IF] & gb->hram_io[IO_IE] & ANY_INTR))
+		return;
+
+	if((int32_t)(gb->counter.next_event - now) <= 0)
+		return;
+
+	/* Run the loop body twice. Both passes must take the branch and leave
+	 * A and F the same, so that all following iterations are identical. */
+	for(pass = 0; pass < 2; pass++)
+	{
+		const uint8_t pass_a = gb->cpu_reg.a;
+		const uint8_t pass_f = gb->cpu_reg.f.reg;
+		uint_fast16_t pc = gb->cpu_reg.pc.reg;
+		bool taken;
+
+		loop_cycles = jr_cycles;
+
+		while(pc < jr_addr)
+		{
+			uint_fast16_t addr;
+			uint8_t op = __gb_read(gb, pc++);
+			uint8_t val;
+
+			switch(op)
+			{
+			case 0x0A: /* LD A, (BC) */
+			case 0x1A: /* LD A, (DE) */
+			case 0x7E: /* LD A, (HL) */
+				addr = (op == 0x0A) ? gb->cpu_reg.bc.reg :
+					(op == 0x1A) ? gb->cpu_reg.de.reg :
+					gb->cpu_reg.hl.reg;
+				if(!__gb_idle_addr(addr))
+					goto not_idle;
+				gb->cpu_reg.a = __gb_read(gb, addr);
+				loop_cycles += 8;
+				break;
+
+			case 0xF0: /* LD A, (0xFF00+imm) */
+				addr = 0xFF00 | __gb_read(gb, pc++);
+				if(!__gb_idle_addr(addr))
+					goto not_idle;
+				gb->cpu_reg.a = __gb_read(gb, addr);
+				loop_cycles += 12;
+				break;
+
+			case 0xF2: /* LD A, (C) */
+				addr = 0xFF00 | gb->cpu_reg.bc.bytes.c;
+				if(!__gb_idle_addr(addr))
+					goto not_idle;
+				gb->cpu_reg.a = __gb_read(gb, addr);
+				loop_cycles += 8;
+				break;
+
+			case 0xFA: /* LD A, (imm) */
+				addr = __gb_read(gb, pc++);
+				addr |= __gb_read(gb, pc++) << 8;
+				if(!__gb_idle_addr(addr))
+					goto not_idle;
+				gb->cpu_reg.a = __gb_read(gb, addr);
+				loop_cycles += 16;
+				break;
+
+			case 0xE6: /* AND imm */
+				val = __gb_read(gb, pc++);
+				PGB_INSTR_AND_R8(val);
+				loop_cycles += 8;
+				break;
+
+			case 0xEE: /* XOR imm */
+				val = __gb_read(gb, pc++);
+				PGB_INSTR_XOR_R8(val);
+				loop_cycles += 8;
+				break;
+
+			case 0xF6: /* OR imm */
+				val = __gb_read(gb, pc++);
+				PGB_INSTR_OR_R8(val);
+				loop_cycles += 8;
+				break;
+
+			case 0xFE: /* CP imm */
+				val = __gb_read(gb, pc++);
+				PGB_INSTR_CP_R8(val);
+				loop_cycles += 8;
+				break;
+
+			case 0xCB: /* BIT b, r */
+				op = __gb_read(gb, pc++);
+				if(op < 0x40 || op > 0x7F ||
+						!__gb_idle_reg(gb, op, &val))
+					goto not_idle;
+				gb->cpu_reg.f.f_bits.z = !((val >> ((op >> 3) & 0x07)) & 1);
+				gb->cpu_reg.f.f_bits.n = 0;
+				gb->cpu_reg.f.f_bits.h = 1;
+				loop_cycles += 8;
+				break;
+
+			default:
+				/* AND, XOR, OR or CP with a register. */
+				if(op < 0xA0 || op > 0xBF ||
+						!__gb_idle_reg(gb, op, &val))
+					goto not_idle;
+
+				switch(op & 0x18)
+				{
+				case 0x00:
+					PGB_INSTR_AND_R8(val);
+					break;
+				case 0x08:
+					PGB_INSTR_XOR_R8(val);
+					break;
+				case 0x10:
+					PGB_INSTR_OR_R8(val);
+					break;
+				default:
+					PGB_INSTR_CP_R8(val);
+					break;
+				}
+				loop_cycles += 4;
+				break;
+			}
+		}
+
+		/* An instruction overlaps the JR. */
+		if(pc != jr_addr)
+			goto not_idle;
+
+		switch(jr_op)
+		{
+		case 0x20: taken = !gb->cpu_reg.f.f_bits.z; break;
+		case 0x28: taken = gb->cpu_reg.f.f_bits.z; break;
+		case 0x30: taken = !gb->cpu_reg.f.f_bits.c; break;
+		case 0x38: taken = gb->cpu_reg.f.f_bits.c; break;
+		default: taken = true; break;
+		}
+
+		if(!taken)
+			goto not_idle;
+
+		if(pass == 1 && (gb->cpu_reg.a != pass_a ||
+				gb->cpu_reg.f.reg != pass_f))
+			goto not_idle;
+	}
+
+	/* Every instruction of the skipped iterations must finish before the
+	 * next event. */
+	iterations = (gb->counter.next_event - now - 1) / loop_cycles;
+	if(iterations == 0)
+		goto not_idle;
+
+	gb->counter.cycles += iterations * loop_cycles;
+	gb->idle.hits++;
+	gb->idle.skipped_cycles += iterations * loop_cycles;
+	return;
+
+not_idle:
+	gb->cpu_reg.a = a;
+	gb->cpu_reg.f.reg = f;
+}
+#endif
+
+/* Opcode handler labels. With PEANUT_GB_COMPUTED_GOTO each handler is a label
+ * in a dispatch table and loads its own cycle count as a constant, instead of
+ * going through the switch statement and the op_cycles[] lookup. */
+#if PEANUT_GB_COMPUTED_GOTO
+# define PGB_OP(op)	op_##op: inst_cycles = op_cycles[op];
+# define PGB_OP_INVALID	op_invalid:
+#else
+# define PGB_OP(op)	case op:
+# define PGB_OP_INVALID	default:
+#endif
+
 /**
  * Internal function used to step the CPU.
  */
@@ -1814,6 +2622,77 @@ void __gb_step_cpu(struct gb_s *gb)
 		/* *INDENT-ON* */
 	};
 	static const uint_fast16_t TAC_CYCLES[4] = {1024, 16, 64, 256};
+#if PEANUT_GB_COMPUTED_GOTO
+	static const void *const op_dispatch[0x100] =
+	{
+		/* *INDENT-OFF* */
+		&&op_0x00, &&op_0x01, &&op_0x02, &&op_0x03,
+		&&op_0x04, &&op_0x05, &&op_0x06, &&op_0x07,
+		&&op_0x08, &&op_0x09, &&op_0x0A, &&op_0x0B,
+		&&op_0x0C, &&op_0x0D, &&op_0x0E, &&op_0x0F,
+		&&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13,
+		&&op_0x14, &&op_0x15, &&op_0x16, &&op_0x17,
+		&&op_0x18, &&op_0x19, &&op_0x1A, &&op_0x1B,
+		&&op_0x1C, &&op_0x1D, &&op_0x1E, &&op_0x1F,
+		&&op_0x20, &&op_0x21, &&op_0x22, &&op_0x23,
+		&&op_0x24, &&op_0x25, &&op_0x26, &&op_0x27,
+		&&op_0x28, &&op_0x29, &&op_0x2A, &&op_0x2B,
+		&&op_0x2C, &&op_0x2D, &&op_0x2E, &&op_0x2F,
+		&&op_0x30, &&op_0x31, &&op_0x32, &&op_0x33,
+		&&op_0x34, &&op_0x35, &&op_0x36, &&op_0x37,
+		&&op_0x38, &&op_0x39, &&op_0x3A, &&op_0x3B,
+		&&op_0x3C, &&op_0x3D, &&op_0x3E, &&op_0x3F,
+		&&op_0x40, &&op_0x41, &&op_0x42, &&op_0x43,
+		&&op_0x44, &&op_0x45, &&op_0x46, &&op_0x47,
+		&&op_0x48, &&op_0x49, &&op_0x4A, &&op_0x4B,
+		&&op_0x4C, &&op_0x4D, &&op_0x4E, &&op_0x4F,
+		&&op_0x50, &&op_0x51, &&op_0x52, &&op_0x53,
+		&&op_0x54, &&op_0x55, &&op_0x56, &&op_0x57,
+		&&op_0x58, &&op_0x59, &&op_0x5A, &&op_0x5B,
+		&&op_0x5C, &&op_0x5D, &&op_0x5E, &&op_0x5F,
+		&&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63,
+		&&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67,
+		&&op_0x68, &&op_0x69, &&op_0x6A, &&op_0x6B,
+		&&op_0x6C, &&op_0x6D, &&op_0x6E, &&op_0x6F,
+		&&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73,
+		&&op_0x74, &&op_0x75, &&op_0x76, &&op_0x77,
+		&&op_0x78, &&op_0x79, &&op_0x7A, &&op_0x7B,
+		&&op_0x7C, &&op_0x7D, &&op_0x7E, &&op_0x7F,
+		&&op_0x80, &&op_0x81, &&op_0x82, &&op_0x83,
+		&&op_0x84, &&op_0x85, &&op_0x86, &&op_0x87,
+		&&op_0x88, &&op_0x89, &&op_0x8A, &&op_0x8B,
+		&&op_0x8C, &&op_0x8D, &&op_0x8E, &&op_0x8F,
+		&&op_0x90, &&op_0x91, &&op_0x92, &&op_0x93,
+		&&op_0x94, &&op_0x95, &&op_0x96, &&op_0x97,
+		&&op_0x98, &&op_0x99, &&op_0x9A, &&op_0x9B,
+		&&op_0x9C, &&op_0x9D, &&op_0x9E, &&op_0x9F,
+		&&op_0xA0, &&op_0xA1, &&op_0xA2, &&op_0xA3,
+		&&op_0xA4, &&op_0xA5, &&op_0xA6, &&op_0xA7,
+		&&op_0xA8, &&op_0xA9, &&op_0xAA, &&op_0xAB,
+		&&op_0xAC, &&op_0xAD, &&op_0xAE, &&op_0xAF,
+		&&op_0xB0, &&op_0xB1, &&op_0xB2, &&op_0xB3,
+		&&op_0xB4, &&op_0xB5, &&op_0xB6, &&op_0xB7,
+		&&op_0xB8, &&op_0xB9, &&op_0xBA, &&op_0xBB,
+		&&op_0xBC, &&op_0xBD, &&op_0xBE, &&op_0xBF,
+		&&op_0xC0, &&op_0xC1, &&op_0xC2, &&op_0xC3,
+		&&op_0xC4, &&op_0xC5, &&op_0xC6, &&op_0xC7,
+		&&op_0xC8, &&op_0xC9, &&op_0xCA, &&op_0xCB,
+		&&op_0xCC, &&op_0xCD, &&op_0xCE, &&op_0xCF,
+		&&op_0xD0, &&op_0xD1, &&op_0xD2, &&op_invalid,
+		&&op_0xD4, &&op_0xD5, &&op_0xD6, &&op_0xD7,
+		&&op_0xD8, &&op_0xD9, &&op_0xDA, &&op_invalid,
+		&&op_0xDC, &&op_invalid, &&op_0xDE, &&op_0xDF,
+		&&op_0xE0, &&op_0xE1, &&op_0xE2, &&op_invalid,
+		&&op_invalid, &&op_0xE5, &&op_0xE6, &&op_0xE7,
+		&&op_0xE8, &&op_0xE9, &&op_0xEA, &&op_invalid,
+		&&op_invalid, &&op_invalid, &&op_0xEE, &&op_0xEF,
+		&&op_0xF0, &&op_0xF1, &&op_0xF2, &&op_0xF3,
+		&&op_invalid, &&op_0xF5, &&op_0xF6, &&op_0xF7,
+		&&op_0xF8, &&op_0xF9, &&op_0xFA, &&op_0xFB,
+		&&op_invalid, &&op_invalid, &&op_0xFE, &&op_0xFF
+		/* *INDENT-ON* */
+	};
+#endif
 
 	/* Handle interrupts */
 	/* If gb_halt is positive, then an interrupt must have occurred by the
@@ -1866,46 +2745,51 @@ void __gb_step_cpu(struct gb_s *gb)
 
 	/* Obtain opcode */
 	opcode = __gb_read(gb, gb->cpu_reg.pc.reg++);
-	inst_cycles = op_cycles[opcode];
 
 	/* Execute opcode */
+#if PEANUT_GB_COMPUTED_GOTO
+	goto *op_dispatch[opcode];
+	do
+#else
+	inst_cycles = op_cycles[opcode];
 	switch(opcode)
+#endif
 	{
-	case 0x00: /* NOP */
+	PGB_OP(0x00) /* NOP */
 		break;
 
-	case 0x01: /* LD BC, imm */
+	PGB_OP(0x01) /* LD BC, imm */
 		gb->cpu_reg.bc.bytes.c = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		gb->cpu_reg.bc.bytes.b = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x02: /* LD (BC), A */
+	PGB_OP(0x02) /* LD (BC), A */
 		__gb_write(gb, gb->cpu_reg.bc.reg, gb->cpu_reg.a);
 		break;
 
-	case 0x03: /* INC BC */
+	PGB_OP(0x03) /* INC BC */
 		gb->cpu_reg.bc.reg++;
 		break;
 
-	case 0x04: /* INC B */
+	PGB_OP(0x04) /* INC B */
 		PGB_INSTR_INC_R8(gb->cpu_reg.bc.bytes.b);
 		break;
 
-	case 0x05: /* DEC B */
+	PGB_OP(0x05) /* DEC B */
 		PGB_INSTR_DEC_R8(gb->cpu_reg.bc.bytes.b);
 		break;
 
-	case 0x06: /* LD B, imm */
+	PGB_OP(0x06) /* LD B, imm */
 		gb->cpu_reg.bc.bytes.b = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x07: /* RLCA */
+	PGB_OP(0x07) /* RLCA */
 		gb->cpu_reg.a = (gb->cpu_reg.a << 1) | (gb->cpu_reg.a >> 7);
 		gb->cpu_reg.f.reg = 0;
 		gb->cpu_reg.f.f_bits.c = (gb->cpu_reg.a & 0x01);
 		break;
 
-	case 0x08: /* LD (imm), SP */
+	PGB_OP(0x08) /* LD (imm), SP */
 	{
 		uint8_t h, l;
 		uint16_t temp;
@@ -1917,7 +2801,7 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x09: /* ADD HL, BC */
+	PGB_OP(0x09) /* ADD HL, BC */
 	{
 		uint_fast32_t temp = gb->cpu_reg.hl.reg + gb->cpu_reg.bc.reg;
 		gb->cpu_reg.f.f_bits.n = 0;
@@ -1928,62 +2812,62 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x0A: /* LD A, (BC) */
+	PGB_OP(0x0A) /* LD A, (BC) */
 		gb->cpu_reg.a = __gb_read(gb, gb->cpu_reg.bc.reg);
 		break;
 
-	case 0x0B: /* DEC BC */
+	PGB_OP(0x0B) /* DEC BC */
 		gb->cpu_reg.bc.reg--;
 		break;
 
-	case 0x0C: /* INC C */
+	PGB_OP(0x0C) /* INC C */
 		PGB_INSTR_INC_R8(gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0x0D: /* DEC C */
+	PGB_OP(0x0D) /* DEC C */
 		PGB_INSTR_DEC_R8(gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0x0E: /* LD C, imm */
+	PGB_OP(0x0E) /* LD C, imm */
 		gb->cpu_reg.bc.bytes.c = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x0F: /* RRCA */
+	PGB_OP(0x0F) /* RRCA */
 		gb->cpu_reg.f.reg = 0;
 		gb->cpu_reg.f.f_bits.c = gb->cpu_reg.a & 0x01;
 		gb->cpu_reg.a = (gb->cpu_reg.a >> 1) | (gb->cpu_reg.a << 7);
 		break;
 
-	case 0x10: /* STOP */
+	PGB_OP(0x10) /* STOP */
 		//gb->gb_halt = true;
 		break;
 
-	case 0x11: /* LD DE, imm */
+	PGB_OP(0x11) /* LD DE, imm */
 		gb->cpu_reg.de.bytes.e = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		gb->cpu_reg.de.bytes.d = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x12: /* LD (DE), A */
+	PGB_OP(0x12) /* LD (DE), A */
 		__gb_write(gb, gb->cpu_reg.de.reg, gb->cpu_reg.a);
 		break;
 
-	case 0x13: /* INC DE */
+	PGB_OP(0x13) /* INC DE */
 		gb->cpu_reg.de.reg++;
 		break;
 
-	case 0x14: /* INC D */
+	PGB_OP(0x14) /* INC D */
 		PGB_INSTR_INC_R8(gb->cpu_reg.de.bytes.d);
 		break;
 
-	case 0x15: /* DEC D */
+	PGB_OP(0x15) /* DEC D */
 		PGB_INSTR_DEC_R8(gb->cpu_reg.de.bytes.d);
 		break;
 
-	case 0x16: /* LD D, imm */
+	PGB_OP(0x16) /* LD D, imm */
 		gb->cpu_reg.de.bytes.d = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x17: /* RLA */
+	PGB_OP(0x17) /* RLA */
 	{
 		uint8_t temp = gb->cpu_reg.a;
 		gb->cpu_reg.a = (gb->cpu_reg.a << 1) | gb->cpu_reg.f.f_bits.c;
@@ -1992,14 +2876,19 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x18: /* JR imm */
+	PGB_OP(0x18) /* JR imm */
 	{
 		int8_t temp = (int8_t) __gb_read(gb, gb->cpu_reg.pc.reg++);
 		gb->cpu_reg.pc.reg += temp;
+#if PEANUT_GB_IDLE_LOOP_SKIP
+		if(temp < 0)
+			__gb_idle_loop_skip(gb, gb->cpu_reg.pc.reg - temp - 2,
+					    inst_cycles);
+#endif
 		break;
 	}
 
-	case 0x19: /* ADD HL, DE */
+	PGB_OP(0x19) /* ADD HL, DE */
 	{
 		uint_fast32_t temp = gb->cpu_reg.hl.reg + gb->cpu_reg.de.reg;
 		gb->cpu_reg.f.f_bits.n = 0;
@@ -2010,27 +2899,27 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x1A: /* LD A, (DE) */
+	PGB_OP(0x1A) /* LD A, (DE) */
 		gb->cpu_reg.a = __gb_read(gb, gb->cpu_reg.de.reg);
 		break;
 
-	case 0x1B: /* DEC DE */
+	PGB_OP(0x1B) /* DEC DE */
 		gb->cpu_reg.de.reg--;
 		break;
 
-	case 0x1C: /* INC E */
+	PGB_OP(0x1C) /* INC E */
 		PGB_INSTR_INC_R8(gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0x1D: /* DEC E */
+	PGB_OP(0x1D) /* DEC E */
 		PGB_INSTR_DEC_R8(gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0x1E: /* LD E, imm */
+	PGB_OP(0x1E) /* LD E, imm */
 		gb->cpu_reg.de.bytes.e = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x1F: /* RRA */
+	PGB_OP(0x1F) /* RRA */
 	{
 		uint8_t temp = gb->cpu_reg.a;
 		gb->cpu_reg.a = gb->cpu_reg.a >> 1 | (gb->cpu_reg.f.f_bits.c << 7);
@@ -2039,45 +2928,51 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x20: /* JR NZ, imm */
+	PGB_OP(0x20) /* JR NZ, imm */
 		if(!gb->cpu_reg.f.f_bits.z)
 		{
 			int8_t temp = (int8_t) __gb_read(gb, gb->cpu_reg.pc.reg++);
 			gb->cpu_reg.pc.reg += temp;
 			inst_cycles += 4;
+#if PEANUT_GB_IDLE_LOOP_SKIP
+			if(temp < 0)
+				__gb_idle_loop_skip(gb,
+					gb->cpu_reg.pc.reg - temp - 2,
+					inst_cycles);
+#endif
 		}
 		else
 			gb->cpu_reg.pc.reg++;
 
 		break;
 
-	case 0x21: /* LD HL, imm */
+	PGB_OP(0x21) /* LD HL, imm */
 		gb->cpu_reg.hl.bytes.l = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		gb->cpu_reg.hl.bytes.h = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x22: /* LDI (HL), A */
+	PGB_OP(0x22) /* LDI (HL), A */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.a);
 		gb->cpu_reg.hl.reg++;
 		break;
 
-	case 0x23: /* INC HL */
+	PGB_OP(0x23) /* INC HL */
 		gb->cpu_reg.hl.reg++;
 		break;
 
-	case 0x24: /* INC H */
+	PGB_OP(0x24) /* INC H */
 		PGB_INSTR_INC_R8(gb->cpu_reg.hl.bytes.h);
 		break;
 
-	case 0x25: /* DEC H */
+	PGB_OP(0x25) /* DEC H */
 		PGB_INSTR_DEC_R8(gb->cpu_reg.hl.bytes.h);
 		break;
 
-	case 0x26: /* LD H, imm */
+	PGB_OP(0x26) /* LD H, imm */
 		gb->cpu_reg.hl.bytes.h = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x27: /* DAA */
+	PGB_OP(0x27) /* DAA */
 	{
 		/* The following is from SameBoy. MIT License. */
 		int16_t a = gb->cpu_reg.a;
@@ -2109,19 +3004,25 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x28: /* JR Z, imm */
+	PGB_OP(0x28) /* JR Z, imm */
 		if(gb->cpu_reg.f.f_bits.z)
 		{
 			int8_t temp = (int8_t) __gb_read(gb, gb->cpu_reg.pc.reg++);
 			gb->cpu_reg.pc.reg += temp;
 			inst_cycles += 4;
+#if PEANUT_GB_IDLE_LOOP_SKIP
+			if(temp < 0)
+				__gb_idle_loop_skip(gb,
+					gb->cpu_reg.pc.reg - temp - 2,
+					inst_cycles);
+#endif
 		}
 		else
 			gb->cpu_reg.pc.reg++;
 
 		break;
 
-	case 0x29: /* ADD HL, HL */
+	PGB_OP(0x29) /* ADD HL, HL */
 	{
 		gb->cpu_reg.f.f_bits.c = (gb->cpu_reg.hl.reg & 0x8000) > 0;
 		gb->cpu_reg.hl.reg <<= 1;
@@ -2130,59 +3031,65 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x2A: /* LD A, (HL+) */
+	PGB_OP(0x2A) /* LD A, (HL+) */
 		gb->cpu_reg.a = __gb_read(gb, gb->cpu_reg.hl.reg++);
 		break;
 
-	case 0x2B: /* DEC HL */
+	PGB_OP(0x2B) /* DEC HL */
 		gb->cpu_reg.hl.reg--;
 		break;
 
-	case 0x2C: /* INC L */
+	PGB_OP(0x2C) /* INC L */
 		PGB_INSTR_INC_R8(gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0x2D: /* DEC L */
+	PGB_OP(0x2D) /* DEC L */
 		PGB_INSTR_DEC_R8(gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0x2E: /* LD L, imm */
+	PGB_OP(0x2E) /* LD L, imm */
 		gb->cpu_reg.hl.bytes.l = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x2F: /* CPL */
+	PGB_OP(0x2F) /* CPL */
 		gb->cpu_reg.a = ~gb->cpu_reg.a;
 		gb->cpu_reg.f.f_bits.n = 1;
 		gb->cpu_reg.f.f_bits.h = 1;
 		break;
 
-	case 0x30: /* JR NC, imm */
+	PGB_OP(0x30) /* JR NC, imm */
 		if(!gb->cpu_reg.f.f_bits.c)
 		{
 			int8_t temp = (int8_t) __gb_read(gb, gb->cpu_reg.pc.reg++);
 			gb->cpu_reg.pc.reg += temp;
 			inst_cycles += 4;
+#if PEANUT_GB_IDLE_LOOP_SKIP
+			if(temp < 0)
+				__gb_idle_loop_skip(gb,
+					gb->cpu_reg.pc.reg - temp - 2,
+					inst_cycles);
+#endif
 		}
 		else
 			gb->cpu_reg.pc.reg++;
 
 		break;
 
-	case 0x31: /* LD SP, imm */
+	PGB_OP(0x31) /* LD SP, imm */
 		gb->cpu_reg.sp.bytes.p = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		gb->cpu_reg.sp.bytes.s = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x32: /* LD (HL), A */
+	PGB_OP(0x32) /* LD (HL), A */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.a);
 		gb->cpu_reg.hl.reg--;
 		break;
 
-	case 0x33: /* INC SP */
+	PGB_OP(0x33) /* INC SP */
 		gb->cpu_reg.sp.reg++;
 		break;
 
-	case 0x34: /* INC (HL) */
+	PGB_OP(0x34) /* INC (HL) */
 	{
 		uint8_t temp = __gb_read(gb, gb->cpu_reg.hl.reg);
 		PGB_INSTR_INC_R8(temp);
@@ -2190,7 +3097,7 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x35: /* DEC (HL) */
+	PGB_OP(0x35) /* DEC (HL) */
 	{
 		uint8_t temp = __gb_read(gb, gb->cpu_reg.hl.reg);
 		PGB_INSTR_DEC_R8(temp);
@@ -2198,29 +3105,35 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x36: /* LD (HL), imm */
+	PGB_OP(0x36) /* LD (HL), imm */
 		__gb_write(gb, gb->cpu_reg.hl.reg, __gb_read(gb, gb->cpu_reg.pc.reg++));
 		break;
 
-	case 0x37: /* SCF */
+	PGB_OP(0x37) /* SCF */
 		gb->cpu_reg.f.f_bits.n = 0;
 		gb->cpu_reg.f.f_bits.h = 0;
 		gb->cpu_reg.f.f_bits.c = 1;
 		break;
 
-	case 0x38: /* JR C, imm */
+	PGB_OP(0x38) /* JR C, imm */
 		if(gb->cpu_reg.f.f_bits.c)
 		{
 			int8_t temp = (int8_t) __gb_read(gb, gb->cpu_reg.pc.reg++);
 			gb->cpu_reg.pc.reg += temp;
 			inst_cycles += 4;
+#if PEANUT_GB_IDLE_LOOP_SKIP
+			if(temp < 0)
+				__gb_idle_loop_skip(gb,
+					gb->cpu_reg.pc.reg - temp - 2,
+					inst_cycles);
+#endif
 		}
 		else
 			gb->cpu_reg.pc.reg++;
 
 		break;
 
-	case 0x39: /* ADD HL, SP */
+	PGB_OP(0x39) /* ADD HL, SP */
 	{
 		uint_fast32_t temp = gb->cpu_reg.hl.reg + gb->cpu_reg.sp.reg;
 		gb->cpu_reg.f.f_bits.n = 0;
@@ -2231,248 +3144,249 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x3A: /* LD A, (HL) */
+	PGB_OP(0x3A) /* LD A, (HL) */
 		gb->cpu_reg.a = __gb_read(gb, gb->cpu_reg.hl.reg--);
 		break;
 
-	case 0x3B: /* DEC SP */
+	PGB_OP(0x3B) /* DEC SP */
 		gb->cpu_reg.sp.reg--;
 		break;
 
-	case 0x3C: /* INC A */
+	PGB_OP(0x3C) /* INC A */
 		PGB_INSTR_INC_R8(gb->cpu_reg.a);
 		break;
 
-	case 0x3D: /* DEC A */
+	PGB_OP(0x3D) /* DEC A */
 		PGB_INSTR_DEC_R8(gb->cpu_reg.a);
 		break;
 
-	case 0x3E: /* LD A, imm */
+	PGB_OP(0x3E) /* LD A, imm */
 		gb->cpu_reg.a = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		break;
 
-	case 0x3F: /* CCF */
+	PGB_OP(0x3F) /* CCF */
 		gb->cpu_reg.f.f_bits.n = 0;
 		gb->cpu_reg.f.f_bits.h = 0;
 		gb->cpu_reg.f.f_bits.c = ~gb->cpu_reg.f.f_bits.c;
 		break;
 
-	case 0x40: /* LD B, B */
+	PGB_OP(0x40) /* LD B, B */
 		break;
 
-	case 0x41: /* LD B, C */
+	PGB_OP(0x41) /* LD B, C */
 		gb->cpu_reg.bc.bytes.b = gb->cpu_reg.bc.bytes.c;
 		break;
 
-	case 0x42: /* LD B, D */
+	PGB_OP(0x42) /* LD B, D */
 		gb->cpu_reg.bc.bytes.b = gb->cpu_reg.de.bytes.d;
 		break;
 
-	case 0x43: /* LD B, E */
+	PGB_OP(0x43) /* LD B, E */
 		gb->cpu_reg.bc.bytes.b = gb->cpu_reg.de.bytes.e;
 		break;
 
-	case 0x44: /* LD B, H */
+	PGB_OP(0x44) /* LD B, H */
 		gb->cpu_reg.bc.bytes.b = gb->cpu_reg.hl.bytes.h;
 		break;
 
-	case 0x45: /* LD B, L */
+	PGB_OP(0x45) /* LD B, L */
 		gb->cpu_reg.bc.bytes.b = gb->cpu_reg.hl.bytes.l;
 		break;
 
-	case 0x46: /* LD B, (HL) */
+	PGB_OP(0x46) /* LD B, (HL) */
 		gb->cpu_reg.bc.bytes.b = __gb_read(gb, gb->cpu_reg.hl.reg);
 		break;
 
-	case 0x47: /* LD B, A */
+	PGB_OP(0x47) /* LD B, A */
 		gb->cpu_reg.bc.bytes.b = gb->cpu_reg.a;
 		break;
 
-	case 0x48: /* LD C, B */
+	PGB_OP(0x48) /* LD C, B */
 		gb->cpu_reg.bc.bytes.c = gb->cpu_reg.bc.bytes.b;
 		break;
 
-	case 0x49: /* LD C, C */
+	PGB_OP(0x49) /* LD C, C */
 		break;
 
-	case 0x4A: /* LD C, D */
+	PGB_OP(0x4A) /* LD C, D */
 		gb->cpu_reg.bc.bytes.c = gb->cpu_reg.de.bytes.d;
 		break;
 
-	case 0x4B: /* LD C, E */
+	PGB_OP(0x4B) /* LD C, E */
 		gb->cpu_reg.bc.bytes.c = gb->cpu_reg.de.bytes.e;
 		break;
 
-	case 0x4C: /* LD C, H */
+	PGB_OP(0x4C) /* LD C, H */
 		gb->cpu_reg.bc.bytes.c = gb->cpu_reg.hl.bytes.h;
 		break;
 
-	case 0x4D: /* LD C, L */
+	PGB_OP(0x4D) /* LD C, L */
 		gb->cpu_reg.bc.bytes.c = gb->cpu_reg.hl.bytes.l;
 		break;
 
-	case 0x4E: /* LD C, (HL) */
+	PGB_OP(0x4E) /* LD C, (HL) */
 		gb->cpu_reg.bc.bytes.c = __gb_read(gb, gb->cpu_reg.hl.reg);
 		break;
 
-	case 0x4F: /* LD C, A */
+	PGB_OP(0x4F) /* LD C, A */
 		gb->cpu_reg.bc.bytes.c = gb->cpu_reg.a;
 		break;
 
-	case 0x50: /* LD D, B */
+	PGB_OP(0x50) /* LD D, B */
 		gb->cpu_reg.de.bytes.d = gb->cpu_reg.bc.bytes.b;
 		break;
 
-	case 0x51: /* LD D, C */
+	PGB_OP(0x51) /* LD D, C */
 		gb->cpu_reg.de.bytes.d = gb->cpu_reg.bc.bytes.c;
 		break;
 
-	case 0x52: /* LD D, D */
+	PGB_OP(0x52) /* LD D, D */
 		break;
 
-	case 0x53: /* LD D, E */
+	PGB_OP(0x53) /* LD D, E */
 		gb->cpu_reg.de.bytes.d = gb->cpu_reg.de.bytes.e;
 		break;
 
-	case 0x54: /* LD D, H */
+	PGB_OP(0x54) /* LD D, H */
 		gb->cpu_reg.de.bytes.d = gb->cpu_reg.hl.bytes.h;
 		break;
 
-	case 0x55: /* LD D, L */
+	PGB_OP(0x55) /* LD D, L */
 		gb->cpu_reg.de.bytes.d = gb->cpu_reg.hl.bytes.l;
 		break;
 
-	case 0x56: /* LD D, (HL) */
+	PGB_OP(0x56) /* LD D, (HL) */
 		gb->cpu_reg.de.bytes.d = __gb_read(gb, gb->cpu_reg.hl.reg);
 		break;
 
-	case 0x57: /* LD D, A */
+	PGB_OP(0x57) /* LD D, A */
 		gb->cpu_reg.de.bytes.d = gb->cpu_reg.a;
 		break;
 
-	case 0x58: /* LD E, B */
+	PGB_OP(0x58) /* LD E, B */
 		gb->cpu_reg.de.bytes.e = gb->cpu_reg.bc.bytes.b;
 		break;
 
-	case 0x59: /* LD E, C */
+	PGB_OP(0x59) /* LD E, C */
 		gb->cpu_reg.de.bytes.e = gb->cpu_reg.bc.bytes.c;
 		break;
 
-	case 0x5A: /* LD E, D */
+	PGB_OP(0x5A) /* LD E, D */
 		gb->cpu_reg.de.bytes.e = gb->cpu_reg.de.bytes.d;
 		break;
 
-	case 0x5B: /* LD E, E */
+	PGB_OP(0x5B) /* LD E, E */
 		break;
 
-	case 0x5C: /* LD E, H */
+	PGB_OP(0x5C) /* LD E, H */
 		gb->cpu_reg.de.bytes.e = gb->cpu_reg.hl.bytes.h;
 		break;
 
-	case 0x5D: /* LD E, L */
+	PGB_OP(0x5D) /* LD E, L */
 		gb->cpu_reg.de.bytes.e = gb->cpu_reg.hl.bytes.l;
 		break;
 
-	case 0x5E: /* LD E, (HL) */
+	PGB_OP(0x5E) /* LD E, (HL) */
 		gb->cpu_reg.de.bytes.e = __gb_read(gb, gb->cpu_reg.hl.reg);
 		break;
 
-	case 0x5F: /* LD E, A */
+	PGB_OP(0x5F) /* LD E, A */
 		gb->cpu_reg.de.bytes.e = gb->cpu_reg.a;
 		break;
 
-	case 0x60: /* LD H, B */
+	PGB_OP(0x60) /* LD H, B */
 		gb->cpu_reg.hl.bytes.h = gb->cpu_reg.bc.bytes.b;
 		break;
 
-	case 0x61: /* LD H, C */
+	PGB_OP(0x61) /* LD H, C */
 		gb->cpu_reg.hl.bytes.h = gb->cpu_reg.bc.bytes.c;
 		break;
 
-	case 0x62: /* LD H, D */
+	PGB_OP(0x62) /* LD H, D */
 		gb->cpu_reg.hl.bytes.h = gb->cpu_reg.de.bytes.d;
 		break;
 
-	case 0x63: /* LD H, E */
+	PGB_OP(0x63) /* LD H, E */
 		gb->cpu_reg.hl.bytes.h = gb->cpu_reg.de.bytes.e;
 		break;
 
-	case 0x64: /* LD H, H */
+	PGB_OP(0x64) /* LD H, H */
 		break;
 
-	case 0x65: /* LD H, L */
+	PGB_OP(0x65) /* LD H, L */
 		gb->cpu_reg.hl.bytes.h = gb->cpu_reg.hl.bytes.l;
 		break;
 
-	case 0x66: /* LD H, (HL) */
+	PGB_OP(0x66) /* LD H, (HL) */
 		gb->cpu_reg.hl.bytes.h = __gb_read(gb, gb->cpu_reg.hl.reg);
 		break;
 
-	case 0x67: /* LD H, A */
+	PGB_OP(0x67) /* LD H, A */
 		gb->cpu_reg.hl.bytes.h = gb->cpu_reg.a;
 		break;
 
-	case 0x68: /* LD L, B */
+	PGB_OP(0x68) /* LD L, B */
 		gb->cpu_reg.hl.bytes.l = gb->cpu_reg.bc.bytes.b;
 		break;
 
-	case 0x69: /* LD L, C */
+	PGB_OP(0x69) /* LD L, C */
 		gb->cpu_reg.hl.bytes.l = gb->cpu_reg.bc.bytes.c;
 		break;
 
-	case 0x6A: /* LD L, D */
+	PGB_OP(0x6A) /* LD L, D */
 		gb->cpu_reg.hl.bytes.l = gb->cpu_reg.de.bytes.d;
 		break;
 
-	case 0x6B: /* LD L, E */
+	PGB_OP(0x6B) /* LD L, E */
 		gb->cpu_reg.hl.bytes.l = gb->cpu_reg.de.bytes.e;
 		break;
 
-	case 0x6C: /* LD L, H */
+	PGB_OP(0x6C) /* LD L, H */
 		gb->cpu_reg.hl.bytes.l = gb->cpu_reg.hl.bytes.h;
 		break;
 
-	case 0x6D: /* LD L, L */
+	PGB_OP(0x6D) /* LD L, L */
 		break;
 
-	case 0x6E: /* LD L, (HL) */
+	PGB_OP(0x6E) /* LD L, (HL) */
 		gb->cpu_reg.hl.bytes.l = __gb_read(gb, gb->cpu_reg.hl.reg);
 		break;
 
-	case 0x6F: /* LD L, A */
+	PGB_OP(0x6F) /* LD L, A */
 		gb->cpu_reg.hl.bytes.l = gb->cpu_reg.a;
 		break;
 
-	case 0x70: /* LD (HL), B */
+	PGB_OP(0x70) /* LD (HL), B */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.bc.bytes.b);
 		break;
 
-	case 0x71: /* LD (HL), C */
+	PGB_OP(0x71) /* LD (HL), C */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0x72: /* LD (HL), D */
+	PGB_OP(0x72) /* LD (HL), D */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.de.bytes.d);
 		break;
 
-	case 0x73: /* LD (HL), E */
+	PGB_OP(0x73) /* LD (HL), E */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0x74: /* LD (HL), H */
+	PGB_OP(0x74) /* LD (HL), H */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.hl.bytes.h);
 		break;
 
-	case 0x75: /* LD (HL), L */
+	PGB_OP(0x75) /* LD (HL), L */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0x76: /* HALT */
+	PGB_OP(0x76) /* HALT */
 	{
 		int_fast16_t halt_cycles = INT_FAST16_MAX;
 
 		/* TODO: Emulate HALT bug? */
 		gb->gb_halt = true;
+		__gb_sync_counters(gb);
 
 		if(gb->hram_io[IO_SC] & SERIAL_SC_TX_START)
 		{
@@ -2530,306 +3444,306 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0x77: /* LD (HL), A */
+	PGB_OP(0x77) /* LD (HL), A */
 		__gb_write(gb, gb->cpu_reg.hl.reg, gb->cpu_reg.a);
 		break;
 
-	case 0x78: /* LD A, B */
+	PGB_OP(0x78) /* LD A, B */
 		gb->cpu_reg.a = gb->cpu_reg.bc.bytes.b;
 		break;
 
-	case 0x79: /* LD A, C */
+	PGB_OP(0x79) /* LD A, C */
 		gb->cpu_reg.a = gb->cpu_reg.bc.bytes.c;
 		break;
 
-	case 0x7A: /* LD A, D */
+	PGB_OP(0x7A) /* LD A, D */
 		gb->cpu_reg.a = gb->cpu_reg.de.bytes.d;
 		break;
 
-	case 0x7B: /* LD A, E */
+	PGB_OP(0x7B) /* LD A, E */
 		gb->cpu_reg.a = gb->cpu_reg.de.bytes.e;
 		break;
 
-	case 0x7C: /* LD A, H */
+	PGB_OP(0x7C) /* LD A, H */
 		gb->cpu_reg.a = gb->cpu_reg.hl.bytes.h;
 		break;
 
-	case 0x7D: /* LD A, L */
+	PGB_OP(0x7D) /* LD A, L */
 		gb->cpu_reg.a = gb->cpu_reg.hl.bytes.l;
 		break;
 
-	case 0x7E: /* LD A, (HL) */
+	PGB_OP(0x7E) /* LD A, (HL) */
 		gb->cpu_reg.a = __gb_read(gb, gb->cpu_reg.hl.reg);
 		break;
 
-	case 0x7F: /* LD A, A */
+	PGB_OP(0x7F) /* LD A, A */
 		break;
 
-	case 0x80: /* ADD A, B */
+	PGB_OP(0x80) /* ADD A, B */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.bc.bytes.b, 0);
 		break;
 
-	case 0x81: /* ADD A, C */
+	PGB_OP(0x81) /* ADD A, C */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.bc.bytes.c, 0);
 		break;
 
-	case 0x82: /* ADD A, D */
+	PGB_OP(0x82) /* ADD A, D */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.de.bytes.d, 0);
 		break;
 
-	case 0x83: /* ADD A, E */
+	PGB_OP(0x83) /* ADD A, E */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.de.bytes.e, 0);
 		break;
 
-	case 0x84: /* ADD A, H */
+	PGB_OP(0x84) /* ADD A, H */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.hl.bytes.h, 0);
 		break;
 
-	case 0x85: /* ADD A, L */
+	PGB_OP(0x85) /* ADD A, L */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.hl.bytes.l, 0);
 		break;
 
-	case 0x86: /* ADD A, (HL) */
+	PGB_OP(0x86) /* ADD A, (HL) */
 		PGB_INSTR_ADC_R8(__gb_read(gb, gb->cpu_reg.hl.reg), 0);
 		break;
 
-	case 0x87: /* ADD A, A */
+	PGB_OP(0x87) /* ADD A, A */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.a, 0);
 		break;
 
-	case 0x88: /* ADC A, B */
+	PGB_OP(0x88) /* ADC A, B */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.bc.bytes.b, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x89: /* ADC A, C */
+	PGB_OP(0x89) /* ADC A, C */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.bc.bytes.c, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x8A: /* ADC A, D */
+	PGB_OP(0x8A) /* ADC A, D */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.de.bytes.d, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x8B: /* ADC A, E */
+	PGB_OP(0x8B) /* ADC A, E */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.de.bytes.e, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x8C: /* ADC A, H */
+	PGB_OP(0x8C) /* ADC A, H */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.hl.bytes.h, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x8D: /* ADC A, L */
+	PGB_OP(0x8D) /* ADC A, L */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.hl.bytes.l, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x8E: /* ADC A, (HL) */
+	PGB_OP(0x8E) /* ADC A, (HL) */
 		PGB_INSTR_ADC_R8(__gb_read(gb, gb->cpu_reg.hl.reg), gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x8F: /* ADC A, A */
+	PGB_OP(0x8F) /* ADC A, A */
 		PGB_INSTR_ADC_R8(gb->cpu_reg.a, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x90: /* SUB B */
+	PGB_OP(0x90) /* SUB B */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.bc.bytes.b, 0);
 		break;
 
-	case 0x91: /* SUB C */
+	PGB_OP(0x91) /* SUB C */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.bc.bytes.c, 0);
 		break;
 
-	case 0x92: /* SUB D */
+	PGB_OP(0x92) /* SUB D */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.de.bytes.d, 0);
 		break;
 
-	case 0x93: /* SUB E */
+	PGB_OP(0x93) /* SUB E */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.de.bytes.e, 0);
 		break;
 
-	case 0x94: /* SUB H */
+	PGB_OP(0x94) /* SUB H */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.hl.bytes.h, 0);
 		break;
 
-	case 0x95: /* SUB L */
+	PGB_OP(0x95) /* SUB L */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.hl.bytes.l, 0);
 		break;
 
-	case 0x96: /* SUB (HL) */
+	PGB_OP(0x96) /* SUB (HL) */
 		PGB_INSTR_SBC_R8(__gb_read(gb, gb->cpu_reg.hl.reg), 0);
 		break;
 
-	case 0x97: /* SUB A */
+	PGB_OP(0x97) /* SUB A */
 		gb->cpu_reg.a = 0;
 		gb->cpu_reg.f.reg = 0;
 		gb->cpu_reg.f.f_bits.z = 1;
 		gb->cpu_reg.f.f_bits.n = 1;
 		break;
 
-	case 0x98: /* SBC A, B */
+	PGB_OP(0x98) /* SBC A, B */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.bc.bytes.b, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x99: /* SBC A, C */
+	PGB_OP(0x99) /* SBC A, C */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.bc.bytes.c, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x9A: /* SBC A, D */
+	PGB_OP(0x9A) /* SBC A, D */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.de.bytes.d, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x9B: /* SBC A, E */
+	PGB_OP(0x9B) /* SBC A, E */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.de.bytes.e, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x9C: /* SBC A, H */
+	PGB_OP(0x9C) /* SBC A, H */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.hl.bytes.h, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x9D: /* SBC A, L */
+	PGB_OP(0x9D) /* SBC A, L */
 		PGB_INSTR_SBC_R8(gb->cpu_reg.hl.bytes.l, gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x9E: /* SBC A, (HL) */
+	PGB_OP(0x9E) /* SBC A, (HL) */
 		PGB_INSTR_SBC_R8(__gb_read(gb, gb->cpu_reg.hl.reg), gb->cpu_reg.f.f_bits.c);
 		break;
 
-	case 0x9F: /* SBC A, A */
+	PGB_OP(0x9F) /* SBC A, A */
 		gb->cpu_reg.a = gb->cpu_reg.f.f_bits.c ? 0xFF : 0x00;
 		gb->cpu_reg.f.f_bits.z = !gb->cpu_reg.f.f_bits.c;
 		gb->cpu_reg.f.f_bits.n = 1;
 		gb->cpu_reg.f.f_bits.h = gb->cpu_reg.f.f_bits.c;
 		break;
 
-	case 0xA0: /* AND B */
+	PGB_OP(0xA0) /* AND B */
 		PGB_INSTR_AND_R8(gb->cpu_reg.bc.bytes.b);
 		break;
 
-	case 0xA1: /* AND C */
+	PGB_OP(0xA1) /* AND C */
 		PGB_INSTR_AND_R8(gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0xA2: /* AND D */
+	PGB_OP(0xA2) /* AND D */
 		PGB_INSTR_AND_R8(gb->cpu_reg.de.bytes.d);
 		break;
 
-	case 0xA3: /* AND E */
+	PGB_OP(0xA3) /* AND E */
 		PGB_INSTR_AND_R8(gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0xA4: /* AND H */
+	PGB_OP(0xA4) /* AND H */
 		PGB_INSTR_AND_R8(gb->cpu_reg.hl.bytes.h);
 		break;
 
-	case 0xA5: /* AND L */
+	PGB_OP(0xA5) /* AND L */
 		PGB_INSTR_AND_R8(gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0xA6: /* AND (HL) */
+	PGB_OP(0xA6) /* AND (HL) */
 		PGB_INSTR_AND_R8(__gb_read(gb, gb->cpu_reg.hl.reg));
 		break;
 
-	case 0xA7: /* AND A */
+	PGB_OP(0xA7) /* AND A */
 		PGB_INSTR_AND_R8(gb->cpu_reg.a);
 		break;
 
-	case 0xA8: /* XOR B */
+	PGB_OP(0xA8) /* XOR B */
 		PGB_INSTR_XOR_R8(gb->cpu_reg.bc.bytes.b);
 		break;
 
-	case 0xA9: /* XOR C */
+	PGB_OP(0xA9) /* XOR C */
 		PGB_INSTR_XOR_R8(gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0xAA: /* XOR D */
+	PGB_OP(0xAA) /* XOR D */
 		PGB_INSTR_XOR_R8(gb->cpu_reg.de.bytes.d);
 		break;
 
-	case 0xAB: /* XOR E */
+	PGB_OP(0xAB) /* XOR E */
 		PGB_INSTR_XOR_R8(gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0xAC: /* XOR H */
+	PGB_OP(0xAC) /* XOR H */
 		PGB_INSTR_XOR_R8(gb->cpu_reg.hl.bytes.h);
 		break;
 
-	case 0xAD: /* XOR L */
+	PGB_OP(0xAD) /* XOR L */
 		PGB_INSTR_XOR_R8(gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0xAE: /* XOR (HL) */
+	PGB_OP(0xAE) /* XOR (HL) */
 		PGB_INSTR_XOR_R8(__gb_read(gb, gb->cpu_reg.hl.reg));
 		break;
 
-	case 0xAF: /* XOR A */
+	PGB_OP(0xAF) /* XOR A */
 		PGB_INSTR_XOR_R8(gb->cpu_reg.a);
 		break;
 
-	case 0xB0: /* OR B */
+	PGB_OP(0xB0) /* OR B */
 		PGB_INSTR_OR_R8(gb->cpu_reg.bc.bytes.b);
 		break;
 
-	case 0xB1: /* OR C */
+	PGB_OP(0xB1) /* OR C */
 		PGB_INSTR_OR_R8(gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0xB2: /* OR D */
+	PGB_OP(0xB2) /* OR D */
 		PGB_INSTR_OR_R8(gb->cpu_reg.de.bytes.d);
 		break;
 
-	case 0xB3: /* OR E */
+	PGB_OP(0xB3) /* OR E */
 		PGB_INSTR_OR_R8(gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0xB4: /* OR H */
+	PGB_OP(0xB4) /* OR H */
 		PGB_INSTR_OR_R8(gb->cpu_reg.hl.bytes.h);
 		break;
 
-	case 0xB5: /* OR L */
+	PGB_OP(0xB5) /* OR L */
 		PGB_INSTR_OR_R8(gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0xB6: /* OR (HL) */
+	PGB_OP(0xB6) /* OR (HL) */
 		PGB_INSTR_OR_R8(__gb_read(gb, gb->cpu_reg.hl.reg));
 		break;
 
-	case 0xB7: /* OR A */
+	PGB_OP(0xB7) /* OR A */
 		PGB_INSTR_OR_R8(gb->cpu_reg.a);
 		break;
 
-	case 0xB8: /* CP B */
+	PGB_OP(0xB8) /* CP B */
 		PGB_INSTR_CP_R8(gb->cpu_reg.bc.bytes.b);
 		break;
 
-	case 0xB9: /* CP C */
+	PGB_OP(0xB9) /* CP C */
 		PGB_INSTR_CP_R8(gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0xBA: /* CP D */
+	PGB_OP(0xBA) /* CP D */
 		PGB_INSTR_CP_R8(gb->cpu_reg.de.bytes.d);
 		break;
 
-	case 0xBB: /* CP E */
+	PGB_OP(0xBB) /* CP E */
 		PGB_INSTR_CP_R8(gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0xBC: /* CP H */
+	PGB_OP(0xBC) /* CP H */
 		PGB_INSTR_CP_R8(gb->cpu_reg.hl.bytes.h);
 		break;
 
-	case 0xBD: /* CP L */
+	PGB_OP(0xBD) /* CP L */
 		PGB_INSTR_CP_R8(gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0xBE: /* CP (HL) */
+	PGB_OP(0xBE) /* CP (HL) */
 		PGB_INSTR_CP_R8(__gb_read(gb, gb->cpu_reg.hl.reg));
 		break;
 
-	case 0xBF: /* CP A */
+	PGB_OP(0xBF) /* CP A */
 		gb->cpu_reg.f.reg = 0;
 		gb->cpu_reg.f.f_bits.z = 1;
 		gb->cpu_reg.f.f_bits.n = 1;
 		break;
 
-	case 0xC0: /* RET NZ */
+	PGB_OP(0xC0) /* RET NZ */
 		if(!gb->cpu_reg.f.f_bits.z)
 		{
 			gb->cpu_reg.pc.bytes.c = __gb_read(gb, gb->cpu_reg.sp.reg++);
@@ -2839,12 +3753,12 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xC1: /* POP BC */
+	PGB_OP(0xC1) /* POP BC */
 		gb->cpu_reg.bc.bytes.c = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		gb->cpu_reg.bc.bytes.b = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		break;
 
-	case 0xC2: /* JP NZ, imm */
+	PGB_OP(0xC2) /* JP NZ, imm */
 		if(!gb->cpu_reg.f.f_bits.z)
 		{
 			uint8_t p, c;
@@ -2859,7 +3773,7 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xC3: /* JP imm */
+	PGB_OP(0xC3) /* JP imm */
 	{
 		uint8_t p, c;
 		c = __gb_read(gb, gb->cpu_reg.pc.reg++);
@@ -2869,7 +3783,7 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0xC4: /* CALL NZ imm */
+	PGB_OP(0xC4) /* CALL NZ imm */
 		if(!gb->cpu_reg.f.f_bits.z)
 		{
 			uint8_t p, c;
@@ -2886,25 +3800,25 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xC5: /* PUSH BC */
+	PGB_OP(0xC5) /* PUSH BC */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.bc.bytes.b);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0xC6: /* ADD A, imm */
+	PGB_OP(0xC6) /* ADD A, imm */
 	{
 		uint8_t val = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		PGB_INSTR_ADC_R8(val, 0);
 		break;
 	}
 
-	case 0xC7: /* RST 0x0000 */
+	PGB_OP(0xC7) /* RST 0x0000 */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0000;
 		break;
 
-	case 0xC8: /* RET Z */
+	PGB_OP(0xC8) /* RET Z */
 		if(gb->cpu_reg.f.f_bits.z)
 		{
 			gb->cpu_reg.pc.bytes.c = __gb_read(gb, gb->cpu_reg.sp.reg++);
@@ -2913,14 +3827,14 @@ void __gb_step_cpu(struct gb_s *gb)
 		}
 		break;
 
-	case 0xC9: /* RET */
+	PGB_OP(0xC9) /* RET */
 	{
 		gb->cpu_reg.pc.bytes.c = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		gb->cpu_reg.pc.bytes.p = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		break;
 	}
 
-	case 0xCA: /* JP Z, imm */
+	PGB_OP(0xCA) /* JP Z, imm */
 		if(gb->cpu_reg.f.f_bits.z)
 		{
 			uint8_t p, c;
@@ -2935,11 +3849,11 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xCB: /* CB INST */
+	PGB_OP(0xCB) /* CB INST */
 		inst_cycles = __gb_execute_cb(gb);
 		break;
 
-	case 0xCC: /* CALL Z, imm */
+	PGB_OP(0xCC) /* CALL Z, imm */
 		if(gb->cpu_reg.f.f_bits.z)
 		{
 			uint8_t p, c;
@@ -2956,7 +3870,7 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xCD: /* CALL imm */
+	PGB_OP(0xCD) /* CALL imm */
 	{
 		uint8_t p, c;
 		c = __gb_read(gb, gb->cpu_reg.pc.reg++);
@@ -2968,20 +3882,20 @@ void __gb_step_cpu(struct gb_s *gb)
 	}
 	break;
 
-	case 0xCE: /* ADC A, imm */
+	PGB_OP(0xCE) /* ADC A, imm */
 	{
 		uint8_t val = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		PGB_INSTR_ADC_R8(val, gb->cpu_reg.f.f_bits.c);
 		break;
 	}
 
-	case 0xCF: /* RST 0x0008 */
+	PGB_OP(0xCF) /* RST 0x0008 */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0008;
 		break;
 
-	case 0xD0: /* RET NC */
+	PGB_OP(0xD0) /* RET NC */
 		if(!gb->cpu_reg.f.f_bits.c)
 		{
 			gb->cpu_reg.pc.bytes.c = __gb_read(gb, gb->cpu_reg.sp.reg++);
@@ -2991,12 +3905,12 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xD1: /* POP DE */
+	PGB_OP(0xD1) /* POP DE */
 		gb->cpu_reg.de.bytes.e = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		gb->cpu_reg.de.bytes.d = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		break;
 
-	case 0xD2: /* JP NC, imm */
+	PGB_OP(0xD2) /* JP NC, imm */
 		if(!gb->cpu_reg.f.f_bits.c)
 		{
 			uint8_t p, c;
@@ -3011,7 +3925,7 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xD4: /* CALL NC, imm */
+	PGB_OP(0xD4) /* CALL NC, imm */
 		if(!gb->cpu_reg.f.f_bits.c)
 		{
 			uint8_t p, c;
@@ -3028,12 +3942,12 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xD5: /* PUSH DE */
+	PGB_OP(0xD5) /* PUSH DE */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.de.bytes.d);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.de.bytes.e);
 		break;
 
-	case 0xD6: /* SUB imm */
+	PGB_OP(0xD6) /* SUB imm */
 	{
 		uint8_t val = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		uint16_t temp = gb->cpu_reg.a - val;
@@ -3046,13 +3960,13 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0xD7: /* RST 0x0010 */
+	PGB_OP(0xD7) /* RST 0x0010 */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0010;
 		break;
 
-	case 0xD8: /* RET C */
+	PGB_OP(0xD8) /* RET C */
 		if(gb->cpu_reg.f.f_bits.c)
 		{
 			gb->cpu_reg.pc.bytes.c = __gb_read(gb, gb->cpu_reg.sp.reg++);
@@ -3062,7 +3976,7 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xD9: /* RETI */
+	PGB_OP(0xD9) /* RETI */
 	{
 		gb->cpu_reg.pc.bytes.c = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		gb->cpu_reg.pc.bytes.p = __gb_read(gb, gb->cpu_reg.sp.reg++);
@@ -3070,7 +3984,7 @@ void __gb_step_cpu(struct gb_s *gb)
 	}
 	break;
 
-	case 0xDA: /* JP C, imm */
+	PGB_OP(0xDA) /* JP C, imm */
 		if(gb->cpu_reg.f.f_bits.c)
 		{
 			uint8_t p, c;
@@ -3085,7 +3999,7 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xDC: /* CALL C, imm */
+	PGB_OP(0xDC) /* CALL C, imm */
 		if(gb->cpu_reg.f.f_bits.c)
 		{
 			uint8_t p, c;
@@ -3102,52 +4016,52 @@ void __gb_step_cpu(struct gb_s *gb)
 
 		break;
 
-	case 0xDE: /* SBC A, imm */
+	PGB_OP(0xDE) /* SBC A, imm */
 	{
 		uint8_t val = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		PGB_INSTR_SBC_R8(val, gb->cpu_reg.f.f_bits.c);
 		break;
 	}
 
-	case 0xDF: /* RST 0x0018 */
+	PGB_OP(0xDF) /* RST 0x0018 */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0018;
 		break;
 
-	case 0xE0: /* LD (0xFF00+imm), A */
+	PGB_OP(0xE0) /* LD (0xFF00+imm), A */
 		__gb_write(gb, 0xFF00 | __gb_read(gb, gb->cpu_reg.pc.reg++),
 			   gb->cpu_reg.a);
 		break;
 
-	case 0xE1: /* POP HL */
+	PGB_OP(0xE1) /* POP HL */
 		gb->cpu_reg.hl.bytes.l = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		gb->cpu_reg.hl.bytes.h = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		break;
 
-	case 0xE2: /* LD (C), A */
+	PGB_OP(0xE2) /* LD (C), A */
 		__gb_write(gb, 0xFF00 | gb->cpu_reg.bc.bytes.c, gb->cpu_reg.a);
 		break;
 
-	case 0xE5: /* PUSH HL */
+	PGB_OP(0xE5) /* PUSH HL */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.hl.bytes.h);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.hl.bytes.l);
 		break;
 
-	case 0xE6: /* AND imm */
+	PGB_OP(0xE6) /* AND imm */
 	{
 		uint8_t temp = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		PGB_INSTR_AND_R8(temp);
 		break;
 	}
 
-	case 0xE7: /* RST 0x0020 */
+	PGB_OP(0xE7) /* RST 0x0020 */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0020;
 		break;
 
-	case 0xE8: /* ADD SP, imm */
+	PGB_OP(0xE8) /* ADD SP, imm */
 	{
 		int8_t offset = (int8_t) __gb_read(gb, gb->cpu_reg.pc.reg++);
 		gb->cpu_reg.f.reg = 0;
@@ -3157,11 +4071,11 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0xE9: /* JP (HL) */
+	PGB_OP(0xE9) /* JP (HL) */
 		gb->cpu_reg.pc.reg = gb->cpu_reg.hl.reg;
 		break;
 
-	case 0xEA: /* LD (imm), A */
+	PGB_OP(0xEA) /* LD (imm), A */
 	{
 		uint8_t h, l;
 		uint16_t addr;
@@ -3172,22 +4086,22 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0xEE: /* XOR imm */
+	PGB_OP(0xEE) /* XOR imm */
 		PGB_INSTR_XOR_R8(__gb_read(gb, gb->cpu_reg.pc.reg++));
 		break;
 
-	case 0xEF: /* RST 0x0028 */
+	PGB_OP(0xEF) /* RST 0x0028 */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0028;
 		break;
 
-	case 0xF0: /* LD A, (0xFF00+imm) */
+	PGB_OP(0xF0) /* LD A, (0xFF00+imm) */
 		gb->cpu_reg.a =
 			__gb_read(gb, 0xFF00 | __gb_read(gb, gb->cpu_reg.pc.reg++));
 		break;
 
-	case 0xF1: /* POP AF */
+	PGB_OP(0xF1) /* POP AF */
 	{
 		uint8_t temp_8 = __gb_read(gb, gb->cpu_reg.sp.reg++);
 		gb->cpu_reg.f.f_bits.z = (temp_8 >> 7) & 1;
@@ -3198,32 +4112,32 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0xF2: /* LD A, (C) */
+	PGB_OP(0xF2) /* LD A, (C) */
 		gb->cpu_reg.a = __gb_read(gb, 0xFF00 | gb->cpu_reg.bc.bytes.c);
 		break;
 
-	case 0xF3: /* DI */
+	PGB_OP(0xF3) /* DI */
 		gb->gb_ime = false;
 		break;
 
-	case 0xF5: /* PUSH AF */
+	PGB_OP(0xF5) /* PUSH AF */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.a);
 		__gb_write(gb, --gb->cpu_reg.sp.reg,
 			   gb->cpu_reg.f.f_bits.z << 7 | gb->cpu_reg.f.f_bits.n << 6 |
 			   gb->cpu_reg.f.f_bits.h << 5 | gb->cpu_reg.f.f_bits.c << 4);
 		break;
 
-	case 0xF6: /* OR imm */
+	PGB_OP(0xF6) /* OR imm */
 		PGB_INSTR_OR_R8(__gb_read(gb, gb->cpu_reg.pc.reg++));
 		break;
 
-	case 0xF7: /* PUSH AF */
+	PGB_OP(0xF7) /* PUSH AF */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0030;
 		break;
 
-	case 0xF8: /* LD HL, SP+/-imm */
+	PGB_OP(0xF8) /* LD HL, SP+/-imm */
 	{
 		/* Taken from SameBoy, which is released under MIT Licence. */
 		int8_t offset = (int8_t) __gb_read(gb, gb->cpu_reg.pc.reg++);
@@ -3234,11 +4148,11 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0xF9: /* LD SP, HL */
+	PGB_OP(0xF9) /* LD SP, HL */
 		gb->cpu_reg.sp.reg = gb->cpu_reg.hl.reg;
 		break;
 
-	case 0xFA: /* LD A, (imm) */
+	PGB_OP(0xFA) /* LD A, (imm) */
 	{
 		uint8_t h, l;
 		uint16_t addr;
@@ -3249,163 +4163,50 @@ void __gb_step_cpu(struct gb_s *gb)
 		break;
 	}
 
-	case 0xFB: /* EI */
+	PGB_OP(0xFB) /* EI */
 		gb->gb_ime = true;
 		break;
 
-	case 0xFE: /* CP imm */
+	PGB_OP(0xFE) /* CP imm */
 	{
 		uint8_t val = __gb_read(gb, gb->cpu_reg.pc.reg++);
 		PGB_INSTR_CP_R8(val);
 		break;
 	}
 
-	case 0xFF: /* RST 0x0038 */
+	PGB_OP(0xFF) /* RST 0x0038 */
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.p);
 		__gb_write(gb, --gb->cpu_reg.sp.reg, gb->cpu_reg.pc.bytes.c);
 		gb->cpu_reg.pc.reg = 0x0038;
 		break;
 
-	default:
+	PGB_OP_INVALID
 		/* Return address where invalid opcode that was read. */
 		(gb->gb_error)(gb, GB_INVALID_OPCODE, gb->cpu_reg.pc.reg - 1);
 		PGB_UNREACHABLE();
 	}
+#if PEANUT_GB_COMPUTED_GOTO
+	while(0);
+#endif
 
-	do
+	/* Nothing else happens until the next scheduled event. */
+	if(PGB_LIKELY(!gb->gb_halt) &&
+		(int32_t)(gb->counter.cycles + inst_cycles -
+			  gb->counter.next_event) < 0)
 	{
-		/* DIV register timing */
-		gb->counter.div_count += inst_cycles;
-		while(gb->counter.div_count >= DIV_CYCLES)
-		{
-			gb->hram_io[IO_DIV]++;
-			gb->counter.div_count -= DIV_CYCLES;
-		}
-
-		/* Check for RTC tick. */
-		if(gb->mbc == 3 && (gb->rtc_real.reg.high & 0x40) == 0)
-		{
-			gb->counter.rtc_count += inst_cycles;
-			while(PGB_UNLIKELY(gb->counter.rtc_count >= RTC_CYCLES))
-			{
-				gb->counter.rtc_count -= RTC_CYCLES;
-
-				/* Detect invalid rollover. */
-				if(PGB_UNLIKELY(gb->rtc_real.reg.sec == 63))
-				{
-					gb->rtc_real.reg.sec = 0;
-					continue;
-				}
-
-				if(++gb->rtc_real.reg.sec != 60)
-					continue;
-
-				gb->rtc_real.reg.sec = 0;
-				if(gb->rtc_real.reg.min == 63)
-				{
-					gb->rtc_real.reg.min = 0;
-					continue;
-				}
-				if(++gb->rtc_real.reg.min != 60)
-					continue;
-
-				gb->rtc_real.reg.min = 0;
-				if(gb->rtc_real.reg.hour == 31)
-				{
-					gb->rtc_real.reg.hour = 0;
-					continue;
-				}
-				if(++gb->rtc_real.reg.hour != 24)
-					continue;
-
-				gb->rtc_real.reg.hour = 0;
-				if(++gb->rtc_real.reg.yday != 0)
-					continue;
-
-				if(gb->rtc_real.reg.high & 1)  /* Bit 8 of days*/
-					gb->rtc_real.reg.high |= 0x80; /* Overflow bit */
-
-				gb->rtc_real.reg.high ^= 1;
-			}
-		}
-
-		/* Check serial transmission. */
-		if(gb->hram_io[IO_SC] & SERIAL_SC_TX_START)
-		{
-			/* If new transfer, call TX function. */
-			if(gb->counter.serial_count == 0 &&
-				gb->gb_serial_tx != NULL)
-				(gb->gb_serial_tx)(gb, gb->hram_io[IO_SB]);
-
-			gb->counter.serial_count += inst_cycles;
-
-			/* If it's time to receive byte, call RX function. */
-			if(gb->counter.serial_count >= SERIAL_CYCLES)
-			{
-				/* If RX can be done, do it. */
-				/* If RX failed, do not change SB if using external
-				 * clock, or set to 0xFF if using internal clock. */
-				uint8_t rx;
-
-				if(gb->gb_serial_rx != NULL &&
-					(gb->gb_serial_rx(gb, &rx) ==
-						GB_SERIAL_RX_SUCCESS))
-				{
-					gb->hram_io[IO_SB] = rx;
-
-					/* Inform game of serial TX/RX completion. */
-					gb->hram_io[IO_SC] &= 0x01;
-					gb->hram_io[IO_IF] |= SERIAL_INTR;
-				}
-				else if(gb->hram_io[IO_SC] & SERIAL_SC_CLOCK_SRC)
-				{
-					/* If using internal clock, and console is not
-					 * attached to any external peripheral, shifted
-					 * bits are replaced with logic 1. */
-					gb->hram_io[IO_SB] = 0xFF;
-
-					/* Inform game of serial TX/RX completion. */
-					gb->hram_io[IO_SC] &= 0x01;
-					gb->hram_io[IO_IF] |= SERIAL_INTR;
-				}
-				else
-				{
-					/* If using external clock, and console is not
-					 * attached to any external peripheral, bits are
-					 * not shifted, so SB is not modified. */
-				}
-
-				gb->counter.serial_count = 0;
-			}
-		}
-
-		/* TIMA register timing */
-		/* TODO: Change tac_enable to struct of TAC timer control bits. */
-		if(gb->hram_io[IO_TAC] & IO_TAC_ENABLE_MASK)
-		{
-			gb->counter.tima_count += inst_cycles;
-
-			while(gb->counter.tima_count >=
-				TAC_CYCLES[gb->hram_io[IO_TAC] & IO_TAC_RATE_MASK])
-			{
-				gb->counter.tima_count -=
-					TAC_CYCLES[gb->hram_io[IO_TAC] & IO_TAC_RATE_MASK];
+		gb->counter.cycles += inst_cycles;
+		return;
+	}
 
-				if(++gb->hram_io[IO_TIMA] == 0)
-				{
-					gb->hram_io[IO_IF] |= TIMER_INTR;
-					/* On overflow, set TMA to TIMA. */
-					gb->hram_io[IO_TIMA] = gb->hram_io[IO_TMA];
-				}
-			}
-		}
+	do
+	{
+		gb->counter.cycles += inst_cycles;
+		__gb_sync_counters(gb);
 
-		/* If LCD is off, don't update LCD state or increase the LCD
-		 * ticks. Instead, keep track of the amount of time that is
-		 * being passed. */
+		/* If LCD is off, don't update LCD state. Instead, keep track
+		 * of the amount of time that is being passed. */
 		if(!(gb->hram_io[IO_LCDC] & LCDC_ENABLE))
 		{
-			gb->counter.lcd_off_count += inst_cycles;
 			if(gb->counter.lcd_off_count >= LCD_FRAME_CYCLES)
 			{
 				gb->counter.lcd_off_count -= LCD_FRAME_CYCLES;
@@ -3414,9 +4215,6 @@ void __gb_step_cpu(struct gb_s *gb)
 			continue;
 		}
 
-		/* LCD Timing */
-		gb->counter.lcd_count += inst_cycles;
-
 		/* New Scanline. HBlank -> VBlank or OAM Scan */
 		if(gb->counter.lcd_count >= LCD_LINE_CYCLES)
 		{
@@ -3524,6 +4322,8 @@ void __gb_step_cpu(struct gb_s *gb)
 		}
 	} while(gb->gb_halt && (gb->hram_io[IO_IF] & gb->hram_io[IO_IE]) == 0);
 	/* If halted, loop until an interrupt occurs. */
+
+	__gb_schedule_event(gb);
 }
 
 void gb_run_frame(struct gb_s *gb)
@@ -3562,6 +4362,12 @@ void gb_init_serial(struct gb_s *gb,
 	gb->gb_serial_rx = gb_serial_rx;
 }
 
+void gb_init_joypad(struct gb_s *gb,
+		    uint8_t (*gb_joypad_read)(struct gb_s*))
+{
+	gb->gb_joypad_read = gb_joypad_read;
+}
+
 uint8_t gb_colour_hash(struct gb_s *gb)
 {
 #define ROM_TITLE_START_ADDR	0x0134
@@ -3590,6 +4396,10 @@ void gb_reset(struct gb_s *gb)
 	gb->enable_cart_ram = 0;
 	gb->cart_mode_select = 0;
 
+	/* The boot ROM stays mapped until the game writes to IO_BOOT. */
+	gb->hram_io[IO_BOOT] = (gb->gb_bootrom_read == NULL) ? 0x01 : 0x00;
+	__gb_update_mem_map(gb);
+
 	/* Use values as though the boot ROM was already executed. */
 	if(gb->gb_bootrom_read == NULL)
 	{
@@ -3610,7 +4420,6 @@ void gb_reset(struct gb_s *gb)
 		gb->hram_io[IO_DIV ] = 0xAB;
 		gb->hram_io[IO_LCDC] = 0x91;
 		gb->hram_io[IO_STAT] = 0x85;
-		gb->hram_io[IO_BOOT] = 0x01;
 
 		__gb_write(gb, 0xFF26, 0xF1);
 
@@ -3624,7 +4433,6 @@ void gb_reset(struct gb_s *gb)
 		gb->hram_io[IO_DIV ] = 0x00;
 		gb->hram_io[IO_LCDC] = 0x00;
 		gb->hram_io[IO_STAT] = 0x84;
-		gb->hram_io[IO_BOOT] = 0x00;
 	}
 
 	gb->counter.lcd_count = 0;
@@ -3633,6 +4441,19 @@ void gb_reset(struct gb_s *gb)
 	gb->counter.serial_count = 0;
 	gb->counter.rtc_count = 0;
 	gb->counter.lcd_off_count = 0;
+	gb->counter.cycles = 0;
+	gb->counter.sync_cycles = 0;
+	gb->counter.next_event = 0;
+#if PEANUT_GB_IDLE_LOOP_SKIP
+	gb->idle.hits = 0;
+	gb->idle.skipped_cycles = 0;
+#endif
+#if PEANUT_GB_TILE_CACHE
+	memset(gb->tile_cache.dirty, 0xFF, sizeof(gb->tile_cache.dirty));
+#endif
+#if ENABLE_LCD && PEANUT_GB_HIGH_LCD_ACCURACY
+	gb->sprite_lines.obj_size = 0xFF;
+#endif
 
 	gb->direct.joypad = 0xFF;
 	gb->hram_io[IO_JOYP] = 0xCF;
@@ -3712,6 +4533,11 @@ enum gb_init_error_e gb_init(struct gb_s *gb,
 	gb->gb_serial_rx = NULL;
 
 	gb->gb_bootrom_read = NULL;
+	gb->gb_joypad_read = NULL;
+
+	gb->rom_ptr = NULL;
+	gb->rom_size = 0;
+	gb->rom_bank0 = NULL;
 
 	/* Check valid ROM using checksum value. */
 	{
@@ -3800,6 +4626,19 @@ void gb_set_bootrom(struct gb_s *gb,
 	gb->gb_bootrom_read = gb_bootrom_read;
 }
 
+void gb_init_rom_ptr(struct gb_s *gb, const uint8_t *rom, size_t size)
+{
+	gb->rom_ptr = rom;
+	gb->rom_size = size;
+	__gb_update_mem_map(gb);
+}
+
+void gb_set_rom_bank0(struct gb_s *gb, const uint8_t *bank0)
+{
+	gb->rom_bank0 = bank0;
+	__gb_update_mem_map(gb);
+}
+
 /**
  * Deprecated. Will be removed in the next major version.
  */
@@ -3909,6 +4748,20 @@ void gb_init_serial(struct gb_s *gb,
 		    enum gb_serial_rx_ret_e (*gb_serial_rx)(struct gb_s*,
 			    uint8_t*));
 
+/**
+ * Reads the joypad from the front-end each time the game reads the P1
+ * register, instead of using direct.joypad as set before gb_run_frame().
+ * This lets the front-end pass input that arrived during the frame. The
+ * value read is also stored in direct.joypad.
+ *
+ * \param gb	An initialised emulator context. Must not be NULL.
+ * \param gb_joypad_read Pointer to function that returns the joypad state,
+ *		active low as direct.joypad (JOYPAD_* bits). NULL returns to
+ *		direct.joypad.
+ */
+void gb_init_joypad(struct gb_s *gb,
+		    uint8_t (*gb_joypad_read)(struct gb_s*));
+
 /**
  * Obtains the save size of the game (size of the Cart RAM). Required by the
  * frontend to allocate enough memory for the Cart RAM.
@@ -3961,6 +4814,33 @@ void gb_set_rtc(struct gb_s *gb, const struct tm * const time);
 void gb_set_bootrom(struct gb_s *gb,
 	uint8_t (*gb_bootrom_read)(struct gb_s*, const uint_fast16_t));
 
+/**
+ * Read ROM directly from memory instead of calling gb_rom_read(). The current
+ * ROM bank is mapped into the memory map, so opcode and operand fetches become
+ * a plain load. gb_rom_read() is still used for banks outside of the image.
+ * Should be called after gb_init(). Not required for ROMs that are streamed
+ * or paged in by the front-end.
+ *
+ * \param gb	An initialised emulator context. Must not be NULL.
+ * \param rom	Pointer to the whole ROM image. Must stay valid while the
+ *		context is in use. NULL disables direct access.
+ * \param size	Size of the ROM image in bytes.
+ */
+void gb_init_rom_ptr(struct gb_s *gb, const uint8_t *rom, size_t size);
+
+/**
+ * Read ROM bank 0 (0x0000-0x3FFF) from a separate copy, such as one in RAM
+ * when the image passed to gb_init_rom_ptr() is in slower memory. The
+ * switchable banks are still read from the image. Only used together with
+ * gb_init_rom_ptr().
+ *
+ * \param gb	An initialised emulator context. Must not be NULL.
+ * \param bank0	Pointer to the first ROM_BANK_SIZE bytes of the ROM. Must
+ *		stay valid while the context is in use. NULL reads bank 0
+ *		from the image again.
+ */
+void gb_set_rom_bank0(struct gb_s *gb, const uint8_t *bank0);
+
 /* Undefine CPU Flag helper functions. */
 #undef PEANUT_GB_CPUFLAG_MASK_CARRY
 #undef PEANUT_GB_CPUFLAG_MASK_HALFC
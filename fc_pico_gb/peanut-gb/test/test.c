@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "dmg-acid2.gb.h" /* Generated via `xxd -i` */
+#include "cpu_instrs.h"
 
 /* Hash of correct LCD output for DMG-Acid2 Test. */
 #define DMG_ACID2_HASH 0xF91DF416u
@@ -48,7 +49,6 @@ static uint32_t fnv1a_hash(const void *data, size_t len)
  */
 uint8_t gb_rom_read_cpu_instrs(struct gb_s *gb, const uint_fast32_t addr)
 {
-#include "cpu_instrs.h"
 	assert(addr < cpu_instrs_gb_len);
 	return cpu_instrs_gb[addr];
 }
@@ -150,6 +150,74 @@ void test_cpu_inst(void)
 	return;
 }
 
+/* Same as test_cpu_inst, but the ROM is read through gb_init_rom_ptr(). */
+void test_cpu_inst_rom_ptr(void)
+{
+	struct gb_s gb;
+	const unsigned short pc_end = 0x06F1; /* Test ends when PC is this value. */
+	struct priv p = { .count = 0 };
+	enum gb_init_error_e gb_err;
+
+	/* Run ROM test. */
+	gb_err = gb_init(&gb, &gb_rom_read_cpu_instrs, &gb_cart_ram_read,
+			&gb_cart_ram_write, &gb_error, &p);
+	lok(gb_err == GB_INIT_NO_ERROR);
+	if(gb_err != GB_INIT_NO_ERROR)
+		return;
+
+	gb_init_rom_ptr(&gb, cpu_instrs_gb, cpu_instrs_gb_len);
+	gb_init_serial(&gb, &gb_serial_tx, NULL);
+
+	printf("Serial: ");
+
+	/* Step CPU until test is complete. */
+	while(gb.cpu_reg.pc.reg != pc_end)
+		__gb_step_cpu(&gb);
+
+	p.str[p.count++] = '\0';
+
+	/* Check test results. */
+	lok(strstr(p.str, "Passed all tests") != NULL);
+
+	return;
+}
+
+/* Same as test_cpu_inst_rom_ptr, with bank 0 read from a separate copy. */
+void test_cpu_inst_rom_bank0(void)
+{
+	struct gb_s gb;
+	const unsigned short pc_end = 0x06F1; /* Test ends when PC is this value. */
+	struct priv p = { .count = 0 };
+	enum gb_init_error_e gb_err;
+	static uint8_t bank0[ROM_BANK_SIZE];
+
+	/* Run ROM test. */
+	gb_err = gb_init(&gb, &gb_rom_read_cpu_instrs, &gb_cart_ram_read,
+			&gb_cart_ram_write, &gb_error, &p);
+	lok(gb_err == GB_INIT_NO_ERROR);
+	if(gb_err != GB_INIT_NO_ERROR)
+		return;
+
+	memcpy(bank0, cpu_instrs_gb, sizeof(bank0));
+	gb_init_rom_ptr(&gb, cpu_instrs_gb, cpu_instrs_gb_len);
+	gb_set_rom_bank0(&gb, bank0);
+	lok(gb.map_read[0x1] == bank0 + 0x1000);
+	gb_init_serial(&gb, &gb_serial_tx, NULL);
+
+	printf("Serial: ");
+
+	/* Step CPU until test is complete. */
+	while(gb.cpu_reg.pc.reg != pc_end)
+		__gb_step_cpu(&gb);
+
+	p.str[p.count++] = '\0';
+
+	/* Check test results. */
+	lok(strstr(p.str, "Passed all tests") != NULL);
+
+	return;
+}
+
 void test_instr_timing(void)
 {
 	struct gb_s gb;
@@ -209,6 +277,8 @@ void test_dmg_acid2(void)
 int main(void)
 {
 	lrun("cpu_inst blarrg tests    ", test_cpu_inst);
+	lrun("cpu_inst direct ROM      ", test_cpu_inst_rom_ptr);
+	lrun("cpu_inst direct bank 0   ", test_cpu_inst_rom_bank0);
 	lrun("instr_timing blarrg tests", test_instr_timing);
 	lrun("dmg-acid2 lcd test     ", test_dmg_acid2);
 	return lfails != 0;
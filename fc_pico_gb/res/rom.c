@@ -660,22 +660,22 @@ const unsigned char _rom[32768] = {
 	0xa9, 0x00, 0x8d, 0x08, 0x40, 0xa9, 0x40, 0x8d, 0x17, 0x40, 0xa9, 0x00,
 	0x8d, 0x10, 0x40, 0xa9, 0x0f, 0x8d, 0x15, 0x40, 0x4c, 0x00, 0xf0, 0x20,
 	0x36, 0x95, 0x48, 0x8a, 0x48, 0x98, 0x48, 0xa5, 0x3f, 0xd0, 0x07, 0xa9,
-	0x05, 0x8d, 0x07, 0x20, 0xe6, 0x3f, 0xa5, 0x40, 0xaa, 0xc9, 0xc0, 0xd0,
-	0x0c, 0xa5, 0x41, 0xc9, 0x60, 0xd0, 0x03, 0x4c, 0x2d, 0x9f, 0x4c, 0x9c,
-	0x9f, 0x8a, 0x29, 0xf0, 0xc9, 0xa0, 0xd0, 0x0e, 0xa5, 0x41, 0x29, 0xc0,
-	0xc9, 0x40, 0xf0, 0x03, 0x4c, 0x9c, 0x9f, 0x4c, 0x37, 0x9f, 0x4c, 0x9c,
-	0x9f, 0xa9, 0x00, 0x8d, 0x15, 0x40, 0x85, 0x40, 0x4c, 0x9c, 0x9f, 0xa5,
-	0x41, 0x29, 0x3f, 0x8d, 0x0c, 0x40, 0xa5, 0x42, 0x8d, 0x0e, 0x40, 0x8a,
-	0x29, 0x08, 0xf0, 0x05, 0xa5, 0x43, 0x8d, 0x0f, 0x40, 0xa5, 0x44, 0x8d,
-	0x00, 0x40, 0xa5, 0x45, 0x8d, 0x01, 0x40, 0xa5, 0x46, 0x8d, 0x02, 0x40,
-	0x8a, 0x29, 0x01, 0xf0, 0x05, 0xa5, 0x47, 0x8d, 0x03, 0x40, 0xa5, 0x48,
-	0x8d, 0x04, 0x40, 0xa5, 0x49, 0x8d, 0x05, 0x40, 0xa5, 0x4a, 0x8d, 0x06,
-	0x40, 0x8a, 0x29, 0x02, 0xf0, 0x05, 0xa5, 0x4b, 0x8d, 0x07, 0x40, 0xa5,
-	0x4c, 0x8d, 0x08, 0x40, 0xa5, 0x4d, 0x8d, 0x0a, 0x40, 0x8a, 0x29, 0x04,
-	0xf0, 0x05, 0xa5, 0x4e, 0x8d, 0x0b, 0x40, 0xa5, 0x4f, 0x8d, 0x15, 0x40,
-	0xa9, 0x00, 0x85, 0x40, 0x68, 0xa8, 0x68, 0xaa, 0x68, 0x60, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0x05, 0x8d, 0x07, 0x20, 0xe6, 0x3f, 0xa5, 0x40, 0xc9, 0xd0, 0xd0, 0x0d,
+	0xa5, 0x41, 0xc9, 0x70, 0xd0, 0x07, 0x8d, 0xa0, 0x05, 0xa9, 0x00, 0x85,
+	0x40, 0xa5, 0x40, 0xaa, 0xc9, 0xc0, 0xd0, 0x0c, 0xa5, 0x41, 0xc9, 0x60,
+	0xd0, 0x03, 0x4c, 0x40, 0x9f, 0x4c, 0xaf, 0x9f, 0x8a, 0x29, 0xf0, 0xc9,
+	0xa0, 0xd0, 0x0e, 0xa5, 0x41, 0x29, 0xc0, 0xc9, 0x40, 0xf0, 0x03, 0x4c,
+	0xaf, 0x9f, 0x4c, 0x4a, 0x9f, 0x4c, 0xaf, 0x9f, 0xa9, 0x00, 0x8d, 0x15,
+	0x40, 0x85, 0x40, 0x4c, 0xaf, 0x9f, 0xa5, 0x41, 0x29, 0x3f, 0x8d, 0x0c,
+	0x40, 0xa5, 0x42, 0x8d, 0x0e, 0x40, 0x8a, 0x29, 0x08, 0xf0, 0x05, 0xa5,
+	0x43, 0x8d, 0x0f, 0x40, 0xa5, 0x44, 0x8d, 0x00, 0x40, 0xa5, 0x45, 0x8d,
+	0x01, 0x40, 0xa5, 0x46, 0x8d, 0x02, 0x40, 0x8a, 0x29, 0x01, 0xf0, 0x05,
+	0xa5, 0x47, 0x8d, 0x03, 0x40, 0xa5, 0x48, 0x8d, 0x04, 0x40, 0xa5, 0x49,
+	0x8d, 0x05, 0x40, 0xa5, 0x4a, 0x8d, 0x06, 0x40, 0x8a, 0x29, 0x02, 0xf0,
+	0x05, 0xa5, 0x4b, 0x8d, 0x07, 0x40, 0xa5, 0x4c, 0x8d, 0x08, 0x40, 0xa5,
+	0x4d, 0x8d, 0x0a, 0x40, 0x8a, 0x29, 0x04, 0xf0, 0x05, 0xa5, 0x4e, 0x8d,
+	0x0b, 0x40, 0xa5, 0x4f, 0x8d, 0x15, 0x40, 0xa9, 0x00, 0x85, 0x40, 0x20,
+	0xae, 0xd4, 0x68, 0xa8, 0x68, 0xaa, 0x68, 0x60, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -1780,38 +1780,38 @@ const unsigned char _rom[32768] = {
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xbd, 0x81, 0x05, 0x29, 0x3f, 0x8d, 0x0c, 0x40,
+	0xbd, 0x82, 0x05, 0x8d, 0x0e, 0x40, 0xbd, 0x80, 0x05, 0x29, 0x08, 0xf0,
+	0x06, 0xbd, 0x83, 0x05, 0x8d, 0x0f, 0x40, 0xbd, 0x84, 0x05, 0x8d, 0x00,
+	0x40, 0xbd, 0x85, 0x05, 0x8d, 0x01, 0x40, 0xbd, 0x86, 0x05, 0x8d, 0x02,
+	0x40, 0xbd, 0x80, 0x05, 0x29, 0x01, 0xf0, 0x06, 0xbd, 0x87, 0x05, 0x8d,
+	0x03, 0x40, 0xbd, 0x88, 0x05, 0x8d, 0x04, 0x40, 0xbd, 0x89, 0x05, 0x8d,
+	0x05, 0x40, 0xbd, 0x8a, 0x05, 0x8d, 0x06, 0x40, 0xbd, 0x80, 0x05, 0x29,
+	0x02, 0xf0, 0x06, 0xbd, 0x8b, 0x05, 0x8d, 0x07, 0x40, 0xbd, 0x8c, 0x05,
+	0x8d, 0x08, 0x40, 0xbd, 0x8d, 0x05, 0x8d, 0x0a, 0x40, 0xbd, 0x80, 0x05,
+	0x29, 0x04, 0xf0, 0x06, 0xbd, 0x8e, 0x05, 0x8d, 0x0b, 0x40, 0xbd, 0x8f,
+	0x05, 0x8d, 0x15, 0x40, 0x60, 0xbd, 0x80, 0x05, 0x8d, 0xa2, 0x05, 0xbd,
+	0x81, 0x05, 0x8d, 0xa3, 0x05, 0xbd, 0x82, 0x05, 0x29, 0x20, 0x8d, 0xa4,
+	0x05, 0xe8, 0xe8, 0xe8, 0xa0, 0x00, 0x4e, 0xa4, 0x05, 0x6e, 0xa3, 0x05,
+	0x6e, 0xa2, 0x05, 0x90, 0x07, 0xbd, 0x80, 0x05, 0x99, 0x00, 0x40, 0xe8,
+	0xc8, 0xc0, 0x16, 0xd0, 0xe9, 0x60, 0xa9, 0x00, 0x8d, 0x15, 0x40, 0x60,
+	0xec, 0xa1, 0x05, 0x90, 0x01, 0x60, 0xbd, 0x80, 0x05, 0x29, 0x3f, 0x8d,
+	0x06, 0x20, 0xa8, 0xbd, 0x81, 0x05, 0x8d, 0x06, 0x20, 0xbd, 0x82, 0x05,
+	0x8d, 0x07, 0x20, 0xc0, 0x3f, 0xd0, 0x0c, 0xbd, 0x81, 0x05, 0x29, 0x1f,
+	0xa8, 0xbd, 0x82, 0x05, 0x99, 0x10, 0x01, 0xe8, 0xe8, 0xe8, 0x4c, 0x30,
+	0xd4, 0xad, 0x80, 0x05, 0xc9, 0xfc, 0xd0, 0x2c, 0xa2, 0x01, 0xe0, 0x20,
+	0xb0, 0x26, 0xbd, 0x80, 0x05, 0xf0, 0x21, 0xe8, 0x48, 0x29, 0x1f, 0x8e,
+	0xa1, 0x05, 0x18, 0x6d, 0xa1, 0x05, 0x8d, 0xa1, 0x05, 0x68, 0x29, 0xe0,
+	0xc9, 0x60, 0xd0, 0x06, 0x20, 0x30, 0xd4, 0x4c, 0x8e, 0xd4, 0xae, 0xa1,
+	0x05, 0x4c, 0x6a, 0xd4, 0x60, 0xad, 0xa0, 0x05, 0xf0, 0x0e, 0xa2, 0xe0,
+	0xad, 0x07, 0x20, 0x9d, 0xa0, 0x04, 0xe8, 0xd0, 0xf7, 0x20, 0x61, 0xd4,
+	0xa9, 0x08, 0x8d, 0x06, 0x20, 0x60, 0xad, 0x80, 0x05, 0xc9, 0xfc, 0xd0,
+	0x40, 0xa2, 0x01, 0xe0, 0x20, 0xb0, 0x3a, 0xbd, 0x80, 0x05, 0xf0, 0x35,
+	0xe8, 0x48, 0x29, 0x1f, 0x8e, 0xa1, 0x05, 0x18, 0x6d, 0xa1, 0x05, 0x8d,
+	0xa1, 0x05, 0x68, 0x29, 0xe0, 0xc9, 0x80, 0xd0, 0x06, 0x20, 0xf9, 0xd3,
+	0x4c, 0xef, 0xd4, 0xc9, 0x20, 0xd0, 0x06, 0x20, 0x80, 0xd3, 0x4c, 0xef,
+	0xd4, 0xc9, 0x40, 0xd0, 0x06, 0x20, 0x2a, 0xd4, 0x4c, 0xef, 0xd4, 0xae,
+	0xa1, 0x05, 0x4c, 0xb7, 0xd4, 0x60, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -2336,7 +2336,7 @@ const unsigned char _rom[32768] = {
 	0x20, 0x85, 0x48, 0xad, 0x07, 0x20, 0x85, 0x49, 0xad, 0x07, 0x20, 0x85,
 	0x4a, 0xad, 0x07, 0x20, 0x85, 0x4b, 0xad, 0x07, 0x20, 0x85, 0x4c, 0xad,
 	0x07, 0x20, 0x85, 0x4d, 0xad, 0x07, 0x20, 0x85, 0x4e, 0xad, 0x07, 0x20,
-	0x85, 0x4f, 0xa9, 0x08, 0x8d, 0x06, 0x20, 0xa9, 0x00, 0x8d, 0x06, 0x20,
+	0x85, 0x4f, 0x20, 0x95, 0xd4, 0xea, 0xea, 0xa9, 0x00, 0x8d, 0x06, 0x20,
 	0xa5, 0x50, 0xf0, 0x07, 0x8d, 0x07, 0x20, 0xa9, 0x00, 0x85, 0x50, 0xa5,
 	0x85, 0x8d, 0x07, 0x20, 0xa5, 0xb0, 0x8d, 0x00, 0x20, 0xa5, 0xb1, 0x8d,
 	0x01, 0x20, 0xa5, 0x94, 0x8d, 0x05, 0x20, 0xa5, 0xb2, 0xc9, 0xef, 0x90,
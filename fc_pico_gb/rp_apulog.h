@@ -0,0 +1,210 @@
+/*
+    rp_apulog.h - Cycle-timestamped log of the GB APU register writes of a frame
+    Header only, without Arduino dependencies, so that host tools can use it
+
+    rp_gbapu only keeps the latest register values, which the mapper samples
+    once per frame. The log keeps every write of the frame with the GB cycle
+    it happened at, and scan() replays them into channel events, so that
+    notes shorter than a frame (drum hits, quick retriggers, arpeggio steps)
+    can still be told apart.
+*/
+
+#ifndef rp_apulog_h
+#define rp_apulog_h
+
+#include <stdint.h>
+#include <string.h>
+
+#include "rp_gbapu.h"
+
+#define APULOG_SIZE  64           // Writes kept per GB frame
+#define APULOG_REGS  (NR52 + 1)   // Registers replayed (not the wave RAM)
+
+struct apulog_write {
+    uint32_t cycle;  // GB cycles since the start of the frame
+    uint8_t reg;     // Offset from 0xFF10 (NRxx)
+    uint8_t val;
+};
+
+// Channel events found in the writes of a frame
+enum {
+    APULOG_EV_TRIGGER = 0,  // Note start, with the frequency and volume
+    APULOG_EV_PITCH,        // Frequency change without a trigger
+    APULOG_EV_STOP,         // DAC off (wave: volume 0), or the APU off
+};
+
+struct apulog_event {
+    uint32_t cycle;  // GB cycles since the start of the frame
+    uint8_t ch;      // GB channel 0-3
+    uint8_t type;    // APULOG_EV_*
+    uint8_t volume;  // Initial volume at a trigger (wave: NR32 level 0-3)
+    uint16_t freq;   // 11-bit frequency, NR43 for the noise channel
+};
+
+class rp_apulog {
+public:
+    rp_apulog() {
+        memset(m_regs, 0, sizeof(m_regs));
+        m_enabled = false;
+        m_start = 0;
+        m_count = 0;
+        m_lost = 0;
+    }
+
+    // Start the log of a frame. regs: the APU registers (offset from
+    // 0xFF10) before the first write, enabled: NR52 bit 7.
+    void beginFrame(uint32_t cycles, const uint8_t* regs, bool enabled) {
+        memcpy(m_regs, regs, APULOG_REGS);
+        m_enabled = enabled;
+        m_start = cycles;
+        m_count = 0;
+    }
+
+    // cycles: the emulator cycle counter, which may wrap around
+    void add(uint32_t cycles, uint8_t reg, uint8_t val) {
+        if (m_count >= APULOG_SIZE) {
+            m_lost++;
+            return;
+        }
+        apulog_write& w = m_writes[m_count++];
+        w.cycle = cycles - m_start;
+        w.reg = reg;
+        w.val = val;
+    }
+
+    uint8_t count() const { return m_count; }
+    const apulog_write& at(uint8_t i) const { return m_writes[i]; }
+
+    // Writes dropped because a frame had more than APULOG_SIZE
+    uint32_t getLost() const { return m_lost; }
+
+    // Replay the writes of the frame over the registers it started with,
+    // as rp_gbapu::write() applies them. Stores up to max events in ev,
+    // in the order they happened, and returns their number.
+    uint8_t scan(apulog_event* ev, uint8_t max) const {
+        uint8_t regs[APULOG_REGS];
+        memcpy(regs, m_regs, sizeof(regs));
+        bool enabled = m_enabled;
+        uint8_t n = 0;
+
+        for (uint8_t i = 0; i < m_count; i++) {
+            const apulog_write& w = m_writes[i];
+            if (w.reg == NR52) {
+                bool on = (w.val & 0x80) != 0;
+                if (enabled && !on) {
+                    for (uint8_t ch = 0; ch < 4; ch++) {
+                        push(ev, max, &n, w.cycle, ch, APULOG_EV_STOP, 0, 0);
+                    }
+                    memset(regs, 0, NR52);
+                }
+                enabled = on;
+                continue;
+            }
+            if (w.reg >= APULOG_REGS || !enabled) {
+                continue;
+            }
+
+            uint8_t old = regs[w.reg];
+            regs[w.reg] = w.val;
+
+            switch (w.reg) {
+                case NR13: case NR23: case NR33:
+                case NR14: case NR24: case NR34: {
+                    // NRx3 / NRx4 are 5 registers apart for channels 0-2
+                    uint8_t ch = (w.reg - NR13) / 5;
+                    bool lo = (w.reg == NR13 + ch * 5);
+                    uint8_t nrx3 = NR13 + ch * 5;
+                    uint16_t freq = regs[nrx3] | ((regs[nrx3 + 1] & 0x07) << 8);
+                    if (!lo && (w.val & 0x80)) {
+                        uint8_t volume = (ch == 2) ? (regs[NR32] >> 5) & 0x03
+                                                   : regs[nrx3 - 1] >> 4;
+                        push(ev, max, &n, w.cycle, ch, APULOG_EV_TRIGGER, volume, freq);
+                    } else {
+                        uint16_t prev = lo ? (old | ((regs[nrx3 + 1] & 0x07) << 8))
+                                           : (regs[nrx3] | ((old & 0x07) << 8));
+                        if (prev != freq) {
+                            push(ev, max, &n, w.cycle, ch, APULOG_EV_PITCH, 0, freq);
+                        }
+                    }
+                    break;
+                }
+
+                case NR43:
+                    if (old != w.val) {
+                        push(ev, max, &n, w.cycle, 3, APULOG_EV_PITCH, 0, w.val);
+                    }
+                    break;
+
+                case NR44:
+                    if (w.val & 0x80) {
+                        push(ev, max, &n, w.cycle, 3, APULOG_EV_TRIGGER, regs[NR42] >> 4, regs[NR43]);
+                    }
+                    break;
+
+                case NR12: case NR22: case NR42:
+                    if ((w.val & 0xF8) == 0) {
+                        uint8_t ch = (w.reg == NR12) ? 0 : (w.reg == NR22) ? 1 : 3;
+                        push(ev, max, &n, w.cycle, ch, APULOG_EV_STOP, 0, 0);
+                    }
+                    break;
+
+                case NR30:
+                    if ((w.val & 0x80) == 0) {
+                        push(ev, max, &n, w.cycle, 2, APULOG_EV_STOP, 0, 0);
+                    }
+                    break;
+
+                case NR32:
+                    if (((w.val >> 5) & 0x03) == 0) {
+                        push(ev, max, &n, w.cycle, 2, APULOG_EV_STOP, 0, 0);
+                    }
+                    break;
+            }
+        }
+        return n;
+    }
+
+private:
+    static void push(apulog_event* ev, uint8_t max, uint8_t* n, uint32_t cycle,
+                     uint8_t ch, uint8_t type, uint8_t volume, uint16_t freq) {
+        if (*n >= max) {
+            return;
+        }
+        apulog_event& e = ev[(*n)++];
+        e.cycle = cycle;
+        e.ch = ch;
+        e.type = type;
+        e.volume = volume;
+        e.freq = freq;
+    }
+
+    uint8_t m_regs[APULOG_REGS];  // Registers at the start of the frame
+    bool m_enabled;
+    uint32_t m_start;             // Cycle counter at the start of the frame
+    apulog_write m_writes[APULOG_SIZE];
+    uint8_t m_count;
+    uint32_t m_lost;
+};
+
+// A note of channel ch that was started and stopped again within the frame,
+// so that sampling the registers at the end of the frame misses it. trig
+// gets its trigger event.
+static inline bool apulogShortNote(const apulog_event* ev, uint8_t n, uint8_t ch, apulog_event* trig) {
+    bool found = false;
+    bool stopped = false;
+    for (uint8_t i = 0; i < n; i++) {
+        if (ev[i].ch != ch) {
+            continue;
+        }
+        if (ev[i].type == APULOG_EV_TRIGGER) {
+            *trig = ev[i];
+            found = true;
+            stopped = false;
+        } else if (ev[i].type == APULOG_EV_STOP) {
+            stopped = found;
+        }
+    }
+    return stopped;
+}
+
+#endif
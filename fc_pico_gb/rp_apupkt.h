@@ -0,0 +1,148 @@
+/*
+    rp_apupkt.h - APU register packets for the FC command area
+    Header only, without Arduino dependencies, so that host tools can use it
+*/
+
+#ifndef rp_apupkt_h
+#define rp_apupkt_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define APUPKT_REGS       24   // $4000-$4017
+#define APUPKT_FULL_LEN   16   // Full APU Update (0xAx) block
+#define APUPKT_MASK_LEN   3    // Delta: register bitmask, little endian
+#define APUPKT_DELTA_MAX  (APUPKT_MASK_LEN + 15)
+
+// Registers the FC writes: $4000-$4008, $400A-$400C, $400E-$400F, $4015.
+// The FC decoder ignores the other bits of $4010-$4017 (no data for them).
+#define APUPKT_REG_MASK   0x20DDFFu
+
+// Full APU Update magic / check bytes, see fc_rom/patch_apu.py
+#define APUPKT_MAGIC_FULL 0xA0
+#define APUPKT_CHECK_FULL 0x40
+
+// $4003/$4007/$400B/$400F reset the channel phase when written, so they
+// are only sent when bit (reg >> 2) of writeMask is set
+static inline bool apuPktPhaseReg(uint8_t reg) {
+    return reg < 0x10 && (reg & 3) == 3;
+}
+
+// Bit of m_apuWriteMask set by a write to reg: 1 << ch for a phase register
+static inline uint8_t apuPktWriteFlag(uint8_t reg) {
+    return apuPktPhaseReg(reg) ? (uint8_t)(1 << (reg >> 2)) : 0;
+}
+
+// writeMask of a packet. A channel's phase register is sent when it was
+// written in this frame but not in the last one (a new note), or when the
+// period changed. Drivers that write it every frame do not restart the
+// phase each time. flags/flagsPrev are the write flags of this and the
+// last frame, prev the registers of the last packet.
+static inline uint8_t apuPktWriteMask(const uint8_t* latest, const uint8_t* prev,
+                                      uint8_t flags, uint8_t flagsPrev) {
+    // Pulse $4003/$4007: only the period bits, the rest is the length load
+    static const uint8_t hi_mask[4] = {0x07, 0x07, 0xFF, 0xFF};
+    uint8_t writeMask = 0;
+    for (uint8_t ch = 0; ch < 4; ch++) {
+        uint8_t lo = ch * 4 + 2;
+        uint8_t hi = ch * 4 + 3;
+        bool new_write = ((flags & ~flagsPrev) >> ch) & 1;
+        bool period_changed = latest[lo] != prev[lo] ||
+                              (latest[hi] & hi_mask[ch]) != (prev[hi] & hi_mask[ch]);
+        if (new_write || period_changed) {
+            writeMask |= 1 << ch;
+        }
+    }
+    return writeMask;
+}
+
+// The values sent for the latest register writes: hardware sweep disabled
+// in $4001/$4005 (the GB sweep is done by the emulation), and the unused
+// top bits of $400C cleared, since the full block puts its check bits there.
+static inline void apuPktRegs(uint8_t* regs, const uint8_t* latest) {
+    memcpy(regs, latest, APUPKT_REGS);
+    regs[0x01] &= 0x7F;
+    regs[0x05] &= 0x7F;
+    regs[0x0C] &= 0x3F;
+}
+
+// Full APU Update block (16 bytes). regs are the values to send, with
+// the hardware sweep already disabled in $4001/$4005.
+static inline void apuPktFull(uint8_t* dt, const uint8_t* regs, uint8_t writeMask) {
+    dt[0]  = APUPKT_MAGIC_FULL | writeMask;
+    dt[1]  = APUPKT_CHECK_FULL | (regs[0x0C] & 0x3F);  // $400C: Noise Vol (検証付き)
+    dt[2]  = regs[0x0E];   // $400E: Noise Mode/Period
+    dt[3]  = regs[0x0F];   // $400F: Noise Length
+    dt[4]  = regs[0x00];   // $4000: Pulse1 Duty/Vol
+    dt[5]  = regs[0x01];   // $4001: Pulse1 Sweep
+    dt[6]  = regs[0x02];   // $4002: Pulse1 Freq Lo
+    dt[7]  = regs[0x03];   // $4003: Pulse1 Freq Hi
+    dt[8]  = regs[0x04];   // $4004: Pulse2 Duty/Vol
+    dt[9]  = regs[0x05];   // $4005: Pulse2 Sweep
+    dt[10] = regs[0x06];   // $4006: Pulse2 Freq Lo
+    dt[11] = regs[0x07];   // $4007: Pulse2 Freq Hi
+    dt[12] = regs[0x08];   // $4008: Triangle Linear
+    dt[13] = regs[0x0A];   // $400A: Triangle Freq Lo
+    dt[14] = regs[0x0B];   // $400B: Triangle Freq Hi
+    dt[15] = regs[0x15];   // $4015: Status/Enable (最後に書き込み)
+}
+
+// Delta packet: the registers that differ from what the FC was last sent
+// (sent[], updated here), plus the phase registers allowed by writeMask.
+// Data = bitmask (bit n = $4000 + n), then the values in register order.
+// Returns the data length, or 0 when nothing has to be sent.
+static inline uint8_t apuPktDelta(uint8_t* dt, const uint8_t* regs, uint8_t* sent, uint8_t writeMask) {
+    uint32_t mask = 0;
+    uint8_t n = APUPKT_MASK_LEN;
+    for (uint8_t reg = 0; reg < APUPKT_REGS; reg++) {
+        if (!((APUPKT_REG_MASK >> reg) & 1)) {
+            continue;
+        }
+        bool send = apuPktPhaseReg(reg) ? ((writeMask >> (reg >> 2)) & 1) : (regs[reg] != sent[reg]);
+        if (send) {
+            mask |= 1u << reg;
+            dt[n++] = regs[reg];
+            sent[reg] = regs[reg];
+        }
+    }
+    if (mask == 0) {
+        return 0;
+    }
+    dt[0] = (uint8_t)mask;
+    dt[1] = (uint8_t)(mask >> 8);
+    dt[2] = (uint8_t)(mask >> 16);
+    return n;
+}
+
+// What the FC does with the packets, for host tests: the register writes
+// are applied to apu[APUPKT_REGS] and also counted in writes[] if given.
+static inline void apuPktApplyFull(const uint8_t* dt, uint8_t* apu, uint32_t* writes = 0) {
+    static const uint8_t layout[14] = {
+        0x0E, 0x0F, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x0A, 0x0B, 0x15
+    };
+    uint8_t writeMask = dt[0] & 0x0F;
+    apu[0x0C] = dt[1] & 0x3F;
+    if (writes) writes[0x0C]++;
+    for (uint8_t i = 0; i < 14; i++) {
+        uint8_t reg = layout[i];
+        if (apuPktPhaseReg(reg) && !((writeMask >> (reg >> 2)) & 1)) {
+            continue;
+        }
+        apu[reg] = dt[2 + i];
+        if (writes) writes[reg]++;
+    }
+}
+
+static inline void apuPktApplyDelta(const uint8_t* dt, uint8_t* apu, uint32_t* writes = 0) {
+    // Like the 6502 decoder: only $4015 is taken from the top byte
+    uint32_t mask = (dt[0] | (dt[1] << 8) | ((uint32_t)dt[2] << 16)) & (APUPKT_REG_MASK | 0xFFFF);
+    const uint8_t* v = dt + APUPKT_MASK_LEN;
+    for (uint8_t reg = 0; mask != 0; reg++, mask >>= 1) {
+        if (mask & 1) {
+            apu[reg] = *v++;
+            if (writes) writes[reg]++;
+        }
+    }
+}
+
+#endif
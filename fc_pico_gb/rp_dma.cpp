@@ -6,6 +6,7 @@
 
 
 #include "Arduino.h"
+#include "hardware/sync.h"
 #include "rp_dma.h"
 
 
@@ -19,12 +20,21 @@ void initDMA(void) {
 			dma_channel_unclaim(i);
 		}
 	}
+	dmaPoolInit();
 }
 
 
 rp_dma::rp_dma(void) {
 //	Serial.println("rp_dma::rp_dma");
 //	dma_chan = -1;
+	dma_chan2 = -1;
+}
+
+
+static void setChainTo( int ch, int to ) {
+	dma_channel_config c = dma_get_channel_config( ch );
+	channel_config_set_chain_to( &c, to );
+	dma_channel_set_config( ch, &c, false );
 }
 
 
@@ -144,6 +154,33 @@ Sniff Enable	false
 }
 
 
+//----------------------------------------------------------
+//
+//  ステートマシン DMA送信 連結チャンネル初期化
+//  initSM_DMA_TX() の後に呼ぶ。TransSM_DMA_Chain() で1つめの
+//  転送が終わると、同じ SM へ2つめのバッファを続けて送る
+//
+//----------------------------------------------------------
+int rp_dma::initSM_DMA_TX_Chain() {
+	dma_chan2 = dma_claim_unused_channel(true);
+
+	// 書き込み先と DREQ は1つめのチャンネルと同じ
+	dma_channel_config dma_chan_config = dma_get_channel_config(dma_chan);
+	channel_config_set_chain_to(&dma_chan_config, dma_chan2);
+
+	dma_channel_configure(
+	  dma_chan2,
+	  &dma_chan_config,
+	  (volatile void *)(uintptr_t)dma_hw->ch[dma_chan].write_addr,
+	  NULL,
+	  0,
+	  false
+	);
+
+	return dma_chan2;
+}
+
+
 //	転送開始
 void rp_dma::TransSM_DMA( uint32_t *buf, int buf_size ) {
 	StopDMA();
@@ -154,8 +191,26 @@ void rp_dma::TransSM_DMA( uint32_t *buf, int buf_size ) {
 	  buf_size );  // number of transfers
 }
 
-//	転送開始
+//	転送開始: buf の後に buf2 (CPU を介さずに連結)
+void rp_dma::TransSM_DMA_Chain( uint32_t *buf, int buf_size, uint32_t *buf2, int buf2_size ) {
+	StopDMA();
+
+	dma_channel_set_read_addr( dma_chan2, buf2, false );
+	dma_channel_set_trans_count( dma_chan2, buf2_size, false );
+	setChainTo( dma_chan, dma_chan2 );
+
+	dma_channel_transfer_from_buffer_now( dma_chan, buf, buf_size );
+}
+
+//	転送停止
 void rp_dma::StopDMA() {
+	if ( dma_chan2 >= 0 ) {
+		// 連結を外してから止める (止めた転送から2つめが起動しないように)
+		setChainTo( dma_chan, dma_chan );
+		dma_channel_abort( dma_chan );
+		dma_channel_abort( dma_chan2 );
+		return;
+	}
 	dma_channel_abort( dma_chan );
 }
 
@@ -163,79 +218,123 @@ void rp_dma::StopDMA() {
 
 //----------------------------------------------------------
 //
-//  DMAを使ったメモリー転送（動作検証中）
+//  DMAを使ったメモリー転送 (rp_dmacopy.h のプールを使う)
 //
 //----------------------------------------------------------
-int rp_dma::memcpyDMA(void *DstBuf, const void *SrcBuf, size_t n) {
-	int dma_chan = dma_claim_unused_channel(true);
-	//  取得したDMAチャンネルの構成情報を取得する
-	dma_channel_config dma_chan_config = dma_channel_get_default_config(dma_chan);
-
-	/* default_config
-Read Increment	true
-Write Increment	false
-DReq	DREQ_FORCE
-Chain to	self
-Data size	DMA_SIZE_32
-Ring	write=false, size=0 (i.e. off)
-Byte Swap	false
-Quiet IRQs	false
-High Priority	false
-Channel Enable	true
-Sniff Enable	false
-*/
-	channel_config_set_transfer_data_size(&dma_chan_config, DMA_SIZE_8);
-	channel_config_set_write_increment(&dma_chan_config, true);
+dma_job rp_dma::memcpyDMA(void *DstBuf, const void *SrcBuf, size_t n) {
+	return dmaCopyAsync( DstBuf, SrcBuf, n, 1 );
+}
 
-	//  DMAチャンネル構成情報を設定する
-	dma_channel_configure(
-	  dma_chan,
-	  &dma_chan_config,
-	  DstBuf,
-	  SrcBuf,  // 読み出し元
-	  n,
-	  true  // スタートタイミング（即時スタートの場合はtrue）
-	);
-	return dma_chan;
+dma_job rp_dma::memcpyDMA32(void *DstBuf, const void *SrcBuf, size_t n) {
+	return dmaCopyAsync( DstBuf, SrcBuf, n * sizeof(uint32_t), 4 );
 }
 
 
+
 //----------------------------------------------------------
 //
-//  DMAを使ったメモリー転送（動作検証中）
+//  DMA プール: 非同期メモリー転送 / 塗りつぶし
+//  initDMA() で DMA_POOL_NUM チャンネルを確保しておき、空いている
+//  チャンネルで転送する。空きがなければ CPU で済ませる
 //
 //----------------------------------------------------------
-int rp_dma::memcpyDMA32(void *DstBuf, const void *SrcBuf, size_t n) {
-	int dma_chan = dma_claim_unused_channel(true);
-	//  取得したDMAチャンネルの構成情報を取得する
-	dma_channel_config dma_chan_config = dma_channel_get_default_config(dma_chan);
+struct dma_pool_slot {
+	int chan;		// -1 = 確保できなかった
+	uint32_t seq;	// このチャンネルの最後のジョブ番号
+	uint32_t fill;	// 塗りつぶしの値 (DMA が読む)
+};
+static dma_pool_slot dma_pool[DMA_POOL_NUM];
+static uint32_t dma_pool_seq;
+static spin_lock_t *dma_pool_lock;
+
+// handle = ジョブ番号 << 4 | スロット
+#define DMA_JOB_SLOT	0x0F
+
+void dmaPoolInit() {
+	// 両コアから使うので、スロットの割り当ては spin lock で守る
+	if ( dma_pool_lock == NULL ) {
+		dma_pool_lock = spin_lock_init( spin_lock_claim_unused( true ) );
+	}
+	for ( int i = 0; i < DMA_POOL_NUM; i++ ) {
+		dma_pool[i].chan = dma_claim_unused_channel( false );
+		dma_pool[i].seq = 0;
+	}
+}
 
-	/* default_config
-Read Increment	true
-Write Increment	false
-DReq	DREQ_FORCE
-Chain to	self
-Data size	DMA_SIZE_32
-Ring	write=false, size=0 (i.e. off)
-Byte Swap	false
-Quiet IRQs	false
-High Priority	false
-Channel Enable	true
-Sniff Enable	false
-*/
-	channel_config_set_write_increment(&dma_chan_config, true);
+static bool dmaFits( const void *p, size_t n, uint8_t size ) {
+	return (size == 1 || size == 2 || size == 4)
+		&& ((uintptr_t)p % size) == 0 && (n % size) == 0;
+}
 
-	//  DMAチャンネル構成情報を設定する
-	dma_channel_configure(
-	  dma_chan,
-	  &dma_chan_config,
-	  DstBuf,
-	  SrcBuf,  // 読み出し元
-	  n,
-	  true  // スタートタイミング（即時スタートの場合はtrue）
-	);
+// 空いているチャンネルで転送を始める。空きがなければ DMA_JOB_DONE
+static dma_job dmaStart( void *dst, const void *src, size_t n, uint8_t size, bool fill, uint32_t value ) {
+	uint32_t irq = spin_lock_blocking( dma_pool_lock );
 
-	return dma_chan;
+	int slot;
+	for ( slot = 0; slot < DMA_POOL_NUM; slot++ ) {
+		if ( dma_pool[slot].chan >= 0 && !dma_channel_is_busy( dma_pool[slot].chan ) ) {
+			break;
+		}
+	}
+	if ( slot == DMA_POOL_NUM ) {
+		spin_unlock( dma_pool_lock, irq );
+		return DMA_JOB_DONE;
+	}
+
+	dma_pool_slot *ps = &dma_pool[slot];
+	if ( ++dma_pool_seq > (UINT32_MAX >> 4) ) {
+		dma_pool_seq = 1;
+	}
+	ps->seq = dma_pool_seq;
+	ps->fill = value;
+
+	dma_channel_config c = dma_channel_get_default_config( ps->chan );
+	channel_config_set_transfer_data_size( &c,
+		size == 4 ? DMA_SIZE_32 : (size == 2 ? DMA_SIZE_16 : DMA_SIZE_8) );
+	channel_config_set_read_increment( &c, !fill );
+	channel_config_set_write_increment( &c, true );
+	dma_channel_configure( ps->chan, &c, dst, fill ? &ps->fill : src, n / size, true );
+
+	dma_job job = (ps->seq << 4) | slot;
+	spin_unlock( dma_pool_lock, irq );
+	return job;
+}
+
+dma_job dmaCopyAsync( void *dst, const void *src, size_t n, uint8_t size ) {
+	dma_job job = DMA_JOB_DONE;
+	if ( n != 0 && dmaFits( dst, n, size ) && dmaFits( src, n, size ) ) {
+		job = dmaStart( dst, src, n, size, false, 0 );
+	}
+	if ( job == DMA_JOB_DONE ) {
+		memcpy( dst, src, n );
+	}
+	return job;
+}
+
+dma_job dmaFillAsync( void *dst, uint32_t value, size_t n, uint8_t size ) {
+	dma_job job = DMA_JOB_DONE;
+	if ( n != 0 && dmaFits( dst, n, size ) ) {
+		job = dmaStart( dst, NULL, n, size, true, value );
+	}
+	if ( job == DMA_JOB_DONE ) {
+		dmaFillSync( dst, value, n, size );
+	}
+	return job;
+}
+
+bool dmaBusy( dma_job job ) {
+	if ( job == DMA_JOB_DONE ) {
+		return false;
+	}
+	dma_pool_slot *ps = &dma_pool[ job & DMA_JOB_SLOT ];
+	// スロットが次のジョブに使われていれば、このジョブは終わっている
+	return ps->seq == (job >> 4) && dma_channel_is_busy( ps->chan );
+}
+
+void dmaWait( dma_job job ) {
+	while ( dmaBusy( job ) ) {
+		tight_loop_contents();
+	}
 }
 
 
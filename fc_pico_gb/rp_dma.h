@@ -8,6 +8,7 @@
 #include "Arduino.h"
 #include "hardware/pio.h"
 #include "hardware/dma.h"
+#include "rp_dmacopy.h"
 
 
 class rp_dma {
@@ -16,12 +17,15 @@ public:
     rp_dma();
 	int initSM_DMA_RX( int pio_no, int sm, uint32_t *buf, int size );
     int initSM_DMA_TX( int pio_no, int sm, uint32_t *buf, int size );
+	int initSM_DMA_TX_Chain();
 	void TransSM_DMA( uint32_t *buf, int buf_size );
+	void TransSM_DMA_Chain( uint32_t *buf, int buf_size, uint32_t *buf2, int buf2_size );
 	void StopDMA();
-	int memcpyDMA(void *DstBuf, const void *SrcBuf, size_t n);
-	int memcpyDMA32(void *DstBuf, const void *SrcBuf, size_t n);
+	dma_job memcpyDMA(void *DstBuf, const void *SrcBuf, size_t n);
+	dma_job memcpyDMA32(void *DstBuf, const void *SrcBuf, size_t n);
 private:
 	int dma_chan;
+	int dma_chan2;		// initSM_DMA_TX_Chain(), -1 = none
 };
 
 void initDMA(void);
@@ -0,0 +1,65 @@
+/*
+    rp_dmacopy.h - Asynchronous memory copy / fill on a pool of DMA channels
+    On the Pico the jobs run on DMA_POOL_NUM channels that initDMA()
+    claims (rp_dma.cpp). Elsewhere (host tools) they are done at once with
+    memcpy / memset, so code using them runs unchanged on a host.
+*/
+
+#ifndef rp_dmacopy_h
+#define rp_dmacopy_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DMA_POOL_NUM	2
+
+// Completion handle. DMA_JOB_DONE: the job was finished before the call
+// returned, because no channel was free or the buffers did not suit a DMA
+// transfer.
+typedef uint32_t dma_job;
+#define DMA_JOB_DONE	0
+
+// size: bytes per transfer, 1, 2 or 4. dst, src and n should be multiples
+// of it, or the job is done by the CPU. A fill repeats the low size bytes
+// of value.
+static inline void dmaFillSync( void *dst, uint32_t value, size_t n, uint8_t size ) {
+	if ( size == 1 ) {
+		memset( dst, (uint8_t)value, n );
+		return;
+	}
+	uint8_t *d = (uint8_t *)dst;
+	for ( size_t i = 0; i + size <= n; i += size ) {
+		memcpy( d + i, &value, size );	// little endian, as the DMA reads it
+	}
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+
+void dmaPoolInit();
+dma_job dmaCopyAsync( void *dst, const void *src, size_t n, uint8_t size = 4 );
+dma_job dmaFillAsync( void *dst, uint32_t value, size_t n, uint8_t size = 4 );
+bool dmaBusy( dma_job job );
+void dmaWait( dma_job job );
+
+#else
+
+static inline void dmaPoolInit() {}
+
+static inline dma_job dmaCopyAsync( void *dst, const void *src, size_t n, uint8_t size = 4 ) {
+	(void)size;
+	memcpy( dst, src, n );
+	return DMA_JOB_DONE;
+}
+
+static inline dma_job dmaFillAsync( void *dst, uint32_t value, size_t n, uint8_t size = 4 ) {
+	dmaFillSync( dst, value, n, size );
+	return DMA_JOB_DONE;
+}
+
+static inline bool dmaBusy( dma_job job ) { (void)job; return false; }
+static inline void dmaWait( dma_job job ) { (void)job; }
+
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/*
+    rp_fclink.cpp - FC link protocol over rp_linkhal
+ */
+
+#include <string.h>
+
+#include "rp_fclink.h"
+#include "rp_linkhal.h"
+
+
+rp_fclink::rp_fclink() {
+	m_read_count = 0;
+	m_frames = 0;
+	m_frames_ext = 0;
+	m_frames_lost = 0;
+
+	for ( uint8_t i = 0; i < FC_TAIL_NUM; i++ ) {
+		clearTail( i );
+	}
+	m_tail_front = 0;
+	m_tail_back = 1;
+	m_tail_spare.store( 2 | FC_TAIL_CLEAN );
+	m_tails_cleared = 0;
+}
+
+void rp_fclink::init() {
+	linkInit();
+}
+
+
+uint8_t rp_fclink::getRcvCom() {
+	return linkRecvGet();
+}
+
+bool rp_fclink::isRcvEmpty() {
+	return linkRecvEmpty();
+}
+
+
+uint32_t rp_fclink::beginFrame() {
+	linkTranRestart();
+
+	// １フレームのPPUデータ出力回数カウント
+	m_read_count = linkTakeReadCount();
+
+	// The FC reads FC_COM_BUF alone, or followed by the extended area
+	if ( (m_read_count >= (PPU_COUNT_EXT -2) ) && (m_read_count <= PPU_COUNT_EXT ) ) {
+		m_frames++;
+		m_frames_ext++;
+		return PPU_COUNT_EXT;
+	}
+	if ( (m_read_count >= (PPU_COUNT_VAL -2) ) && (m_read_count <= PPU_COUNT_VAL ) ) {
+		m_frames++;
+		return PPU_COUNT_VAL;
+	}
+	m_frames_lost++;
+	return 0;
+}
+
+void rp_fclink::sendFrame( uint32_t count, const uint32_t *buf ) {
+	// フレームデータの後にコマンドを連結して送る
+	// (拡張コマンド領域は FC が読まない時も送っておく)
+	linkDmaChain( buf, FC_FRAME_WORDS, m_tails[m_tail_back], FC_TAIL_WORDS );
+	if ( m_read_count == (count -2) ) {
+		linkTranSkip();
+		linkTranSkip();
+	}
+	if ( m_read_count == (count -1) ) {
+		linkTranSkip();
+	}
+
+	// The last front is no longer read. The spare is normally cleared by
+	// the main loop, unless it has not run since the last vsync.
+	uint8_t spare = m_tail_spare.load( std::memory_order_relaxed );
+	if ( !(spare & FC_TAIL_CLEAN) ) {
+		clearTail( spare & FC_TAIL_INDEX );
+		m_tails_cleared++;
+	}
+	uint8_t front = m_tail_front;
+	m_tail_front = m_tail_back;
+	m_tail_back = spare & FC_TAIL_INDEX;
+	m_tail_spare.store( front, std::memory_order_release );
+}
+
+void rp_fclink::prepareTail() {
+	uint8_t spare = m_tail_spare.load( std::memory_order_acquire );
+	if ( spare & FC_TAIL_CLEAN ) {
+		return;
+	}
+	clearTail( spare );
+	// sendFrame() may have moved on meanwhile: the new spare stays dirty
+	m_tail_spare.compare_exchange_strong( spare, spare | FC_TAIL_CLEAN, std::memory_order_acq_rel );
+}
+
+void rp_fclink::clearTail( uint8_t i ) {
+	memset( m_tails[i], 0, sizeof(m_tails[i]) );
+	uint8_t *com = tailCom( i );
+	com[1] = PF_MAGIC_NO;
+	com[FC_COM_BUF_SIZE] = PF_MAGIC_NO;
+}
+
+void rp_fclink::stopFrame() {
+	linkDmaStop();
+}
+
+
+void rp_fclink::sendData( const void *src, uint32_t words, const uint32_t *head, uint8_t head_words ) {
+	linkTranRestart();
+	linkDmaStop();
+	for ( uint8_t i = 0; i < head_words; i++ ) {
+		linkTranPut( head[i] );
+	}
+	if ( words != 0 ) {
+		linkDmaStart( src, words );
+	}
+}
+
+void rp_fclink::put( uint32_t w ) {
+	linkTranPut( w );
+}
@@ -0,0 +1,146 @@
+/*
+    rp_fclink.h - FC link protocol over rp_linkhal
+    The PPU stream of each frame with the command tail, and the replies of
+    the BIOS and data modes. No Arduino dependencies, so that host tools
+    (tools/linksim.cpp) can run it against a simulated FC.
+*/
+
+#ifndef rp_fclink_h
+#define rp_fclink_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+//---------------------------------------
+// PICO->FC command
+//---------------------------------------
+enum{
+	PF_COM_NONE = 0,		// コマンドなし
+	PF_COM_DMOD = 1,		// 表示OFFにしてデータ転送モードへ
+	PF_COM_FDIN = 2,		// フェードイン	処理終了　FP_COM_ACK
+	PF_COM_FDOT = 3,		// フェードアウト	処理終了　FP_COM_ACK
+
+	PF_COM_SE   = 0x80,		// SEセット:0x80 + SE_NO
+	PF_COM_VRAM = 0xC0,		// VRAM 書き換え:adrH,ardL,dt
+
+
+	// データモードコマンド
+	PF_DAT_VRAM = 0x80,		//  VRAM 書き換え:adrH,ardL,size,data....
+							//  --> size = 0 は256バイト 256バイト以上送りたい場合は分割して送る
+	PF_DAT_RAM  = 0x81, 	//  VRAM 書き換え:adrH,ardL,size,data....
+
+	PF_DAT_STEP = 0x82, 	//  データモードを抜けてファミコンの指定ステップへ
+
+	PF_MAGIC_NO = 0xFC	// 受け取ったコマンドの可否チェックコード
+};
+
+//---------------------------------------
+// PICO->FC extended command area records
+// header = type | data length (0-31), then the data
+//---------------------------------------
+enum{
+	PF_EXT_END  = 0x00,		// end of the records
+	PF_EXT_APU  = 0x20,		// APU block: 16 bytes, same layout as the 0xAx command
+	PF_EXT_APU_OFF = 0x40,	// APU silence: no data
+	PF_EXT_VRAM = 0x60,		// VRAM pokes: adrH,adrL,dt ... written in vblank
+	PF_EXT_APU_DELTA = 0x80,	// APU registers that changed: 3 mask bytes + values (rp_apupkt.h)
+};
+#define PF_EXT_LEN_MASK	0x1F
+
+//---------------------------------------
+// FC->PICO command
+//---------------------------------------
+enum{
+//	FP_COM_ACK	= 0x0F,		// FCからのコマンド正常終了応答
+//	FP_COM_NAK	= 0x1F,		// FCからのコマンド失敗終了応答
+	FP_COM_VER	= 0x2F,		// BIOS-ROM romvarsion
+	FP_COM_ROM	= 0x3F,		// BIOS-ROM romdeta load
+
+	FP_COM_LOG	= 0xBF,		// debug log
+	FP_COM_DRQ	= 0xCF,		// data request
+	FP_COM_DLD	= 0xDF,		// data load
+	FP_COM_RST	= 0xEF,		// PICO RESTART
+	FP_COM_INI	= 0xFF,		// PIC INIT
+};
+
+#define FC_COM_BUF_SIZE	16
+
+// Extended command area, read after FC_COM_BUF by the patched FC ROM once
+// it has been enabled (fc_rom/patch_apu.py). FC_COM_EXT[0] = PF_MAGIC_NO,
+// then PF_EXT_* records.
+#define FC_COM_EXT_SIZE	32
+
+// FC reads of one frame: the PPU data, then FC_COM_BUF (and the extended
+// area) in the NMI
+#define PPU_COUNT_VAL	(15426 + FC_COM_BUF_SIZE)
+#define PPU_COUNT_EXT	(PPU_COUNT_VAL + FC_COM_EXT_SIZE)
+
+// The frame goes out as two chained DMA blocks: FC_FRAME_WORDS of the PPU
+// buffer, then a tail block of FC_TAIL_SKIP bytes of PPU data, FC_COM_BUF
+// and the extended area. The PPU data in the tail block is fetched after
+// the last line and never drawn, so it is always 0.
+#define FC_FRAME_WORDS	((PPU_COUNT_VAL - FC_COM_BUF_SIZE) / 4)
+#define FC_TAIL_SKIP	((PPU_COUNT_VAL - FC_COM_BUF_SIZE) % 4)
+#define FC_TAIL_WORDS	((FC_TAIL_SKIP + FC_COM_BUF_SIZE + FC_COM_EXT_SIZE + 3) / 4)
+
+// Tail blocks: sent by the DMA, filled by the main loop, cleared for next
+#define FC_TAIL_NUM		3
+#define FC_TAIL_INDEX	0x03
+#define FC_TAIL_CLEAN	0x80	// m_tail_spare: cleared by prepareTail()
+
+
+class rp_fclink {
+public:
+	rp_fclink();
+	void init();
+
+	// FC->PICO
+	uint8_t getRcvCom();	// waits for a byte
+	bool isRcvEmpty();
+
+	// At the FC's vsync write: restart the stream and the read count.
+	// Returns the length the FC read the last frame with, PPU_COUNT_VAL or
+	// PPU_COUNT_EXT (1-2 reads short are taken as well), 0 for neither.
+	uint32_t beginFrame();
+	// Send buf (at least FC_FRAME_WORDS) and the command tail as the next
+	// frame, after beginFrame() returned count != 0. The next tail is
+	// comBuf() from here on.
+	void sendFrame( uint32_t count, const uint32_t *buf );
+	// No frame: the FC reads whatever is on the bus until the next vsync
+	void stopFrame();
+
+	// BIOS / data mode: the head words, then words from src by DMA
+	void sendData( const void *src, uint32_t words, const uint32_t *head = NULL, uint8_t head_words = 0 );
+	void put( uint32_t w );
+
+	// Command tail of the next frame: FC_COM_BUF, then the extended area
+	uint8_t *comBuf() { return tailCom( m_tail_back ); }
+	uint8_t *extBuf() { return tailCom( m_tail_back ) + FC_COM_BUF_SIZE; }
+	// Main loop: clear the tail sendFrame() moves on to, so that the IRQ
+	// does not have to
+	void prepareTail();
+
+	uint32_t getReadCount() { return m_read_count; }	// FC reads of the last frame
+	uint32_t getFrames() { return m_frames; }
+	uint32_t getFramesExt() { return m_frames_ext; }	// of getFrames(), with the extended area
+	uint32_t getFramesLost() { return m_frames_lost; }	// vsyncs with a read count that fits neither
+	uint32_t getTailsCleared() { return m_tails_cleared; }	// tails sendFrame() had to clear itself
+
+private:
+	uint8_t *tailCom( uint8_t i ) { return (uint8_t *)m_tails[i] + FC_TAIL_SKIP; }
+	void clearTail( uint8_t i );
+
+	uint32_t m_tails[FC_TAIL_NUM][FC_TAIL_WORDS];
+	uint8_t m_tail_front;					// with the frame the FC reads now
+	volatile uint8_t m_tail_back;			// being filled
+	std::atomic<uint8_t> m_tail_spare;		// next back, FC_TAIL_CLEAN once cleared
+	uint32_t m_tails_cleared;
+
+	uint32_t m_read_count;
+	uint32_t m_frames;
+	uint32_t m_frames_ext;
+	uint32_t m_frames_lost;
+};
+
+#endif
@@ -5,9 +5,15 @@
 */
 
 #include "rp_gbapu.h"
-#include "rp_system.h"
+#include "rp_apulog.h"
+#include "rp_gbfreq.h"
+#include "rp_wavecache.h"
 #include <string.h>
 
+#if defined(ARDUINO_ARCH_RP2040)
+#include "rp_system.h"
+#endif
+
 #if APU_DEBUG_TRIGGER || APU_DEBUG_WAVE
 #include <Arduino.h>
 #endif
@@ -15,6 +21,13 @@
 // Global instance
 rp_gbapu gbapu;
 
+// Register writes of the current GB frame, and the events found in them
+static rp_apulog apu_log;
+static apulog_event apu_events[APULOG_SIZE];
+
+// Wave types of the recent wave RAM patterns
+static rp_wavecache wave_cache;
+
 // NES CPU clock frequency
 #define NES_CPU_FREQ 1789773
 
@@ -51,7 +64,12 @@ void rp_gbapu::init() {
 
     // Initialize wave analysis cache
     m_lastWaveType = WAVE_TYPE_UNKNOWN;
-    m_waveRamHash = 0;
+    m_waveDirty = true;
+    wave_cache.clear();
+    m_shortNotes = 0;
+
+    m_seqNext = 0;
+    m_seqStep = 0;
 
     // Initialize default register values
     m_regs[NR10] = 0x80;
@@ -97,6 +115,9 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
 
     // Handle NR52 (APU enable)
     if (offset == NR52) {
+        if (!m_enabled && (val & 0x80)) {
+            m_seqStep = 0;  // Power on restarts the frame sequencer
+        }
         m_enabled = (val & 0x80) != 0;
         if (!m_enabled) {
             // APU disabled - stop all channels
@@ -115,12 +136,33 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
         return;
     }
 
+    if (offset >= WAVE_RAM_START && m_regs[offset] != val) {
+        m_waveDirty = true;
+    }
     m_regs[offset] = val;
 
     // Handle trigger events
     switch (offset) {
+        case NR11:  // Length load
+            m_ch[0].length = 64 - (val & 0x3F);
+            break;
+
+        case NR21:
+            m_ch[1].length = 64 - (val & 0x3F);
+            break;
+
+        case NR31:
+            m_ch[2].length = 256 - val;
+            break;
+
+        case NR41:
+            m_ch[3].length = 64 - (val & 0x3F);
+            break;
+
         case NR14:  // Channel 1 trigger
+            m_ch[0].length_enabled = (val & 0x40) != 0;
             if (val & 0x80) {
+                reloadLength(0);
                 m_ch[0].active = true;
                 m_ch[0].triggered = true;  // Mark for phase reset in updatePulse1()
                 m_ch[0].duty = (m_regs[NR11] >> 6) & 0x03;
@@ -131,7 +173,7 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
                 m_ch[0].env_initial = (nr12 >> 4) & 0x0F;
                 m_ch[0].env_direction = (nr12 >> 3) & 0x01;
                 m_ch[0].env_period = nr12 & 0x07;
-                m_ch[0].env_counter = 0;
+                m_ch[0].env_timer = m_ch[0].env_period;
                 m_ch[0].volume = m_ch[0].env_initial;
 
                 // Initialize sweep (accurate GB behavior)
@@ -145,7 +187,6 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
 
                 // Reload divider (period 0 is treated as 8)
                 m_ch[0].sweep_divider = m_ch[0].sweep_period ? m_ch[0].sweep_period : 8;
-                m_ch[0].sweep_timer = 0;
 
                 // Enable sweep if period or shift is non-zero
                 m_ch[0].sweep_enabled = (m_ch[0].sweep_period != 0 || m_ch[0].sweep_shift != 0);
@@ -178,7 +219,9 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
             break;
 
         case NR24:  // Channel 2 trigger
+            m_ch[1].length_enabled = (val & 0x40) != 0;
             if (val & 0x80) {
+                reloadLength(1);
                 m_ch[1].active = true;
                 m_ch[1].triggered = true;  // Mark for phase reset in updatePulse2()
                 m_ch[1].duty = (m_regs[NR21] >> 6) & 0x03;
@@ -189,7 +232,7 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
                 m_ch[1].env_initial = (nr22 >> 4) & 0x0F;
                 m_ch[1].env_direction = (nr22 >> 3) & 0x01;
                 m_ch[1].env_period = nr22 & 0x07;
-                m_ch[1].env_counter = 0;
+                m_ch[1].env_timer = m_ch[1].env_period;
                 m_ch[1].volume = m_ch[1].env_initial;
 
 #if APU_DEBUG_TRIGGER
@@ -199,7 +242,9 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
             break;
 
         case NR34:  // Channel 3 trigger
+            m_ch[2].length_enabled = (val & 0x40) != 0;
             if (val & 0x80) {
+                reloadLength(2);
                 m_ch[2].active = (m_regs[NR30] & 0x80) != 0;  // DAC enable
                 m_ch[2].volume = (m_regs[NR32] >> 5) & 0x03;
                 m_ch[2].freq = m_regs[NR33] | ((m_regs[NR34] & 0x07) << 8);
@@ -208,20 +253,22 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
                 uint16_t nes_p3 = gbToNesTrianglePeriod(m_ch[2].freq);
                 Serial.printf("WV:v%d,gbf%d,nesp%d,nch%d,wt%d\n",
                     m_ch[2].volume, m_ch[2].freq, nes_p3,
-                    m_ch[2].nes_channel_used, m_ch[2].detected_wave_type);
+                    m_ch[2].nes_channel_used, getWaveType());
 #endif
             }
             break;
 
         case NR44:  // Channel 4 trigger
+            m_ch[3].length_enabled = (val & 0x40) != 0;
             if (val & 0x80) {
+                reloadLength(3);
                 m_ch[3].active = true;
                 // Initialize envelope
                 uint8_t nr42 = m_regs[NR42];
                 m_ch[3].env_initial = (nr42 >> 4) & 0x0F;
                 m_ch[3].env_direction = (nr42 >> 3) & 0x01;
                 m_ch[3].env_period = nr42 & 0x07;
-                m_ch[3].env_counter = 0;
+                m_ch[3].env_timer = m_ch[3].env_period;
                 m_ch[3].volume = m_ch[3].env_initial;
                 m_ch[3].last_nes_period = 0;
 #if APU_DEBUG_TRIGGER
@@ -275,37 +322,140 @@ void rp_gbapu::write(uint16_t addr, uint8_t val) {
     }
 }
 
-// Update envelope for a channel (called every frame at 60Hz)
-// GB envelope runs at 64Hz - use fractional counting for accuracy
-void rp_gbapu::updateEnvelope(uint8_t ch) {
-    if (!m_ch[ch].active || m_ch[ch].env_period == 0) {
+void rp_gbapu::beginFrame(uint32_t cycles, uint16_t div) {
+    // Follow DIV, which the game may have reset (the cycle counter is
+    // also reset with the GB)
+    clockTo(cycles);
+    m_seqNext = cycles + GB_SEQ_CYCLES - div % GB_SEQ_CYCLES;
+
+    apu_log.beginFrame(cycles, m_regs, m_enabled);
+}
+
+void rp_gbapu::logWrite(uint16_t addr, uint8_t val, uint32_t cycles) {
+    if (addr < GB_APU_REG_START || addr > GB_APU_REG_END) {
         return;
     }
+    apu_log.add(cycles, addr - GB_APU_REG_START, val);
+}
 
-    // Fractional timing: accumulate 64 ticks per second at 60Hz update rate
-    // Each frame adds 64/60 ≈ 1.067 ticks
-    // Use fixed-point: 64 * 256 / 60 = 273 per frame (8.8 fixed point)
-    m_ch[ch].env_counter += 273;
+const rp_apulog& rp_gbapu::getWriteLog() {
+    return apu_log;
+}
 
-    // Trigger envelope step when counter reaches threshold (env_period * 256)
-    uint16_t threshold = (uint16_t)m_ch[ch].env_period * 256;
-    if (m_ch[ch].env_counter >= threshold) {
-        m_ch[ch].env_counter -= threshold;
+// A note started and stopped again within the frame (drum hit, quick
+// retrigger) is inactive when the frame is sampled. Play it for this frame
+// from its trigger in the write log, and stop it with the next update.
+void rp_gbapu::playShortNotes() {
+    uint8_t n = apu_log.scan(apu_events, APULOG_SIZE);
+    static const uint8_t channels[] = { 0, 1, 3 };  // Wave: stop_requested
+    for (uint8_t i = 0; i < sizeof(channels); i++) {
+        uint8_t ch = channels[i];
+        apulog_event trig;
+        if (m_ch[ch].active || !apulogShortNote(apu_events, n, ch, &trig) || trig.volume == 0) {
+            continue;
+        }
+        m_ch[ch].active = true;
+        m_ch[ch].triggered = true;
+        m_ch[ch].short_note = true;
+        m_ch[ch].volume = trig.volume;
+        if (ch == 0) {
+            m_ch[0].freq = trig.freq;  // Pulse1 freq is set at trigger
+        }
+        m_shortNotes++;
+    }
+}
 
-        if (m_ch[ch].env_direction) {
-            // Increase volume
-            if (m_ch[ch].volume < 15) {
-                m_ch[ch].volume++;
-            }
-        } else {
-            // Decrease volume
-            if (m_ch[ch].volume > 0) {
-                m_ch[ch].volume--;
-            }
+void rp_gbapu::endShortNotes() {
+    for (uint8_t ch = 0; ch < 4; ch++) {
+        if (m_ch[ch].short_note) {
+            m_ch[ch].short_note = false;
+            m_ch[ch].active = false;
         }
     }
 }
 
+// Steps k in [first, first + steps) with k % period == phase
+static inline uint32_t seqCount(uint32_t first, uint32_t steps, uint32_t period, uint32_t phase) {
+    return (first + steps + period - 1 - phase) / period - (first + period - 1 - phase) / period;
+}
+
+// Frame sequencer steps from the last call up to cycles, applied at once.
+// Between two calls the channel registers do not change, so the order of
+// the clocks within the interval does not matter.
+void rp_gbapu::clockTo(uint32_t cycles) {
+    if ((int32_t)(cycles - m_seqNext) < 0) {
+        return;
+    }
+    uint32_t steps = (cycles - m_seqNext) / GB_SEQ_CYCLES + 1;
+    m_seqNext += steps * GB_SEQ_CYCLES;
+
+    uint32_t first = m_seqStep;
+    m_seqStep = (first + steps) & 7;
+    if (!m_enabled) {
+        return;
+    }
+
+    uint32_t length_clocks = seqCount(first, steps, 2, 0);
+    for (uint8_t ch = 0; ch < 4; ch++) {
+        clockLength(ch, length_clocks);
+    }
+    clockSweep(seqCount(first, steps, 4, 2));
+    uint32_t env_clocks = seqCount(first, steps, 8, 7);
+    clockEnvelope(0, env_clocks);
+    clockEnvelope(1, env_clocks);
+    clockEnvelope(3, env_clocks);
+}
+
+// Length counter: the channel stops when it reaches 0
+void rp_gbapu::clockLength(uint8_t ch, uint32_t clocks) {
+    if (!m_ch[ch].length_enabled || m_ch[ch].length == 0 || clocks == 0) {
+        return;
+    }
+    if (clocks < m_ch[ch].length) {
+        m_ch[ch].length -= clocks;
+        return;
+    }
+    m_ch[ch].length = 0;
+    m_ch[ch].active = false;
+    if (ch == 2) {
+        m_ch[2].stop_requested = true;
+    }
+}
+
+// Trigger with an expired length counter: full length
+void rp_gbapu::reloadLength(uint8_t ch) {
+    if (m_ch[ch].length == 0) {
+        m_ch[ch].length = (ch == 2) ? 256 : 64;
+    }
+}
+
+// Envelope: one volume step every env_period clocks (64Hz)
+void rp_gbapu::clockEnvelope(uint8_t ch, uint32_t clocks) {
+    if (!m_ch[ch].active || m_ch[ch].env_period == 0 || clocks == 0) {
+        return;
+    }
+    if (m_ch[ch].env_timer == 0) {
+        m_ch[ch].env_timer = m_ch[ch].env_period;
+    }
+    if (clocks < m_ch[ch].env_timer) {
+        m_ch[ch].env_timer -= clocks;
+        return;
+    }
+
+    clocks -= m_ch[ch].env_timer;
+    uint32_t env_steps = 1 + clocks / m_ch[ch].env_period;
+    m_ch[ch].env_timer = m_ch[ch].env_period - clocks % m_ch[ch].env_period;
+
+    if (m_ch[ch].env_direction) {
+        // Increase volume
+        uint32_t volume = m_ch[ch].volume + env_steps;
+        m_ch[ch].volume = (volume > 15) ? 15 : volume;
+    } else {
+        // Decrease volume
+        m_ch[ch].volume = (env_steps > m_ch[ch].volume) ? 0 : m_ch[ch].volume - env_steps;
+    }
+}
+
 // Calculate new sweep frequency and check for overflow
 // Returns new frequency, or 0xFFFF if overflow (channel should be disabled)
 static uint16_t calcSweepFreq(gb_channel* ch) {
@@ -332,59 +482,51 @@ static uint16_t calcSweepFreq(gb_channel* ch) {
     }
 }
 
-// Update sweep for channel 1 (called every frame at 60Hz)
-// GB sweep runs at 128Hz - we use fractional timing for accuracy
+// Sweep for channel 1, clocked at 128Hz
 // Accurate implementation based on GB APU behavior:
 // - Shadow frequency is used for calculations
-// - Period 0 is treated as 8
-// - Overflow check happens before applying new frequency
+// - Period 0 is treated as 8 for the divider, and does not sweep
+// - Overflow check happens before applying new frequency, and again after
 // - Negate usage disables subsequent addition
-void rp_gbapu::updateSweep() {
-    if (!m_ch[0].active) {
-        return;
-    }
-
-    // Fractional timing: accumulate 128 ticks per second at 60Hz update rate
-    // Use fixed-point: 128 * 256 / 60 = 546 per frame (8.8 fixed point)
-    m_ch[0].sweep_timer += 546;
-
-    // Clock sweep at 128Hz (threshold = 256 for each tick)
-    while (m_ch[0].sweep_timer >= 256) {
-        m_ch[0].sweep_timer -= 256;
-
-        // Decrement divider
-        if (m_ch[0].sweep_divider > 0) {
-            m_ch[0].sweep_divider--;
+// At most a few sweeps fall into one frame. A sweep that no longer changes
+// the frequency skips the rest of the interval.
+void rp_gbapu::clockSweep(uint32_t clocks) {
+    while (clocks > 0 && m_ch[0].active) {
+        if (clocks < m_ch[0].sweep_divider) {
+            m_ch[0].sweep_divider -= clocks;
+            return;
         }
+        clocks -= m_ch[0].sweep_divider;
 
-        // When divider reaches 0, clock the sweep
-        if (m_ch[0].sweep_divider == 0) {
-            // Reload divider (period 0 is treated as 8)
-            m_ch[0].sweep_divider = m_ch[0].sweep_period ? m_ch[0].sweep_period : 8;
-
-            // Only apply sweep if enabled and shift > 0
-            if (m_ch[0].sweep_enabled && m_ch[0].sweep_shift > 0) {
-                // Calculate new frequency
-                uint16_t new_freq = calcSweepFreq(&m_ch[0]);
+        // Reload divider (period 0 is treated as 8)
+        uint8_t reload = m_ch[0].sweep_period ? m_ch[0].sweep_period : 8;
+        m_ch[0].sweep_divider = reload;
 
-                if (new_freq == 0xFFFF) {
-                    // Overflow - disable channel
-                    m_ch[0].active = false;
-                    return;
-                }
+        if (!m_ch[0].sweep_enabled || m_ch[0].sweep_period == 0) {
+            clocks %= reload;
+            continue;
+        }
 
-                // Check overflow AGAIN with the new frequency (GB quirk)
-                // This catches cases where the next sweep would overflow
-                m_ch[0].sweep_shadow_freq = new_freq;
-                uint16_t next_freq = calcSweepFreq(&m_ch[0]);
-                if (next_freq == 0xFFFF) {
-                    m_ch[0].active = false;
-                    return;
-                }
+        // Calculate new frequency
+        uint16_t new_freq = calcSweepFreq(&m_ch[0]);
+        if (new_freq == 0xFFFF) {
+            // Overflow - disable channel
+            m_ch[0].active = false;
+            return;
+        }
+        if (m_ch[0].sweep_shift == 0) {
+            continue;
+        }
+        if (new_freq == m_ch[0].sweep_shadow_freq) {
+            clocks %= reload;
+        }
 
-                // Apply new frequency
-                m_ch[0].freq = new_freq;
-            }
+        // Apply new frequency, then check overflow AGAIN (GB quirk)
+        m_ch[0].sweep_shadow_freq = new_freq;
+        m_ch[0].freq = new_freq;
+        if (calcSweepFreq(&m_ch[0]) == 0xFFFF) {
+            m_ch[0].active = false;
+            return;
         }
     }
 }
@@ -393,14 +535,9 @@ void rp_gbapu::update() {
     if (!m_enabled) {
         return;
     }
+    playShortNotes();
 
-    // Update envelope for Pulse1, Pulse2, Noise (not Wave - uses different volume system)
-    updateEnvelope(0);
-    updateEnvelope(1);
-    updateEnvelope(3);
-
-    // Update sweep for Pulse1 (uses m_ch[0].freq set at trigger time)
-    updateSweep();
+    // Envelope and sweep are run by clockTo() before this
 
     // Update frequency registers (Pulse2, Wave - can change without trigger)
     // Note: Pulse1 freq is set at trigger and modified by sweep, not read here
@@ -414,12 +551,12 @@ void rp_gbapu::update() {
     updatePulse2();
     updateWave();
     updateNoise();
+    endShortNotes();
 }
 
 // 240Hz split update to avoid buffer overflow
 // tick=0: Pulse1, tick=1: Pulse2, tick=2: Wave, tick=3: Noise
 // Each channel updates at 60Hz (240/4 = 60)
-// Envelope/sweep run on tick 0 (60Hz)
 void rp_gbapu::updateTick(uint8_t tick) {
     if (!m_enabled) {
         return;
@@ -427,12 +564,7 @@ void rp_gbapu::updateTick(uint8_t tick) {
 
     switch (tick) {
         case 0:
-            // Envelope and sweep run at 60Hz
-            updateEnvelope(0);
-            updateEnvelope(1);
-            updateEnvelope(3);
             // Pulse1 freq is set at trigger and modified by sweep
-            updateSweep();
             updatePulse1();
             break;
 
@@ -464,12 +596,7 @@ void rp_gbapu::updateAllChannels() {
     if (!m_enabled) {
         return;
     }
-
-    // Update envelope and sweep (60Hz)
-    updateEnvelope(0);
-    updateEnvelope(1);
-    updateEnvelope(3);
-    updateSweep();
+    playShortNotes();
 
     // Update frequency registers (Pulse2, Wave only)
     m_ch[1].freq = m_regs[NR23] | ((m_regs[NR24] & 0x07) << 8);
@@ -483,6 +610,7 @@ void rp_gbapu::updateAllChannels() {
     updatePulse2();
     updateWave();
     updateNoise();
+    endShortNotes();
 }
 
 // Update 2 channels per frame (30Hz per channel)
@@ -493,12 +621,6 @@ void rp_gbapu::updateChannelPair(uint8_t tick) {
         return;
     }
 
-    // Envelope/Sweep は毎フレーム更新
-    updateEnvelope(0);
-    updateEnvelope(1);
-    updateEnvelope(3);
-    updateSweep();
-
     // 周波数レジスタ更新 (Pulse2, Wave only)
     m_ch[1].freq = m_regs[NR23] | ((m_regs[NR24] & 0x07) << 8);
     m_ch[2].freq = m_regs[NR33] | ((m_regs[NR34] & 0x07) << 8);
@@ -524,12 +646,7 @@ void rp_gbapu::updatePulsePriority(uint8_t tick) {
     if (!m_enabled) {
         return;
     }
-
-    // Envelope/Sweep は毎フレーム更新
-    updateEnvelope(0);
-    updateEnvelope(1);
-    updateEnvelope(3);
-    updateSweep();
+    playShortNotes();
 
     // 周波数レジスタ更新 (Pulse2, Wave only)
     m_ch[1].freq = m_regs[NR23] | ((m_regs[NR24] & 0x07) << 8);
@@ -543,110 +660,31 @@ void rp_gbapu::updatePulsePriority(uint8_t tick) {
     updatePulse2();
     updateWave();
     updateNoise();
+    endShortNotes();
 }
 
-// Convert GB frequency register to NES pulse period
-// GB: freq = 131072 / (2048 - x)
-// NES: freq = 1789773 / (16 * (period + 1))
-// Direct conversion to avoid double integer division precision loss:
-// period = (1789773 * (2048 - x)) / (16 * 131072) - 1
-//        = (1789773 * divisor) / 2097152 - 1
+// Frequency conversion: tables generated at compile time (rp_gbfreq.h).
+// The GB frequency registers are 11-bit.
 uint16_t rp_gbapu::gbToNesPulsePeriod(uint16_t gbFreqReg) {
-    if (gbFreqReg >= 2048) return 0;
-
-    uint32_t divisor = 2048 - gbFreqReg;
-    if (divisor == 0) return 2047;
-
-    // Direct conversion with rounding for better accuracy
-    uint32_t numerator = (uint32_t)1789773 * divisor;
-    uint32_t period = (numerator + 1048576) / 2097152;  // +1048576 for rounding
-
-    if (period == 0) return 8;
-    period -= 1;
-
-    // Clamp to valid range
-    if (period < 8) period = 8;      // Minimum audible
-    if (period > 2047) period = 2047; // 11-bit max
-
-    return (uint16_t)period;
+    return GBFREQ_TABLES.pulse[gbFreqReg & (GBFREQ_SIZE - 1)];
 }
 
-// Convert GB frequency register to NES triangle period
-// GB Wave: freq = 65536 / (2048 - x) (half of pulse due to 32-sample waveform)
-// NES Triangle: freq = 1789773 / (32 * (period + 1))
-// Direct conversion:
-// period = (1789773 * divisor) / (32 * 65536) - 1
-//        = (1789773 * divisor) / 2097152 - 1 (same as pulse)
 uint16_t rp_gbapu::gbToNesTrianglePeriod(uint16_t gbFreqReg) {
-    if (gbFreqReg >= 2048) return 0;
-
-    uint32_t divisor = 2048 - gbFreqReg;
-    if (divisor == 0) return 2047;
-
-    // Direct conversion with rounding (same formula as pulse)
-    uint32_t numerator = (uint32_t)1789773 * divisor;
-    uint32_t period = (numerator + 1048576) / 2097152;  // +1048576 for rounding
-
-    if (period == 0) return 2;
-    period -= 1;
-
-    // GB Wave と NES Triangle は両方とも Pulse より1オクターブ低いため
-    // オクターブ補正は不要（相殺される）
-
-    // Clamp to valid range
-    if (period < 2) period = 2;
-    if (period > 2047) period = 2047;
-
-    return (uint16_t)period;
+    return GBFREQ_TABLES.triangle[gbFreqReg & (GBFREQ_SIZE - 1)];
 }
 
-// NES Noise Period Table (NTSC) - CPU cycles between shift register clocks
-static const uint16_t NES_NOISE_PERIODS[16] = {
-    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
-};
-
-// GB Noise divisor values for codes 0-7
-static const uint8_t GB_NOISE_DIVISORS[8] = {8, 16, 32, 48, 64, 80, 96, 112};
-
-// Convert GB noise parameters to NES noise period index
 uint8_t rp_gbapu::gbNoiseToNesPeriod(uint8_t gbNR43) {
-    // GB NR43: SSSS WDDD
-    // S = clock shift (0-15)
-    // W = width mode (0=15-bit, 1=7-bit)
-    // D = divisor code (0-7)
-    // GB freq = 262144 / (divisor * 2^shift)
-
-    uint8_t shift = (gbNR43 >> 4) & 0x0F;
-    uint8_t divCode = gbNR43 & 0x07;
-    uint8_t divisor = GB_NOISE_DIVISORS[divCode];
-
-    // Calculate GB noise frequency
-    uint32_t divider = (uint32_t)divisor * (1 << shift);
-    if (divider == 0) return 0x0F;
-
-    uint32_t gbFreq = 262144 / divider;
-    if (gbFreq == 0) return 0x0F;  // Lowest frequency
-
-    // Find NES period that gives closest frequency
-    // NES freq = 1789773 / period
-    uint8_t bestIdx = 0;
-    uint32_t bestDiff = 0xFFFFFFFF;
-
-    for (uint8_t i = 0; i < 16; i++) {
-        uint32_t nesFreq = 1789773 / NES_NOISE_PERIODS[i];
-        uint32_t diff = (gbFreq > nesFreq) ? (gbFreq - nesFreq) : (nesFreq - gbFreq);
-        if (diff < bestDiff) {
-            bestDiff = diff;
-            bestIdx = i;
-        }
-    }
-    return bestIdx;
+    return GBFREQ_TABLES.noise[gbNR43];
 }
 
 // NES APU レジスタ書き込み
 void rp_gbapu::queueApuWrite(uint8_t reg, uint8_t value) {
     if (reg < 0x18) {
+#if defined(ARDUINO_ARCH_RP2040)
         sys.queueApuWrite(reg, value);
+#else
+        gbapuHostWrite(reg, value);
+#endif
     }
 }
 
@@ -818,6 +856,9 @@ void rp_gbapu::updateWave() {
     // 毎フレーム NR30/NR32 から active と volume を更新
     m_ch[2].active = (m_regs[NR30] & 0x80) != 0;
     m_ch[2].volume = (m_regs[NR32] >> 5) & 0x03;
+    if (m_ch[2].length_enabled && m_ch[2].length == 0) {
+        m_ch[2].active = false;  // Length expired
+    }
 
     // Wave は Triangle で常に出力（Pulse での出力は補完）
 
@@ -875,14 +916,24 @@ void rp_gbapu::updateNoise() {
     m_ch[3].last_nes_period = nesPeriod | (nesMode ? 0x100 : 0);
 }
 
-// Compute hash for wave RAM change detection
-uint8_t rp_gbapu::computeWaveRamHash() {
-    uint8_t hash = 0;
-    for (int i = 0; i < 16; i++) {
-        hash ^= m_regs[WAVE_RAM_START + i];
-        hash = (hash << 1) | (hash >> 7);  // rotate left
+// Wave type of the current wave RAM. Analyzed only when it was written
+// since, and then only for a pattern not seen recently.
+WaveType rp_gbapu::classifyWave() {
+    if (m_waveDirty) {
+        m_lastWaveType = wave_cache.classify(&m_regs[WAVE_RAM_START],
+                                             [this]() { return analyzeWaveform(); });
+        m_waveDirty = false;
     }
-    return hash;
+    return m_lastWaveType;
+}
+
+WaveType rp_gbapu::getWaveType() {
+    m_ch[2].detected_wave_type = classifyWave();
+    return m_ch[2].detected_wave_type;
+}
+
+const rp_wavecache& rp_gbapu::getWaveCache() {
+    return wave_cache;
 }
 
 // Check if waveform is triangle-like pattern
@@ -1083,6 +1134,8 @@ uint8_t audio_read(uint16_t addr) {
     return gbapu.read(addr);
 }
 
-void audio_write(uint16_t addr, uint8_t val) {
+void audio_write(uint16_t addr, uint8_t val, uint32_t cycles) {
+    gbapu.logWrite(addr, val, cycles);
+    gbapu.clockTo(cycles);
     gbapu.write(addr, val);
 }
@@ -54,6 +54,11 @@
 // Wave RAM: 0xFF30-0xFF3F (offsets 0x20-0x2F)
 #define WAVE_RAM_START  0x20
 
+// Frame sequencer: clocked at 512Hz by DIV (bit 12 of the internal divider
+// falling), length at steps 0/2/4/6 (256Hz), sweep at 2/6 (128Hz) and
+// envelope at 7 (64Hz)
+#define GB_SEQ_CYCLES   8192
+
 // Wave type classification for dynamic channel mapping
 enum WaveType {
     WAVE_TYPE_UNKNOWN = 0,   // Unknown/complex waveform
@@ -80,6 +85,7 @@ struct gb_channel {
     bool active;
     bool triggered;          // Trigger occurred this frame (for phase reset)
     bool stop_requested;     // Stop was requested this frame (for proper note separation)
+    bool short_note;         // Note started and stopped within the frame, played for this frame only
     uint16_t freq;           // GB frequency register (11-bit)
     uint8_t volume;          // Current volume (0-15)
     uint8_t duty;            // Duty cycle (0-3)
@@ -87,11 +93,15 @@ struct gb_channel {
     WaveType detected_wave_type;  // Detected wave type (for wave channel)
     uint8_t nes_channel_used;     // NES channel used (0=Pulse1, 1=Pulse2, 2=Triangle, 0xFF=none)
 
+    // Length counter (all channels)
+    uint16_t length;         // 256Hz clocks left, 0=expired
+    bool length_enabled;     // NRx4 bit 6
+
     // Envelope tracking (for Pulse1, Pulse2, Noise)
     uint8_t env_initial;     // Initial volume (0-15)
     uint8_t env_direction;   // 0=decrease, 1=increase
     uint8_t env_period;      // Envelope period (0=disabled, 1-7)
-    uint16_t env_counter;    // Fixed-point (8.8) counter for accurate 64Hz timing
+    uint8_t env_timer;       // 64Hz clocks until the next step
 
     // Sweep tracking (for Pulse1 only)
     // GB sweep is more complex than simple periodic updates
@@ -99,12 +109,14 @@ struct gb_channel {
     uint8_t sweep_direction;    // 0=addition (freq increase), 1=subtraction (freq decrease)
     uint8_t sweep_shift;        // Sweep shift amount (0-7)
     uint16_t sweep_shadow_freq; // Shadow frequency register (internal)
-    uint8_t sweep_divider;      // Current divider value (counts down from period)
-    uint16_t sweep_timer;       // Fixed-point (8.8) timer for 128Hz clocking
+    uint8_t sweep_divider;      // 128Hz clocks until the next sweep (counts down from period)
     bool sweep_enabled;         // Internal enable flag (set at trigger)
     bool sweep_negate_used;     // Negate was used (disables sweep on freq increase)
 };
 
+class rp_apulog;
+class rp_wavecache;
+
 class rp_gbapu {
 public:
     rp_gbapu();
@@ -115,6 +127,34 @@ public:
     uint8_t read(uint16_t addr);
     void write(uint16_t addr, uint8_t val);
 
+    // Run the frame sequencer (length, sweep, envelope) up to the GB cycle
+    // counter value. Called before each write and before the channel
+    // updates. The cost does not depend on the time elapsed.
+    void clockTo(uint32_t cycles);
+
+    // Channel state, for host tools
+    const gb_channel& getChannel(uint8_t ch) { return m_ch[ch]; }
+
+    // Write log of the current GB frame (rp_apulog.h). beginFrame() is
+    // called before the frame is run, logWrite() with each write. div is
+    // the 16-bit internal divider (DIV in the upper byte) at that point,
+    // which the frame sequencer is aligned to.
+    void beginFrame(uint32_t cycles, uint16_t div);
+    void logWrite(uint16_t addr, uint8_t val, uint32_t cycles);
+    const rp_apulog& getWriteLog();
+
+    // Notes started and stopped within a frame that were played anyway
+    uint32_t getShortNotes() { return m_shortNotes; }
+
+    // Wave type of the current wave RAM, also kept in detected_wave_type.
+    // Classified on demand only: the NES mapping does not use it yet (the
+    // wave always goes to the triangle), so it is not done every frame.
+    WaveType getWaveType();
+
+    // Wave type results by wave RAM contents (rp_wavecache.h), with the
+    // hit / miss counters
+    const rp_wavecache& getWaveCache();
+
     // Called every frame (60Hz) to update NES APU
     void update();
 
@@ -148,9 +188,15 @@ private:
     // NES channel ownership (0=Pulse1, 1=Pulse2, 2=Triangle, 3=Noise)
     NesChannelOwner m_nesChannelOwner[4];
 
-    // Wave analysis cache
+    // Wave type of the current wave RAM, analyzed again after a write to it
     WaveType m_lastWaveType;
-    uint8_t m_waveRamHash;
+    bool m_waveDirty;
+
+    uint32_t m_shortNotes;
+
+    // Frame sequencer
+    uint32_t m_seqNext;  // GB cycle counter value of the next step
+    uint8_t m_seqStep;   // Next step (0-7)
 
     // NES APU レジスタ書き込み
     void queueApuWrite(uint8_t reg, uint8_t value);
@@ -170,15 +216,21 @@ private:
     // Helper to stop a channel
     void stopChannel(uint8_t ch);
 
-    // Envelope and sweep
-    void updateEnvelope(uint8_t ch);
-    void updateSweep();
+    // Short notes from the write log, around the channel updates
+    void playShortNotes();
+    void endShortNotes();
+
+    // Frame sequencer clocks, any number at once
+    void clockLength(uint8_t ch, uint32_t clocks);
+    void clockEnvelope(uint8_t ch, uint32_t clocks);
+    void clockSweep(uint32_t clocks);
+    void reloadLength(uint8_t ch);
 
     // Waveform analysis
     WaveType analyzeWaveform();
     bool isTrianglePattern(const uint8_t* samples);
     bool isSawtoothPattern(const uint8_t* samples);
-    uint8_t computeWaveRamHash();
+    WaveType classifyWave();
 
     // Channel allocation
     uint8_t allocateNesChannel(WaveType waveType);
@@ -192,8 +244,14 @@ private:
 
 extern rp_gbapu gbapu;
 
+// Host tools (without rp_system) receive the NES APU writes here
+#if !defined(ARDUINO_ARCH_RP2040)
+void gbapuHostWrite(uint8_t reg, uint8_t value);
+#endif
+
 // Peanut-GB callback wrappers (must be defined before peanut_gb.h include)
+// (PEANUT_GB_AUDIO_WRITE_CYCLES: audio_write() gets the GB cycle counter)
 uint8_t audio_read(uint16_t addr);
-void audio_write(uint16_t addr, uint8_t val);
+void audio_write(uint16_t addr, uint8_t val, uint32_t cycles);
 
 #endif
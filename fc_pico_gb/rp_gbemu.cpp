@@ -4,7 +4,12 @@
 */
 
 #include "rp_gbemu.h"
+#include "hardware/sync.h"
 #include "rp_gbpalette.h"
+#include "rp_system.h"
+#include "rp_ppuconv.h"
+#include "rp_spsc.h"
+#include "rp_dmacopy.h"
 #include "Canvas.h"
 
 // Include Peanut-GB implementation
@@ -22,24 +27,54 @@ bool g_littlefs_available = false;
 // Peanut-GB context
 static struct gb_s gb;
 
-// ROM Bank 0 cache (64KB) for faster access
+// ROM cache (64KB) for faster access: the whole ROM if it fits, else bank 0
 static uint8_t rom_bank0[65536];
+static uint32_t rom_cache_size = 0;
 
 // Private data for Peanut-GB callbacks
 struct gb_priv_s {
     uint8_t* rom;
     uint8_t* cart_ram;
-    uint8_t* frame_buffer;
+    uint32_t lines_drawn[(GB_LCD_HEIGHT + 31) / 32];  // Lines drawn this frame
+    uint32_t line_hash[VRAM_BUF_NUM][GB_LCD_HEIGHT];  // Line held by each PPU buffer, 0=unknown
+    uint8_t dirty_lines;                // Lines converted this frame
+    bool draw;                          // Lines go to the PPU buffer
 };
 static struct gb_priv_s gb_priv;
 
+// Frame hand-off: core0 -> emulating core
+enum {
+    GB_FRAME_DRAW   = 0x01,  // Draw into the PPU back buffer
+    GB_FRAME_REDRAW = 0x02,  // Convert every line, the buffers were overwritten
+    GB_FRAME_RESET  = 0x04,  // Reset the GB before running
+};
+struct gb_frame_req {
+    uint8_t joypad;  // FC keys
+    uint8_t flags;   // GB_FRAME_*
+    uint8_t frames;  // GB frames to run (1-2), the last one is drawn
+};
+
+// Emulating core -> core0
+struct gb_frame_done {
+    uint8_t dirty_lines;
+#if GB_INPUT_LATENCY
+    bool input_edge;          // A key change was read in this frame
+    uint32_t input_poll_us;   // Key change to P1 read
+    uint32_t input_shown_us;  // Key change to publish
+#endif
+};
+
+// Only one frame is in flight at a time, the second slot is spare
+static rp_spsc<gb_frame_req, 2> frame_req;
+static rp_spsc<gb_frame_done, 2> frame_done;
+
 //=================================================
 // Peanut-GB Callback Functions
 //=================================================
 
 uint8_t gb_rom_read(struct gb_s* gb, const uint_fast32_t addr) {
     // Use cached ROM bank 0 for faster access
-    if (addr < 65536) {
+    if (addr < rom_cache_size) {
         return rom_bank0[addr];
     }
     struct gb_priv_s* priv = (struct gb_priv_s*)gb->direct.priv;
@@ -62,15 +97,66 @@ void gb_error(struct gb_s* gb, const enum gb_error_e err, const uint16_t addr) {
     // Errors are silently ignored in release build
 }
 
+uint8_t gb_joypad_read(struct gb_s* gb) {
+    (void)gb;
+    return gbemu.readJoypad();
+}
+
+// FC keys to the Peanut-GB joypad byte (active-low: 0=pressed, 1=released)
+static inline uint8_t gb_joypad_bits(uint8_t fc_key) {
+    uint8_t pressed = 0;
+    if (fc_key & 0x80) pressed |= JOYPAD_A;
+    if (fc_key & 0x40) pressed |= JOYPAD_B;
+    if (fc_key & 0x20) pressed |= JOYPAD_SELECT;
+    if (fc_key & 0x10) pressed |= JOYPAD_START;
+    if (fc_key & 0x08) pressed |= JOYPAD_UP;
+    if (fc_key & 0x04) pressed |= JOYPAD_DOWN;
+    if (fc_key & 0x02) pressed |= JOYPAD_LEFT;
+    if (fc_key & 0x01) pressed |= JOYPAD_RIGHT;
+    return (uint8_t)~pressed;
+}
+
+// Hash of the shades of one GB line (palette bits above bit 1 are ignored)
+static inline uint32_t gb_line_hash(const uint8_t* pixels) {
+    uint32_t h = 0x811C9DC5;
+    for (int x = 0; x < GB_LCD_WIDTH; x += 4) {
+        uint32_t w;
+        memcpy(&w, &pixels[x], sizeof(w));
+        h = (h ^ (w & 0x03030303)) * 0x9E3779B1;
+        h = (h << 13) | (h >> 19);
+    }
+    return h | 1;  // 0 marks a line whose content is unknown
+}
+
 void gb_lcd_draw_line(struct gb_s* gb, const uint8_t* pixels, const uint_fast8_t line) {
     struct gb_priv_s* priv = (struct gb_priv_s*)gb->direct.priv;
+    if (!priv->draw) {
+        return;
+    }
+    priv->lines_drawn[line / 32] |= 1UL << (line % 32);
+
+    // Skip lines the draw buffer already holds, and copy lines that are
+    // unchanged since the last published frame
+    uint32_t hash = gb_line_hash(pixels);
+    uint32_t* draw_hash = &priv->line_hash[sys.getDrawIndex()][line];
+    if (*draw_hash == hash) {
+        return;
+    }
+    *draw_hash = hash;
+    if (priv->line_hash[sys.getLastIndex()][line] == hash) {
+        sys.keepDirectLine(GB_OFFSET_Y + line);
+        return;
+    }
 
-    // Copy line to frame buffer
-    // Invert colors: GB 0=white, 3=black -> FC 3=white, 0=black
-    uint8_t* dest = &priv->frame_buffer[line * GB_LCD_WIDTH];
-    for (int x = 0; x < GB_LCD_WIDTH; x++) {
-        dest[x] = 3 - (pixels[x] & 0x03);
+    // Write the line straight into the PPU back buffer, 8 pixels per word.
+    // Shades are inverted (GB 0=white, 3=black -> FC 3=white, 0=black),
+    // and 3 - p == p ^ 3, so flipping both planes is enough.
+    uint16_t* dest = sys.getDrawLine(GB_OFFSET_Y + line) + GB_OFFSET_X / 8;
+    for (int x = 0; x < GB_LCD_WIDTH; x += 8) {
+        *dest++ = ppuPackWord(&pixels[x]) ^ 0xFFFF;
     }
+
+    priv->dirty_lines++;
 }
 
 //=================================================
@@ -83,7 +169,22 @@ rp_gbemu::rp_gbemu() {
     m_cart_ram = nullptr;
     m_rom_size = 0;
     m_cart_ram_size = 0;
-    memset(m_frame_buffer, 0, sizeof(m_frame_buffer));
+    m_clear_frames = 0;
+    m_apu_tick = 0;
+    m_frame_busy = false;
+    m_dirty_lines = 0;
+    m_reset_pending = false;
+    m_frame_flags = GB_FRAME_DRAW;
+    m_joypad = 0;
+    m_joypad_late.store(0);
+    m_joypad_frame = 0;
+#if GB_INPUT_LATENCY
+    m_edge_us.store(0);
+    m_poll_joypad = 0;
+    m_poll_edge_us = 0;
+    m_poll_us = 0;
+    takeInputStats();
+#endif
     memset(m_rom_title, 0, sizeof(m_rom_title));
     memset(m_save_path, 0, sizeof(m_save_path));
     m_save_dirty = false;
@@ -105,9 +206,11 @@ bool rp_gbemu::init(const uint8_t* rom_data, uint32_t rom_size) {
     m_rom = (uint8_t*)rom_data;
     m_rom_size = rom_size;
 
-    // Cache first 64KB of ROM for faster access
-    uint32_t cache_size = (rom_size < 65536) ? rom_size : 65536;
-    memcpy(rom_bank0, rom_data, cache_size);
+    // Cache the ROM if it fits, else only bank 0, as the switchable banks
+    // are read from XIP flash. The copy runs on DMA while the cart RAM is
+    // allocated and cleared, gb_init() reads it.
+    rom_cache_size = (rom_size <= sizeof(rom_bank0)) ? rom_size : ROM_BANK_SIZE;
+    dma_job rom_copy = dmaCopyAsync(rom_bank0, rom_data, rom_cache_size);
 
     // Allocate cart RAM
     m_cart_ram_size = GB_CART_RAM_MAX_SIZE;
@@ -116,16 +219,18 @@ bool rp_gbemu::init(const uint8_t* rom_data, uint32_t rom_size) {
         m_cart_ram_size = 32 * 1024;
         m_cart_ram = (uint8_t*)malloc(m_cart_ram_size);
         if (m_cart_ram == nullptr) {
+            dmaWait(rom_copy);
             g_gb_last_error = 2;
             return false;
         }
     }
-    memset(m_cart_ram, 0, m_cart_ram_size);
+    dma_job ram_clear = dmaFillAsync(m_cart_ram, 0, m_cart_ram_size);
+    dmaWait(rom_copy);
+    dmaWait(ram_clear);
 
     // Setup private data
     gb_priv.rom = m_rom;
     gb_priv.cart_ram = m_cart_ram;
-    gb_priv.frame_buffer = m_frame_buffer;
 
     // Initialize Peanut-GB
     enum gb_init_error_e ret = gb_init(&gb,
@@ -146,9 +251,24 @@ bool rp_gbemu::init(const uint8_t* rom_data, uint32_t rom_size) {
         return false;
     }
 
+    // ROM is memory-addressable, so let the core read it directly instead of
+    // calling gb_rom_read(). Small ROMs run from the RAM cache. Larger ones
+    // run bank 0 from the cache and the switchable banks from XIP flash.
+    if (rom_size <= sizeof(rom_bank0)) {
+        gb_init_rom_ptr(&gb, rom_bank0, rom_size);
+    } else {
+        gb_init_rom_ptr(&gb, rom_data, rom_size);
+        gb_set_rom_bank0(&gb, rom_bank0);
+    }
+
     // Initialize LCD
     gb_init_lcd(&gb, &gb_lcd_draw_line);
 
+    // P1 reads go through readJoypad()
+#if GB_JOYPAD_LATE || GB_INPUT_LATENCY
+    gb_init_joypad(&gb, &gb_joypad_read);
+#endif
+
     // Extract ROM title
     for (int i = 0; i < 16; i++) {
         char c = (char)m_rom[0x0134 + i];
@@ -170,36 +290,222 @@ bool rp_gbemu::init(const uint8_t* rom_data, uint32_t rom_size) {
     generateSavePath();
     loadSave();
 
-    // Clear frame buffer
-    memset(m_frame_buffer, 3, sizeof(m_frame_buffer));
+    // Clear screen
+    m_clear_frames = VRAM_BUF_NUM;
+    invalidateScreen();
+    m_pace.reset();
 
     m_initialized = true;
     return true;
 }
 
-void rp_gbemu::runFrame() {
+void rp_gbemu::startFrame() {
     if (!m_initialized) return;
+
+    // The GB runs at 59.73 Hz and the FC at 60.10 Hz, so about every 160th
+    // FC frame runs no GB frame. Frames missed while busy are run later.
+    m_pace.tick();
+    uint8_t frames = m_pace.take(isFrameBusy());
+    if (frames == 0) return;
+
+    gb_frame_req req;
+    req.joypad = m_joypad;
+    req.frames = frames;
+    req.flags = m_frame_flags;
+    m_frame_flags &= ~GB_FRAME_REDRAW;
+    if (m_reset_pending) {
+        m_reset_pending = false;
+        req.flags |= GB_FRAME_RESET;
+    }
+
+    m_frame_busy = true;
+    frame_req.push(req);
+#if !GB_EMU_CORE1
+    serviceFrame();
+#endif
+}
+
+bool rp_gbemu::isFrameBusy() {
+    gb_frame_done done;
+    if (m_frame_busy && frame_done.pop(&done)) {
+        m_dirty_lines = done.dirty_lines;
+        m_frame_busy = false;
+#if GB_INPUT_LATENCY
+        if (done.input_edge) {
+            m_input_edges++;
+            m_input_poll_sum += done.input_poll_us;
+            m_input_shown_sum += done.input_shown_us;
+            if (done.input_poll_us > m_input_poll_max) m_input_poll_max = done.input_poll_us;
+            if (done.input_shown_us > m_input_shown_max) m_input_shown_max = done.input_shown_us;
+        }
+#endif
+    }
+    return m_frame_busy;
+}
+
+void rp_gbemu::waitFrame() {
+    while (isFrameBusy()) {
+        tight_loop_contents();
+    }
+}
+
+bool rp_gbemu::serviceFrame() {
+    gb_frame_req req;
+    if (!frame_req.pop(&req)) {
+        return false;
+    }
+
+    // Only the last frame is drawn, a reset applies to the first one
+    for (uint8_t i = 1; i < req.frames; i++) {
+        runFrame(req.joypad, req.flags & GB_FRAME_RESET);
+        req.flags &= ~GB_FRAME_RESET;
+    }
+    runFrame(req.joypad, req.flags);
+
+    // The Canvas part (border, status overlay) goes into the same buffer,
+    // which is then shown from the next vsync on. No waiting for the FC.
+    sys.convVram();
+    sys.publishVram();
+
+    gb_frame_done done;
+    done.dirty_lines = gb_priv.dirty_lines;
+#if GB_INPUT_LATENCY
+    done.input_edge = m_poll_edge_us != 0;
+    done.input_poll_us = m_poll_us;
+    done.input_shown_us = micros() - m_poll_edge_us;
+    m_poll_edge_us = 0;
+#endif
+    frame_done.push(done);
+    return true;
+}
+
+void rp_gbemu::runFrame(uint8_t joypad, uint8_t flags) {
+    if (flags & GB_FRAME_RESET) {
+        gb_reset(&gb);
+        m_clear_frames = VRAM_BUF_NUM;
+        invalidateScreen();
+    }
+    if (flags & GB_FRAME_REDRAW) {
+        invalidateScreen();
+    }
+
+    // Keys latched for this frame. With GB_JOYPAD_LATE, P1 reads take the
+    // latest keys instead.
+    m_joypad_frame = joypad;
+    gb.direct.joypad = gb_joypad_bits(joypad);
+
+    memset(gb_priv.lines_drawn, 0, sizeof(gb_priv.lines_drawn));
+    gb_priv.dirty_lines = 0;
+    gb_priv.draw = (flags & GB_FRAME_DRAW) != 0;
+    // The APU frame sequencer follows the internal divider (DIV bit 12)
+    uint16_t div = (uint16_t)((gb.hram_io[IO_DIV] << 8) + gb.counter.div_count +
+                              (gb.counter.cycles - gb.counter.sync_cycles));
+    gbapu.beginFrame(gb.counter.cycles, div);
     gb_run_frame(&gb);
+
+    // Lines are not drawn while the LCD is off. The draw buffer holds an
+    // older frame, so bring those lines over from the last published one,
+    // or clear them to white after a reset.
+    if (gb_priv.draw) {
+        uint32_t* draw_hash = gb_priv.line_hash[sys.getDrawIndex()];
+        uint32_t* last_hash = gb_priv.line_hash[sys.getLastIndex()];
+        for (int y = 0; y < GB_LCD_HEIGHT; y++) {
+            if (gb_priv.lines_drawn[y / 32] & (1UL << (y % 32))) {
+                continue;
+            }
+            if (m_clear_frames) {
+                uint16_t* dest = sys.getDrawLine(GB_OFFSET_Y + y) + GB_OFFSET_X / 8;
+                memset(dest, 0xFF, GB_LCD_WIDTH / 8 * sizeof(uint16_t));
+                draw_hash[y] = 0;
+            } else if (draw_hash[y] != last_hash[y] || draw_hash[y] == 0) {
+                sys.keepDirectLine(GB_OFFSET_Y + y);
+                draw_hash[y] = last_hash[y];
+            }
+        }
+
+        if (m_clear_frames) {
+            m_clear_frames--;
+        }
+    }
+
+    // APU: Pulse優先更新 (メロディ重視)
+    // Pulse1+Pulse2: 60Hz, Wave+Noise: 20Hz (3フレームに1回)
+    gbapu.clockTo(gb.counter.cycles);
+    gbapu.updatePulsePriority(m_apu_tick);
+    m_apu_tick = (m_apu_tick + 1) % 3;
 }
 
 void rp_gbemu::reset() {
     if (!m_initialized) return;
-    gb_reset(&gb);
-    memset(m_frame_buffer, 3, sizeof(m_frame_buffer));
+    m_reset_pending = true;
+}
+
+void rp_gbemu::invalidateScreen() {
+    memset(gb_priv.line_hash, 0, sizeof(gb_priv.line_hash));
+}
+
+void rp_gbemu::pauseDisplay(bool paused) {
+    if (paused) {
+        m_frame_flags &= ~GB_FRAME_DRAW;
+    } else {
+        m_frame_flags |= GB_FRAME_DRAW | GB_FRAME_REDRAW;
+    }
 }
 
 void rp_gbemu::setJoypad(uint8_t fc_key) {
-    if (!m_initialized) return;
+    m_joypad = gbJoypadFilter(fc_key);
+}
 
-    // Use bitfield (active-low: 0=pressed, 1=released)
-    gb.direct.joypad_bits.a      = !(fc_key & 0x80);
-    gb.direct.joypad_bits.b      = !(fc_key & 0x40);
-    gb.direct.joypad_bits.select = !(fc_key & 0x20);
-    gb.direct.joypad_bits.start  = !(fc_key & 0x10);
-    gb.direct.joypad_bits.up     = !(fc_key & 0x08);
-    gb.direct.joypad_bits.down   = !(fc_key & 0x04);
-    gb.direct.joypad_bits.left   = !(fc_key & 0x02);
-    gb.direct.joypad_bits.right  = !(fc_key & 0x01);
+void rp_gbemu::latchJoypad(uint8_t fc_key) {
+    fc_key = gbJoypadFilter(fc_key);
+#if GB_INPUT_LATENCY
+    // The time is stored first, so a core that sees the new keys sees it
+    // too (or the time of a later change)
+    if (fc_key != m_joypad_late.load(std::memory_order_relaxed)) {
+        m_edge_us.store(micros() | 1, std::memory_order_relaxed);
+    }
+#endif
+    m_joypad_late.store(fc_key, std::memory_order_release);
+}
+
+uint8_t rp_gbemu::readJoypad() {
+#if GB_JOYPAD_LATE
+    uint8_t key = m_joypad_late.load(std::memory_order_acquire);
+#else
+    uint8_t key = m_joypad_frame;
+#endif
+#if GB_INPUT_LATENCY
+    // First read of changed keys: the frame reflects the change. Only the
+    // first change read in a frame is timed.
+    if (key != m_poll_joypad) {
+        m_poll_joypad = key;
+        uint32_t edge_us = m_edge_us.load(std::memory_order_relaxed);
+        if (edge_us != 0 && m_poll_edge_us == 0) {
+            m_poll_edge_us = edge_us;
+            m_poll_us = micros() - edge_us;
+        }
+    }
+#endif
+    return gb_joypad_bits(key);
+}
+
+gb_input_stats rp_gbemu::takeInputStats() {
+    gb_input_stats st = {};
+#if GB_INPUT_LATENCY
+    st.edges = m_input_edges;
+    if (m_input_edges) {
+        st.poll_avg = m_input_poll_sum / m_input_edges;
+        st.shown_avg = m_input_shown_sum / m_input_edges;
+    }
+    st.poll_max = m_input_poll_max;
+    st.shown_max = m_input_shown_max;
+    m_input_edges = 0;
+    m_input_poll_sum = 0;
+    m_input_poll_max = 0;
+    m_input_shown_sum = 0;
+    m_input_shown_max = 0;
+#endif
+    return st;
 }
 
 //=================================================
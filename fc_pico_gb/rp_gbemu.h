@@ -8,16 +8,38 @@
 
 #include "Arduino.h"
 #include <LittleFS.h>
+#include <atomic>
 
 // GB APU module (must be before peanut_gb.h for audio_read/audio_write)
 #include "rp_gbapu.h"
+#include "rp_gbpace.h"
 
 // Peanut-GB configuration - must be before including peanut_gb.h
 #define PEANUT_GB_IS_LITTLE_ENDIAN 1
 #define ENABLE_SOUND 1
+#define PEANUT_GB_AUDIO_WRITE_CYCLES 1  // APU writes are logged with their cycle
 #define ENABLE_LCD 1
 #define PEANUT_GB_12_COLOUR 0  // 4-color mode for FC compatibility
 #define PEANUT_GB_HIGH_LCD_ACCURACY 1  // Enable for better LCD emulation
+#define PEANUT_GB_COMPUTED_GOTO 1  // Opcode dispatch via label table (GCC)
+#define PEANUT_GB_TILE_CACHE 1  // Decoded tiles for line drawing (+6KB RAM)
+
+// Run the emulator on core1 while core0 talks to the FC.
+// 0 runs each frame on core0 inside startFrame().
+#define GB_EMU_CORE1 1
+
+// Read the FC keys when the game reads P1 (0xFF00), from the latest key
+// byte sent by the FC, instead of the keys latched before the frame.
+// 0 uses the keys passed with setJoypad().
+#define GB_JOYPAD_LATE 1
+
+// Measure the time from a key change sent by the FC to the game reading it
+// and to the frame that read it being published (getInputStats()).
+#define GB_INPUT_LATENCY 0
+
+// Print the GB, frame pacing, FC link and APU stats to Serial every 10
+// seconds (ap_gb::main()). The counters are kept either way.
+#define GB_STATS 0
 
 // GB screen dimensions
 #define GB_LCD_WIDTH  160
@@ -39,6 +61,21 @@ extern bool g_littlefs_available;
 // FC:  A=0x80, B=0x40, SEL=0x20, RUN=0x10, UP=0x08, DOWN=0x04, LEFT=0x02, RIGHT=0x01
 // GB:  A=0x01, B=0x02, SEL=0x04, START=0x08, RIGHT=0x10, LEFT=0x20, UP=0x40, DOWN=0x80
 
+// SELECT combinations are for the front-end (save, palette), so only the
+// direction keys go to the game while SELECT is held
+static inline uint8_t gbJoypadFilter(uint8_t fc_key) {
+    return (fc_key & 0x20) ? (fc_key & 0x0F) : fc_key;
+}
+
+// Key change to game / screen latency, in microseconds
+struct gb_input_stats {
+    uint32_t edges;      // Key changes read by the game
+    uint32_t poll_avg;   // Until the game read P1
+    uint32_t poll_max;
+    uint32_t shown_avg;  // Until the frame was published
+    uint32_t shown_max;
+};
+
 class rp_gbemu {
 public:
     rp_gbemu();
@@ -46,17 +83,42 @@ public:
     // Initialize emulator with ROM data
     bool init(const uint8_t* rom_data, uint32_t rom_size);
 
-    // Run one frame of emulation
-    void runFrame();
-
-    // Reset emulator
+    // Frame hand-off between the cores. Core0 calls startFrame() once per
+    // FC frame, which starts 0-2 GB frames as paced by m_pace. The emulating
+    // core runs them, draws the last one into the PPU draw buffer, runs the
+    // APU mapping after each and publishes the buffer. isFrameBusy() (core0)
+    // is true until then, and emulator state must be left alone.
+    void startFrame();
+    bool serviceFrame();  // Emulating core: run a requested frame, false if idle
+    bool isFrameBusy();
+    void waitFrame();     // Core0: until isFrameBusy() is false
+
+    // Reset emulator (before the next frame)
     void reset();
 
-    // Set joypad state from FC controller input
+    // Stop writing to the PPU buffers while something else covers the GB
+    // screen. Every line is converted again once the display is resumed.
+    void pauseDisplay(bool paused);
+
+    // Number of GB lines converted to PPU words in the last frame
+    uint8_t getDirtyLines() { return m_dirty_lines; }
+
+    // GB vs FC frame pacing stats
+    const rp_gbpace& getPace() { return m_pace; }
+
+    // Set joypad state from FC controller input (used by the next frame).
+    // SELECT combinations are filtered out (gbJoypadFilter()).
     void setJoypad(uint8_t fc_key);
 
-    // Get frame buffer pointer (for direct access)
-    uint8_t* getFrameBuffer() { return m_frame_buffer; }
+    // Latest FC key byte, from the FC IRQ. Read by the game at P1 reads
+    // with GB_JOYPAD_LATE, and timed with GB_INPUT_LATENCY.
+    void latchJoypad(uint8_t fc_key);
+
+    // Emulating core: joypad state for a P1 read (Peanut-GB active low)
+    uint8_t readJoypad();
+
+    // Input latency since the last call (GB_INPUT_LATENCY, otherwise 0)
+    gb_input_stats takeInputStats();
 
     // Check if emulator is initialized
     bool isInitialized() { return m_initialized; }
@@ -70,7 +132,8 @@ public:
     // ROM info
     const char* getRomTitle() { return m_rom_title; }
 
-    // Save data management
+    // Save data management. saveSave() reads cart RAM, so it must not be
+    // called while a frame is busy.
     bool loadSave();
     bool saveSave();
     void markSaveDirty() { m_save_dirty = true; }
@@ -80,15 +143,43 @@ private:
     // Generate save file path from ROM title
     void generateSavePath();
 
+    // Emulating core: one frame as requested by startFrame()
+    void runFrame(uint8_t joypad, uint8_t flags);
+    void invalidateScreen();
+
     bool m_initialized;
-    uint8_t m_frame_buffer[GB_LCD_WIDTH * GB_LCD_HEIGHT];
+    uint8_t m_clear_frames;  // Frames in which undrawn lines are cleared
+    uint8_t m_apu_tick;      // APU channel group updated this frame (0-2)
+
+    // Core0 side of the frame hand-off
+    bool m_frame_busy;                // Frame started and not done yet
+    uint8_t m_dirty_lines;            // Lines converted in the last frame
+    volatile bool m_reset_pending;    // Set by the FC reset command (IRQ)
+    uint8_t m_frame_flags;            // GB_FRAME_* sent with the next frame
+    uint8_t m_joypad;                 // FC keys for the next frame
+
+    // Latest keys from the FC IRQ, read by the emulating core
+    std::atomic<uint8_t> m_joypad_late;
+    uint8_t m_joypad_frame;           // Emulating core: keys of this frame
+#if GB_INPUT_LATENCY
+    std::atomic<uint32_t> m_edge_us;  // Time of the last key change
+    uint8_t m_poll_joypad;            // Emulating core: keys last read
+    uint32_t m_poll_edge_us;          // Key change read this frame, 0=none
+    uint32_t m_poll_us;
+    uint32_t m_input_edges;           // Core0 side of the stats
+    uint32_t m_input_poll_sum;
+    uint32_t m_input_poll_max;
+    uint32_t m_input_shown_sum;
+    uint32_t m_input_shown_max;
+#endif
+    rp_gbpace m_pace;                 // GB frames per FC frame
     uint8_t* m_rom;
     uint32_t m_rom_size;
     uint8_t* m_cart_ram;
     uint32_t m_cart_ram_size;
     char m_rom_title[17];
     char m_save_path[32];
-    bool m_save_dirty;
+    std::atomic<bool> m_save_dirty;   // Set by the cart RAM write on core1
     uint8_t m_fc_palette[4];  // FC palette indices for current game
     bool m_has_game_palette;  // true if game has specific palette
 };
@@ -0,0 +1,134 @@
+/*
+    rp_gbfreq.h - GB to NES APU frequency conversion tables
+    Header only, without Arduino dependencies, so that host tools can use it
+
+    The conversions are constexpr and run for every register value at
+    compile time, so that the mapper only looks the period up on each
+    channel update. gbfreqPulse() and friends stay callable at run time for
+    the host test that checks the tables against them.
+*/
+
+#ifndef rp_gbfreq_h
+#define rp_gbfreq_h
+
+#include <stdint.h>
+
+#define GBFREQ_SIZE        2048  // 11-bit GB frequency register
+#define GBFREQ_NOISE_SIZE  256   // NR43
+
+// NES Noise Period Table (NTSC) - CPU cycles between shift register clocks
+static constexpr uint16_t NES_NOISE_PERIODS[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+};
+
+// GB Noise divisor values for codes 0-7
+static constexpr uint8_t GB_NOISE_DIVISORS[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+
+// Convert GB frequency register to NES pulse period
+// GB: freq = 131072 / (2048 - x)
+// NES: freq = 1789773 / (16 * (period + 1))
+// Direct conversion to avoid double integer division precision loss:
+// period = (1789773 * (2048 - x)) / (16 * 131072) - 1
+//        = (1789773 * divisor) / 2097152 - 1
+constexpr uint16_t gbfreqPulse(uint16_t gbFreqReg) {
+    if (gbFreqReg >= 2048) return 0;
+
+    uint32_t divisor = 2048 - gbFreqReg;
+
+    // Direct conversion with rounding for better accuracy
+    uint32_t numerator = (uint32_t)1789773 * divisor;
+    uint32_t period = (numerator + 1048576) / 2097152;  // +1048576 for rounding
+
+    if (period == 0) return 8;
+    period -= 1;
+
+    // Clamp to valid range
+    if (period < 8) period = 8;      // Minimum audible
+    if (period > 2047) period = 2047; // 11-bit max
+
+    return (uint16_t)period;
+}
+
+// Convert GB frequency register to NES triangle period
+// GB Wave: freq = 65536 / (2048 - x) (half of pulse due to 32-sample waveform)
+// NES Triangle: freq = 1789773 / (32 * (period + 1))
+// Direct conversion:
+// period = (1789773 * divisor) / (32 * 65536) - 1
+//        = (1789773 * divisor) / 2097152 - 1 (same as pulse)
+constexpr uint16_t gbfreqTriangle(uint16_t gbFreqReg) {
+    if (gbFreqReg >= 2048) return 0;
+
+    uint32_t divisor = 2048 - gbFreqReg;
+
+    // Direct conversion with rounding (same formula as pulse)
+    uint32_t numerator = (uint32_t)1789773 * divisor;
+    uint32_t period = (numerator + 1048576) / 2097152;  // +1048576 for rounding
+
+    if (period == 0) return 2;
+    period -= 1;
+
+    // GB Wave と NES Triangle は両方とも Pulse より1オクターブ低いため
+    // オクターブ補正は不要（相殺される）
+
+    // Clamp to valid range
+    if (period < 2) period = 2;
+    if (period > 2047) period = 2047;
+
+    return (uint16_t)period;
+}
+
+// Convert GB noise parameters to NES noise period index
+constexpr uint8_t gbfreqNoise(uint8_t gbNR43) {
+    // GB NR43: SSSS WDDD
+    // S = clock shift (0-15)
+    // W = width mode (0=15-bit, 1=7-bit)
+    // D = divisor code (0-7)
+    // GB freq = 262144 / (divisor * 2^shift)
+
+    uint8_t shift = (gbNR43 >> 4) & 0x0F;
+    uint8_t divCode = gbNR43 & 0x07;
+    uint8_t divisor = GB_NOISE_DIVISORS[divCode];
+
+    // Calculate GB noise frequency
+    uint32_t divider = (uint32_t)divisor * (1 << shift);
+    uint32_t gbFreq = 262144 / divider;
+    if (gbFreq == 0) return 0x0F;  // Lowest frequency
+
+    // Find NES period that gives closest frequency
+    // NES freq = 1789773 / period
+    uint8_t bestIdx = 0;
+    uint32_t bestDiff = 0xFFFFFFFF;
+
+    for (uint8_t i = 0; i < 16; i++) {
+        uint32_t nesFreq = 1789773 / NES_NOISE_PERIODS[i];
+        uint32_t diff = (gbFreq > nesFreq) ? (gbFreq - nesFreq) : (nesFreq - gbFreq);
+        if (diff < bestDiff) {
+            bestDiff = diff;
+            bestIdx = i;
+        }
+    }
+    return bestIdx;
+}
+
+struct gbfreq_tables {
+    uint16_t pulse[GBFREQ_SIZE];     // gbfreqPulse()
+    uint16_t triangle[GBFREQ_SIZE];  // gbfreqTriangle()
+    uint8_t noise[GBFREQ_NOISE_SIZE];  // gbfreqNoise()
+};
+
+constexpr gbfreq_tables gbfreqMakeTables() {
+    gbfreq_tables t = {};
+    for (uint16_t x = 0; x < GBFREQ_SIZE; x++) {
+        t.pulse[x] = gbfreqPulse(x);
+        t.triangle[x] = gbfreqTriangle(x);
+    }
+    for (uint16_t nr43 = 0; nr43 < GBFREQ_NOISE_SIZE; nr43++) {
+        t.noise[nr43] = gbfreqNoise((uint8_t)nr43);
+    }
+    return t;
+}
+
+// One copy in flash for the whole program (8.2KB)
+inline constexpr gbfreq_tables GBFREQ_TABLES = gbfreqMakeTables();
+
+#endif
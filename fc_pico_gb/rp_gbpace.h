@@ -0,0 +1,89 @@
+/*
+    rp_gbpace.h - GB frame pacing against the FC refresh rate
+    Header only, without Arduino dependencies, so that host tools can use it
+*/
+
+#ifndef rp_gbpace_h
+#define rp_gbpace_h
+
+#include <stdint.h>
+
+// Frame times in a common unit of 1 / (4194304 * 236250000) s, reduced:
+// GB:      70224 cycles at 4194304 Hz                      = 59.7275 Hz
+// FC NTSC: 89341.5 PPU cycles at 236.25 MHz / 11 / 4       = 60.0988 Hz
+#define GBPACE_GB_FRAME  1963828125u
+#define GBPACE_FC_NTSC   1951694848u
+
+// Decides how many GB frames to run in each FC frame. The GB is slightly
+// slower than the FC, so about every 160th FC frame runs no GB frame.
+// A faster GB (or a slower FC) gets 2 frames now and then instead.
+class rp_gbpace {
+public:
+    rp_gbpace(uint32_t gb_frame = GBPACE_GB_FRAME, uint32_t fc_frame = GBPACE_FC_NTSC)
+        : m_gb_frame(gb_frame), m_fc_frame(fc_frame) {
+        reset();
+    }
+
+    void reset() {
+        m_time = 0;
+        m_owed = 0;
+        m_fc_frames = 0;
+        m_gb_frames = 0;
+        m_idle_frames = 0;
+        m_double_frames = 0;
+        m_lost_frames = 0;
+    }
+
+    // Once per FC frame: advance the time by one FC frame
+    void tick() {
+        m_fc_frames++;
+        m_time += m_fc_frame;
+        while (m_time >= m_gb_frame) {
+            m_time -= m_gb_frame;
+            m_owed++;
+        }
+        // Do not try to catch up more than one FC frame's worth
+        if (m_owed > MAX_FRAMES) {
+            m_lost_frames += m_owed - MAX_FRAMES;
+            m_owed = MAX_FRAMES;
+        }
+    }
+
+    // GB frames to run now (0-2). Call once per FC frame after tick(), with
+    // busy set when no frame can be started, so that it is owed instead.
+    uint8_t take(bool busy) {
+        uint8_t frames = busy ? 0 : m_owed;
+        m_owed -= frames;
+        m_gb_frames += frames;
+        if (frames == 0) {
+            m_idle_frames++;
+        } else if (frames > 1) {
+            m_double_frames++;
+        }
+        return frames;
+    }
+
+    uint32_t getFcFrames() const { return m_fc_frames; }
+    uint32_t getGbFrames() const { return m_gb_frames; }
+    uint32_t getIdleFrames() const { return m_idle_frames; }      // FC frames without a GB frame
+    uint32_t getDoubleFrames() const { return m_double_frames; }  // FC frames with 2 GB frames
+    uint32_t getLostFrames() const { return m_lost_frames; }      // GB frames never run
+
+    // Time since the start of the current GB frame, 0-255
+    uint8_t getPhase() const { return (uint8_t)(((uint64_t)m_time << 8) / m_gb_frame); }
+
+    static const uint8_t MAX_FRAMES = 2;
+
+private:
+    uint32_t m_gb_frame;
+    uint32_t m_fc_frame;
+    uint64_t m_time;       // Time into the current GB frame
+    uint8_t m_owed;        // GB frames due but not run yet
+    uint32_t m_fc_frames;
+    uint32_t m_gb_frames;
+    uint32_t m_idle_frames;
+    uint32_t m_double_frames;
+    uint32_t m_lost_frames;
+};
+
+#endif
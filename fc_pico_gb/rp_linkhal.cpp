@@ -0,0 +1,56 @@
+/*
+    rp_linkhal.cpp - FC link on pio0 (rp_system::init() loads the programs)
+ */
+
+#include "Arduino.h"
+#include "rp_system.h"
+#include "rp_linkhal.h"
+
+
+static rp_dma tran_dma;
+
+
+void linkInit() {
+	tran_dma.initSM_DMA_TX( PIO_NO_0, SM_TRAN, NULL, 0 );
+	tran_dma.initSM_DMA_TX_Chain();
+}
+
+bool linkRecvEmpty() {
+	return pio_sm_is_rx_fifo_empty( pio0, SM_RECV );
+}
+
+uint8_t linkRecvGet() {
+	return (uint8_t)(pio_sm_get_blocking( pio0, SM_RECV ) & 0xff);
+}
+
+void linkTranRestart() {
+	pio_sm_clear_fifos( pio0, SM_TRAN );
+	pio_sm_restart( pio0, SM_TRAN );
+}
+
+void linkTranPut( uint32_t w ) {
+	pio_sm_put_blocking( pio0, SM_TRAN, w );
+}
+
+void linkTranSkip() {
+	pio_sm_exec( pio0, SM_TRAN, 0x6008 );  // out    pins, 8
+}
+
+void linkDmaStart( const void* buf, uint32_t words ) {
+	tran_dma.TransSM_DMA( (uint32_t *)buf, words );
+}
+
+void linkDmaChain( const void* buf, uint32_t words, const void* buf2, uint32_t words2 ) {
+	tran_dma.TransSM_DMA_Chain( (uint32_t *)buf, words, (uint32_t *)buf2, words2 );
+}
+
+void linkDmaStop() {
+	tran_dma.StopDMA();
+}
+
+uint32_t linkTakeReadCount() {
+	pio_sm_exec( pio0, SM_TRCNT, 0x8000 );  //  push   noblock
+	pio_sm_exec( pio0, SM_TRCNT, 0xa02b );  //  mov    x, !null
+	pio_sm_restart( pio0, SM_TRCNT );
+	return pio_sm_get( pio0, SM_TRCNT );
+}
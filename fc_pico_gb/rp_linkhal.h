@@ -0,0 +1,31 @@
+/*
+    rp_linkhal.h - PIO FIFOs and DMA channel of the FC link
+    rp_linkhal.cpp drives pio0 and a DMA channel on the Pico,
+    tools/linksim.cpp simulates an FC on the other end on a host.
+    No Arduino dependencies, so that host tools can use it
+*/
+
+#ifndef rp_linkhal_h
+#define rp_linkhal_h
+
+#include <stdint.h>
+
+void linkInit();                    // claim the DMA channels that feed SM_TRAN
+
+// SM_RECV: bytes the FC writes
+bool linkRecvEmpty();
+uint8_t linkRecvGet();              // waits for a byte
+
+// SM_TRAN: bytes the FC reads
+void linkTranRestart();             // clear the FIFO, restart the state machine
+void linkTranPut(uint32_t w);       // waits for room in the FIFO
+void linkTranSkip();                // drop the next byte ("out pins, 8")
+void linkDmaStart(const void* buf, uint32_t words);  // feed SM_TRAN from buf
+void linkDmaChain(const void* buf, uint32_t words,   // buf, then buf2
+                  const void* buf2, uint32_t words2);
+void linkDmaStop();
+
+// SM_TRCNT: FC reads since the last call, restarts the count
+uint32_t linkTakeReadCount();
+
+#endif
@@ -0,0 +1,33 @@
+/*
+    rp_ppuconv.h - 8bpp pixels to FC PPU word conversion
+    Header only, without Arduino dependencies, so that host tools can use it
+*/
+
+#ifndef rp_ppuconv_h
+#define rp_ppuconv_h
+
+#include <stdint.h>
+#include <string.h>
+
+// Gather bit 0 of each byte of x into a 4-bit value, byte 0 in bit 3.
+// Byte i lands on bit 31 - i of the product, and no two partial products
+// share a bit, so nothing carries into the top nibble.
+static inline uint32_t ppuGather4(uint32_t x) {
+    return ((x & 0x01010101) * 0x80402010) >> 28;
+}
+
+// Pack 8 pixels (colour in bits 1-0, higher bits ignored) into one PPU
+// word: low byte = plane 0, high byte = plane 1, MSB = leftmost pixel.
+// Same result as shifting in conv_tbl[pixel & 3] 8 times.
+// Assumes a little endian host (RP2040/RP2350, x86).
+static inline uint16_t ppuPackWord(const uint8_t* src) {
+    uint32_t l, r;
+    memcpy(&l, src, sizeof(l));
+    memcpy(&r, src + 4, sizeof(r));
+
+    uint32_t plane0 = (ppuGather4(l) << 4) | ppuGather4(r);
+    uint32_t plane1 = (ppuGather4(l >> 1) << 4) | ppuGather4(r >> 1);
+    return (uint16_t)(plane0 | (plane1 << 8));
+}
+
+#endif
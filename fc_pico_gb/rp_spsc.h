@@ -0,0 +1,55 @@
+/*
+    rp_spsc.h - Single producer / single consumer ring
+    Lock-free hand-off between the two cores (or an IRQ and a loop).
+    Header only, without Arduino dependencies, so that host tools can use it
+*/
+
+#ifndef rp_spsc_h
+#define rp_spsc_h
+
+#include <stdint.h>
+#include <atomic>
+
+// N must be a power of 2. push() may only be called from one thread and
+// pop() from one other thread. The indices run freely and wrap at 2^32.
+template <typename T, uint32_t N>
+class rp_spsc {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+    rp_spsc() : m_head(0), m_tail(0) {}
+
+    // Producer: false when the ring is full
+    bool push(const T& item) {
+        uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        m_buf[head & (N - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: false when the ring is empty
+    bool pop(T* item) {
+        uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (m_head.load(std::memory_order_acquire) == tail) {
+            return false;
+        }
+        *item = m_buf[tail & (N - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side, only a snapshot
+    uint32_t count() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T m_buf[N];
+    std::atomic<uint32_t> m_head;  // Written by the producer only
+    std::atomic<uint32_t> m_tail;  // Written by the consumer only
+};
+
+#endif
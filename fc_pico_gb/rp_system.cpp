@@ -8,7 +8,10 @@
 #include "Arduino.h"
 #include "pio/fcppu.pio.h"
 #include "rp_system.h"
+#include "rp_ppuconv.h"
+#include "rp_apupkt.h"
 #include "rp_gbemu.h"
+#include "rp_spsc.h"
 
 #include "Canvas.h"
 
@@ -164,8 +167,8 @@ void rp_system::init(void) {
 #endif
 
 
-	vram_dma.initSM_DMA_TX( PIO_NO_0, SM_TRAN, vram_buf,VRAM_BUF_SIZE );
-	pio_sm_put_blocking ( pio0, SM_TRAN, 0x43462321 );
+	m_link.init();
+	m_link.put( 0x43462321 );
 	ver_dma();
 
 	init2();
@@ -177,6 +180,13 @@ void rp_system::init2() {
 
 	initFC_COM_BUF();
 	m_apuSupported = false;	// FC ROM から APU 対応通知を受け取るまで false
+	m_com_ext = false;
+	m_com_ext_req = 0;
+	m_com_deferred = 0;
+	m_apuRefresh = 0;
+	m_apu_resync = false;
+	m_apu_ext_bytes = 0;
+	m_apu_ext_packets = 0;
 
 	// APU レジスタバッファ初期化 (無音状態で開始)
 	memset(m_apuRegLatest, 0, sizeof(m_apuRegLatest));
@@ -205,6 +215,9 @@ void rp_system::init2() {
 	m_key_rep = 0;
 	m_key_old = 0;
 	m_waitFP_COM_DRQ = 0;
+	m_rcv_com = 0;
+	m_rcv_dropped = 0;
+	resetIrqStats();
 	ap.setStep( ST_INIT );
 }
 
@@ -221,20 +234,97 @@ void rp_system::initVram() {
 	c.setDitherNo( 0 );
 	c.setDefCol( 3 );
 
-	for (int i = 0; i < VRAM_BUF_SIZE; i++) {
-		vram_buf0[i] = 0;
-		vram_buf1[i] = 0;
-	}
+	memset( vram_bufs, 0, sizeof(vram_bufs) );
+
+	m_vram_front = 0;
+	m_vram_draw = 1;
+	m_vram_last = 0;
+	m_vram_ready.store( 2 );
+	vram_buf = vram_bufs[ m_vram_front ];
+	vram_bufDraw = vram_bufs[ m_vram_draw ];
+	m_external_frames = false;
+	m_frames_dropped = 0;
+	m_frames_repeated = 0;
+
+	setDirectRect( 0, 0, 0, 0 );
+}
+
+
+void rp_system::setDirectRect( int x, int y, int w, int h ) {
+	m_direct_x = x / 8;
+	m_direct_y = y;
+	m_direct_w = w / 8;
+	m_direct_h = h;
+	markCanvasDirty();
+}
+
 
-	vram_buf = vram_buf0;
-	vram_bufDraw = vram_buf1;
+void rp_system::keepDirectLine( int y ) {
+	int idx = VRAM_TOP_WORDS + y * VRAM_LINE_WORDS + m_direct_x;
+	memcpy( (uint16_t *)vram_bufDraw + idx, (uint16_t *)vram_bufs[ m_vram_last ] + idx,
+			m_direct_w * sizeof(uint16_t) );
 }
 
 
 void rp_system::initFC_COM_BUF() {
+	nextFC_COM_BUF();
+
 	memset(FC_COM_BUF, 0x0, FC_COM_BUF_SIZE );
 	FC_COM_BUF[1] = PF_MAGIC_NO;
+
+	memset(FC_COM_EXT, 0x0, FC_COM_EXT_SIZE );
+	FC_COM_EXT[0] = PF_MAGIC_NO;
+
+	// and the one after it, so that the IRQ only has to switch
+	m_link.prepareTail();
+}
+
+// The tail the next vsync sends, cleared by rp_fclink
+void rp_system::nextFC_COM_BUF() {
+	FC_COM_BUF = m_link.comBuf();
+	FC_COM_EXT = m_link.extBuf();
 	m_FC_COM_IDX = 2;
+	m_FC_EXT_IDX = 1;
+	m_FC_EXT_VRAM = 0;
+}
+
+
+// Append a record to the extended area. NULL when the FC does not read the
+// area or the record does not fit.
+uint8_t *rp_system::allocFC_EXT( uint8_t type, uint8_t len ) {
+	if ( !m_com_ext || (m_FC_EXT_IDX + 1 + len) > FC_COM_EXT_SIZE ) {
+		return NULL;
+	}
+	uint8_t *dt = &FC_COM_EXT[ m_FC_EXT_IDX ];
+	dt[0] = type | len;
+	m_FC_EXT_IDX += 1 + len;
+	m_FC_EXT_VRAM = 0;
+	return dt + 1;
+}
+
+bool rp_system::setEXT_VRAM( uint16_t vadr, uint8_t dt ) {
+	uint8_t *p;
+
+	// Pokes in a row share one record
+	if ( m_FC_EXT_VRAM
+		&& ((FC_COM_EXT[ m_FC_EXT_VRAM ] & PF_EXT_LEN_MASK) + 3) <= PF_EXT_LEN_MASK
+		&& (m_FC_EXT_IDX + 3) <= FC_COM_EXT_SIZE ) {
+		p = &FC_COM_EXT[ m_FC_EXT_IDX ];
+		m_FC_EXT_IDX += 3;
+		FC_COM_EXT[ m_FC_EXT_VRAM ] += 3;
+	} else {
+		p = allocFC_EXT( PF_EXT_VRAM, 3 );
+		if ( p == NULL ) {
+			return true;
+		}
+		m_FC_EXT_VRAM = (p - 1) - FC_COM_EXT;
+	}
+
+	vadr &= 0x3FFF;
+	p[0] = (vadr >> 8) & 0xff;
+	p[1] = (vadr & 0xff);
+	p[2] = dt;
+	return false;
 }
 
 
@@ -251,7 +341,8 @@ bool rp_system::setPF_COM( uint8_t com ) {
 bool rp_system::setPF_VRAM( uint16_t vadr, uint8_t dt ) {
 	if ( m_FC_COM_IDX >= (FC_COM_BUF_SIZE-2) ) {
 		//Serial.printf("over flow:setPF_VRAM :%04x,%02x\n", vadr, dt );
-		return true;
+		// FC_COM_BUF is full: the extended area, if the FC reads it
+		return setEXT_VRAM( vadr, dt );
 	}
 	//Serial.printf("setPF_VRAM :%04x,%02x\n", vadr, dt );
 
@@ -276,27 +367,24 @@ void rp_system::playSE( uint8_t seno ) {
 //		APU コマンド関連
 //=================================================
 
-// APU コマンドマジック定数
-#define APU_MAGIC_FULL      0xA0  // Full APU Update: 0xA0 | writeMask
+// APU コマンドマジック定数 (Full APU Update は rp_apupkt.h)
 #define APU_MAGIC_PERCHAN   0xB0  // Per-Channel Update: 0xB0 | channel
 #define APU_MAGIC_SILENCE   0xC0  // Quick Silence
 
 // 検証バイト定数 ($41 に埋め込み、$400C の上位2ビットが常に0であることを利用)
-#define APU_CHECK_FULL      0x40  // Full: 上位2ビット = 01 (0x40-0x7F)
 #define APU_CHECK_PERCHAN   0x50  // PerCh: 上位4ビット = 0101 (0x50-0x5F)
 #define APU_CHECK_SILENCE   0x60  // Silence: 固定値
 
+// 拡張コマンド領域の有効化 ($40/$41、パッチ済み ROM のみ解釈する)
+#define APU_MAGIC_EXT       0xD0
+#define APU_CHECK_EXT       0x70
+
 void rp_system::queueApuWrite(uint8_t reg, uint8_t value) {
 	if (reg >= APU_REG_COUNT) return;
 
 	// 位相リセット対象レジスタ: 書き込みがあったことを記録
 	// 値の比較は sendApuCommands() で行う (連続書き込み vs 新規書き込みの判定)
-	switch (reg) {
-		case 0x03: m_apuWriteMask |= 0x01; break;
-		case 0x07: m_apuWriteMask |= 0x02; break;
-		case 0x0B: m_apuWriteMask |= 0x04; break;
-		case 0x0F: m_apuWriteMask |= 0x08; break;
-	}
+	m_apuWriteMask |= apuPktWriteFlag(reg);
 
 	m_apuRegLatest[reg] = value;
 }
@@ -314,6 +402,7 @@ void rp_system::resetApuState() {
 	memset(m_apuRegPrev, 0xFF, sizeof(m_apuRegPrev));  // 異なる値で初期化
 	m_apuWriteMask = 0x0F;      // 初回は全レジスタ書き込み
 	m_apuWriteMaskPrev = 0x00;  // 前フレームは書き込みなし扱い
+	m_apuRefresh = 0;           // 拡張コマンド領域では全レジスタを送り直す
 }
 
 void rp_system::sendApuCommands() {
@@ -326,70 +415,72 @@ void rp_system::sendApuCommands() {
 	// - 新規書き込み (前フレームでは書かず、今フレームで書いた): 書き込む
 	// - period 変化: 書き込む
 	// - 連続書き込み (毎フレーム書き込むドライバ): スキップ (クリック回避)
-	uint8_t writeMask = 0;
-
-	// Pulse 1: 前フレームで書き込まず今フレームで書き込んだ = 新しいノート
-	bool p1_new_write = (m_apuWriteMask & 0x01) && !(m_apuWriteMaskPrev & 0x01);
-	// Period 比較: $4003 は下位3ビットのみ (bit 3-7 は Length Counter Load でフェーズリセット不要)
-	bool p1_period_changed = (m_apuRegLatest[0x02] != m_apuRegPrev[0x02] ||
-	                          (m_apuRegLatest[0x03] & 0x07) != (m_apuRegPrev[0x03] & 0x07));
-	if (p1_new_write || p1_period_changed) {
-		writeMask |= 0x01;
-	}
-
-	// Pulse 2
-	bool p2_new_write = (m_apuWriteMask & 0x02) && !(m_apuWriteMaskPrev & 0x02);
-	// Period 比較: $4007 は下位3ビットのみ (bit 3-7 は Length Counter Load でフェーズリセット不要)
-	bool p2_period_changed = (m_apuRegLatest[0x06] != m_apuRegPrev[0x06] ||
-	                          (m_apuRegLatest[0x07] & 0x07) != (m_apuRegPrev[0x07] & 0x07));
-	if (p2_new_write || p2_period_changed) {
-		writeMask |= 0x02;
-	}
-
-	// Triangle
-	bool tri_new_write = (m_apuWriteMask & 0x04) && !(m_apuWriteMaskPrev & 0x04);
-	bool tri_period_changed = (m_apuRegLatest[0x0A] != m_apuRegPrev[0x0A] ||
-	                           m_apuRegLatest[0x0B] != m_apuRegPrev[0x0B]);
-	if (tri_new_write || tri_period_changed) {
-		writeMask |= 0x04;
-	}
-
-	// Noise
-	bool noise_new_write = (m_apuWriteMask & 0x08) && !(m_apuWriteMaskPrev & 0x08);
-	bool noise_period_changed = (m_apuRegLatest[0x0E] != m_apuRegPrev[0x0E] ||
-	                             m_apuRegLatest[0x0F] != m_apuRegPrev[0x0F]);
-	if (noise_new_write || noise_period_changed) {
-		writeMask |= 0x08;
-	}
+	// 書き込みフラグは update() がパケットごとに resetApuWriteFlags() で進める
+	uint8_t writeMask = apuPktWriteMask(m_apuRegLatest, m_apuRegPrev,
+	                                    m_apuWriteMask, m_apuWriteMaskPrev);
 
 	// 前回値を更新
 	memcpy(m_apuRegPrev, m_apuRegLatest, sizeof(m_apuRegPrev));
 
-	// FC_COM_BUF に Full APU Update コマンドを書き込み (16バイト全体を使用)
+	// FC に送る値 (HW sweep無効化、$400C の上位2ビットは検証用)
+	uint8_t regs[APU_REG_COUNT];
+	apuPktRegs(regs, m_apuRegLatest);
+
+	// Full APU Update コマンドを書き込み (FC_COM_BUF の16バイト全体を使用)
 	// $40: マジックバイト (0xA0 | writeMask)
 	// $41: 検証バイト (0x40 | Noise Vol)
 	// $42-$4F: APU レジスタデータ
-	FC_COM_BUF[0]  = APU_MAGIC_FULL | writeMask;
-	FC_COM_BUF[1]  = APU_CHECK_FULL | (m_apuRegLatest[0x0C] & 0x3F);  // $400C: Noise Vol (検証付き)
-	FC_COM_BUF[2]  = m_apuRegLatest[0x0E];   // $400E: Noise Mode/Period
-	FC_COM_BUF[3]  = m_apuRegLatest[0x0F];   // $400F: Noise Length
-	FC_COM_BUF[4]  = m_apuRegLatest[0x00];   // $4000: Pulse1 Duty/Vol
-	FC_COM_BUF[5]  = m_apuRegLatest[0x01] & 0x7F;   // $4001: Pulse1 Sweep (HW sweep無効化)
-	FC_COM_BUF[6]  = m_apuRegLatest[0x02];   // $4002: Pulse1 Freq Lo
-	FC_COM_BUF[7]  = m_apuRegLatest[0x03];   // $4003: Pulse1 Freq Hi
-	FC_COM_BUF[8]  = m_apuRegLatest[0x04];   // $4004: Pulse2 Duty/Vol
-	FC_COM_BUF[9]  = m_apuRegLatest[0x05] & 0x7F;   // $4005: Pulse2 Sweep (HW sweep無効化)
-	FC_COM_BUF[10] = m_apuRegLatest[0x06];   // $4006: Pulse2 Freq Lo
-	FC_COM_BUF[11] = m_apuRegLatest[0x07];   // $4007: Pulse2 Freq Hi
-	FC_COM_BUF[12] = m_apuRegLatest[0x08];   // $4008: Triangle Linear
-	FC_COM_BUF[13] = m_apuRegLatest[0x0A];   // $400A: Triangle Freq Lo
-	FC_COM_BUF[14] = m_apuRegLatest[0x0B];   // $400B: Triangle Freq Hi
-	FC_COM_BUF[15] = m_apuRegLatest[0x15];   // $4015: Status/Enable (最後に書き込み)
+	if (!m_com_ext) {
+		apuPktFull(FC_COM_BUF, regs, writeMask);
+		return;
+	}
+
+	// Extended area: only the registers that changed since the last packet
+	// (nothing at all in a quiet frame), with a full block now and then and
+	// after a frame the FC may have missed.
+	if (m_apu_resync) {
+		m_apu_resync = false;
+		m_apuRefresh = 0;
+	}
+	uint8_t pkt[APUPKT_DELTA_MAX];
+	uint8_t len = APUPKT_FULL_LEN;
+	if (m_apuRefresh != 0) {
+		len = apuPktDelta(pkt, regs, m_apuRegSent, writeMask);
+		if (len == 0) {
+			return;
+		}
+	}
+	uint8_t *dt;
+	if (len >= APUPKT_FULL_LEN) {
+		dt = allocFC_EXT(PF_EXT_APU, APUPKT_FULL_LEN);
+		if (dt != NULL) {
+			apuPktFull(dt, regs, writeMask);
+			memcpy(m_apuRegSent, regs, sizeof(m_apuRegSent));
+			m_apuRefresh = APU_REFRESH_FRAMES;
+		}
+	} else {
+		dt = allocFC_EXT(PF_EXT_APU_DELTA, len);
+		if (dt != NULL) {
+			memcpy(dt, pkt, len);
+			m_apuRefresh--;
+		}
+	}
+	if (dt == NULL) {
+		// Goes first, so this does not happen; resend everything if it does
+		m_apuRefresh = 0;
+		return;
+	}
+	m_apu_ext_bytes += 1 + len;
+	m_apu_ext_packets++;
 }
 
 void rp_system::sendApuSilence() {
 	// Quick Silence コマンドを送信
 	// トラック切り替え時などに使用
+	if (m_com_ext) {
+		allocFC_EXT(PF_EXT_APU_OFF, 0);
+		return;
+	}
 	FC_COM_BUF[0] = APU_MAGIC_SILENCE;
 	FC_COM_BUF[1] = APU_CHECK_SILENCE;
 	// $42-$4F は無視されるが、念のため0で埋める
@@ -443,48 +534,71 @@ void rp_system::sendApuPerChannel(uint8_t channel, bool writeReg3) {
 //=================================================
 void rp_system::convVram() {
 	uint16_t *vram_w = (uint16_t*)vram_bufDraw;
-	const uint16_t conv_tbl[4] = {
-		0x0000,
-		0x0001,
-		0x0100,
-		0x0101,
-	};
-	int fidx = 0;
-	int vidx = 31;
 	uint8_t* frame_buff = c.bitmap();
 
-	for (int y = 0; y < 240; y++) {
-		for (int x = 0; x < 34; x++) {
-			uint16_t dt = 0;
-			for (int f = 0; f < 8; f++) {
-				dt <<= 1;
-				dt |= conv_tbl[ frame_buff[ fidx++ ] & 3 ];
+	// With a direct rectangle the Canvas only holds the border, so it is
+	// converted only after it changed, once into each buffer. A dropped
+	// frame gives the producer the same buffer again, so they are counted
+	// by index, not by frame.
+	uint8_t dirty = 1 << m_vram_draw;
+	if ( m_direct_w == 0 || (m_canvas_dirty & dirty) ) {
+		m_canvas_dirty &= ~dirty;
+
+		for (int y = 0; y < CANVAS_HEIGHT; y++) {
+			bool direct = (y >= m_direct_y) && (y < m_direct_y + m_direct_h);
+			int fidx = y * CANVAS_WIDTH;
+			int vidx = VRAM_TOP_WORDS + y * VRAM_LINE_WORDS;
+
+			for (int x = 0; x < VRAM_LINE_WORDS; x++, fidx += 8, vidx++) {
+				if ( direct && x >= m_direct_x && x < m_direct_x + m_direct_w ) {
+					continue;
 				}
-			vram_w[vidx++] = dt;
+				vram_w[vidx] = ppuPackWord( &frame_buff[ fidx ] );
+			}
 		}
 	}
 
+}
 
-	// swap buffer
-	if ( vram_buf == vram_buf0 ) {
-		vram_buf = vram_buf1;
-		vram_bufDraw = vram_buf0;
-	} else {
-		vram_buf = vram_buf0;
-		vram_bufDraw = vram_buf1;
-	}
 
+void rp_system::publishVram() {
+	// Hand the draw buffer over and draw into whatever was ready. If that
+	// was never shown, the frame is dropped.
+	uint8_t prev = m_vram_ready.exchange( m_vram_draw | VRAM_FRESH, std::memory_order_acq_rel );
+	if ( prev & VRAM_FRESH ) {
+		m_frames_dropped++;
+	}
+	m_vram_last = m_vram_draw;
+	m_vram_draw = prev & VRAM_INDEX;
+	vram_bufDraw = vram_bufs[ m_vram_draw ];
 }
 
 void rp_system::update(void) {
 	// バッファをリセット
 	initFC_COM_BUF();
 
+	// GB フレーム実行中 (core1) は APU レジスタが書き換わるので次回に回す
+	bool apu = !gbemu.isFrameBusy();
+
+	// Per-frame budget: FC_COM_BUF (14 bytes of commands) plus the extended
+	// area (31 bytes of records) when the FC reads it. The APU packet goes
+	// first, since a late note is heard while a late colour is hardly seen,
+	// then PAL and ATR pokes until both are full. The rest waits for the
+	// next frame. The APU packet is a delta, so it usually leaves most of
+	// the area to the pokes.
+	if ( m_com_ext && apu ) {
+		sendApuCommands();
+		resetApuWriteFlags();	// the next frame tells new notes from rewrites
+	}
+
+	bool deferred = false;
+
 	// PAL update (他コマンド優先)
 	for( int i=0 ; i<0x20 ; i++ ) {
 		uint8_t at = m_PAL_W[i];
 		if ( at != m_PAL_W_old[i] ) {
 			if ( setPF_VRAM( 0x3F00 + i , at ) ) {
+				deferred = true;
 				break;
 			}
 			m_PAL_W_old[i] = at;
@@ -492,66 +606,77 @@ void rp_system::update(void) {
 	}
 
 	// BG ATR update
-	for( int i=0 ; i<0x40 ; i++ ) {
+	for( int i=0 ; i<0x40 && !deferred ; i++ ) {
 		uint8_t at = m_ATR_W[i];
 		if ( at != m_ATR_W_old[i] ) {
 			if ( setPF_VRAM( 0x23C0 + i , at ) ) {
+				deferred = true;
 				break;
 			}
 			m_ATR_W_old[i] = at;
 		}
 	}
+	if ( deferred ) {
+		m_com_deferred++;
+	}
 
-	// 他コマンドがなければ APU データを送信
+	// 拡張コマンド領域がなければ、他コマンドがない時だけ APU データを送信
 	// FC_COM_BUF[0] == 0: SE番号なし
 	// m_FC_COM_IDX == 2: コマンド追加なし
-	if (FC_COM_BUF[0] == 0 && m_FC_COM_IDX == 2) {
-		sendApuCommands();
+	if ( !m_com_ext && FC_COM_BUF[0] == 0 && m_FC_COM_IDX == 2 ) {
+		if ( m_apuSupported && m_com_ext_req ) {
+			// パッチ済み ROM に拡張コマンド領域を読むよう要求
+			// (古いパッチ済み ROM は無視するので、回数を限って送る)
+			m_com_ext_req--;
+			FC_COM_BUF[0] = APU_MAGIC_EXT;
+			FC_COM_BUF[1] = APU_CHECK_EXT;
+		} else if ( apu ) {
+			sendApuCommands();
+			resetApuWriteFlags();
+		}
 	}
 
-	convVram();
+	if ( !m_external_frames ) {
+		convVram();
+		publishVram();
+	}
 }
 
 
 
-void rp_system::ppu_dma(void) {
+static_assert( FC_FRAME_WORDS <= VRAM_BUF_SIZE, "PPU buffer shorter than a frame" );
 
-//	pio_sm_exec( pio0, SM_TRAN, 0x8000 );  //  push   noblock                    
-//	pio_sm_exec( pio0, SM_TRAN, 0xa02b );  //  mov    x, !null                   
-//	ppu_count = pio_sm_get(pio0, SM_TRCNT);
+void rp_system::ppu_dma(void) {
 
-	pio_sm_clear_fifos (pio0, SM_TRAN);
-	pio_sm_restart (pio0, SM_TRAN);
+	// The FC reads FC_COM_BUF alone, or followed by the extended area
+	uint32_t count = m_link.beginFrame();
 
-	// １フレームのPPUデータ出力回数カウント
-	pio_sm_exec( pio0, SM_TRCNT, 0x8000 );  //  push   noblock                    
-	pio_sm_exec( pio0, SM_TRCNT, 0xa02b );  //  mov    x, !null                   
-	pio_sm_restart (pio0, SM_TRCNT);
-	ppu_count = pio_sm_get(pio0, SM_TRCNT);
+	// Send the newest published frame, or the last one again. The buffer
+	// is not touched by the producer until it is exchanged back.
+	if ( m_vram_ready.load( std::memory_order_relaxed ) & VRAM_FRESH ) {
+		uint8_t prev = m_vram_ready.exchange( m_vram_front, std::memory_order_acq_rel );
+		m_vram_front = prev & VRAM_INDEX;
+		vram_buf = vram_bufs[ m_vram_front ];
+	} else {
+		m_frames_repeated++;
+	}
 
-	if ( (ppu_count >= (PPU_COUNT_VAL -2) ) && (ppu_count <= PPU_COUNT_VAL ) )  {
-		vram_dma.TransSM_DMA( vram_buf, VRAM_BUF_SIZE );
-		if ( ppu_count == (PPU_COUNT_VAL -2) ) {
-			pio_sm_exec( pio0, SM_TRAN, 0x6008 );  // out    pins, 8
-			pio_sm_exec( pio0, SM_TRAN, 0x6008 );  // out    pins, 8
-		}
-		if ( ppu_count == (PPU_COUNT_VAL -1) ) {
-			pio_sm_exec( pio0, SM_TRAN, 0x6008 );  // out    pins, 8
+	if ( count != 0 )  {
+		if ( count == PPU_COUNT_EXT && !m_com_ext ) {
+			m_apu_resync = true;	// APU deltas start from a full block
 		}
-#if 1
-		// フレームデータの最後にコマンドをセット
-		uint8_t* pb = (uint8_t*)vram_buf;
-		memcpy( pb + PPU_COUNT_VAL - FC_COM_BUF_SIZE, FC_COM_BUF, FC_COM_BUF_SIZE);
-		initFC_COM_BUF();
-#endif
+		m_com_ext = (count == PPU_COUNT_EXT);
+		m_link.sendFrame( count, vram_buf );
+		nextFC_COM_BUF();
 	} else {
-		vram_dma.StopDMA();
+		m_link.stopFrame();
+		m_apu_resync = true;	// the FC did not get this frame's APU delta
 	}
 
 #if 0  // Debug: ppu_count
-	if ( ppu_count != ppu_count_old ) {
-		Serial.printf("ppu_count:%d (expected:%d)\n", ppu_count, PPU_COUNT_VAL );
-		ppu_count_old = ppu_count;
+	if ( m_link.getReadCount() != ppu_count_old ) {
+		Serial.printf("ppu_count:%d (expected:%d)\n", m_link.getReadCount(), PPU_COUNT_VAL );
+		ppu_count_old = m_link.getReadCount();
 	}
 #endif
 
@@ -568,97 +693,191 @@ void rp_system::setKeyUpdate() {
 }
 
 
-uint8_t rp_system::getRcvCom() {
-	return (uint8_t)(pio_sm_get_blocking(pio0, SM_RECV) & 0xff);
+// FC->PICO command left to the main loop by the IRQ
+struct rcv_job {
+	uint8_t com;
+	uint8_t len;
+	uint8_t dt[7];
+};
+static rp_spsc<rcv_job, 16> rcv_queue;
+
+void rp_system::queueRcvJob( uint8_t com, const uint8_t *dt, uint8_t len ) {
+	rcv_job job;
+	job.com = com;
+	job.len = len;
+	if ( len ) {
+		memcpy( job.dt, dt, len );	// dt may be NULL without data
+	}
+	if ( !rcv_queue.push( job ) ) {
+		m_rcv_dropped++;
+	}
 }
 
-
+// PIO IRQ. Only what the FC is waiting for is done here: the next frame and
+// the DRQ/DLD/ROM/VER replies. Everything else is queued for jobRcvQueue().
+// A command whose argument byte has not arrived yet waits in m_rcv_com for
+// the next IRQ instead of blocking.
 void rp_system::jobRcvCom() {
-	uint8_t dt;
+	while ( !m_link.isRcvEmpty() ) {
+		uint8_t dt = m_link.getRcvCom();
+
+		// 引数待ちのコマンド
+		if ( m_rcv_com != 0 ) {
+			uint8_t com = m_rcv_com;
+			m_rcv_com = 0;
+
+			switch( com ) {
+			case FP_COM_ROM:	// BIOS-ROMのROMデータ要求コマンド
+				WDT_update();
+				rom_dma( dt );
+				queueRcvJob( com, &dt, 1 );
+				break;
 
-	dt = getRcvCom();
+			case FP_COM_DLD:	// データロード
+				jobFP_COM_DLD( dt );
+				break;
 
-	switch( dt ) {
+			case FP_COM_INI:	// PICO initialize
+				queueRcvJob( com, &dt, 1 );
+				break;
+			}
+			continue;
+		}
 
-	case FP_COM_VER:	// BIOS-ROMのバージョン取得
-		Serial.printf("FP_COM_VER\n" );
-		WDT_update();
-		ver_dma();
-		break;
+		switch( dt ) {
 
-	case FP_COM_ROM:	// BIOS-ROMのROMデータ要求コマンド
-		dt =  getRcvCom();
-		Serial.printf("FP_COM_ROM:%02x\n", dt );
-		WDT_update();
-		rom_dma( dt );
-		break;
+		case FP_COM_ROM:
+		case FP_COM_DLD:
+		case FP_COM_INI:
+			m_rcv_com = dt;
+			break;
 
-	case 0x05:	// APU対応ROM通知 (パッチ済みROMから毎フレーム送信)
-		if (!m_apuSupported) {
-			Serial.println("APU supported ROM detected");
-			m_apuSupported = true;
-		}
-		break;
+		case FP_COM_VER:	// BIOS-ROMのバージョン取得
+			WDT_update();
+			ver_dma();
+			queueRcvJob( dt, NULL, 0 );
+			break;
 
-	case FP_COM_LOG:	// ログ表示
-		Serial.printf( "FP_COM_LOG:" );
-		for( int j =1 ; j< 8; j++ ) { 
-			if( pio_sm_is_rx_fifo_empty(pio0, SM_RECV) ) {
-				break;
+		case FP_COM_DRQ:	// データリクエスト
+			jobFP_COM_DRQ();
+			break;
+
+		case FP_COM_LOG: {	// ログ表示 (届いている分だけ)
+			rcv_job job;
+			job.len = 0;
+			while ( job.len < sizeof(job.dt) && !m_link.isRcvEmpty() ) {
+				job.dt[ job.len++ ] = m_link.getRcvCom();
 			}
-			dt = getRcvCom();
-			Serial.printf( "%02x ", dt );
+			queueRcvJob( dt, job.dt, job.len );
+			break;
 		}
-		Serial.println( "" );
-		break;
-
-	case FP_COM_DRQ:	// データリクエスト
-//		Serial.println( "FP_COM_DRQ" );
-		jobFP_COM_DRQ();
-		break;
-
-	case FP_COM_DLD:	// データロード
-		dt =  getRcvCom();
-//		Serial.printf("FP_COM_DLD:%02x\n", dt );
-		jobFP_COM_DLD( dt );
-		break;
-
-	case FP_COM_RST:	// PICO restart
-		Serial.println( "FP_COM_RST" );
-		{
-			bool was_gb_mode = (ap.getStep() == ST_GB);
-			soft_reset();
-			// Restore GB mode after reset
-			if (was_gb_mode) {
-				Serial.println("FP_COM_RST: Restoring GB mode");
-				gbemu.reset();
-				ap.setStep(ST_GB);
-			}
+
+		case 0x05:			// APU対応ROM通知 (パッチ済みROMから毎フレーム送信)
+		case FP_COM_RST:	// PICO restart
+			queueRcvJob( dt, NULL, 0 );
+			break;
+
+		default:
+			setKeyData( dt );
+			gbemu.latchJoypad( dt );
+			ppu_dma();
+			sys.frame_draw = 0;
+			setWDT_mode( 1 );
+			break;
 		}
-		break;
-
-	case FP_COM_INI:	// PICO initialize
-		dt = getRcvCom();
-		Serial.printf( "FP_COM_INI %02x\n", dt );
-		setWDT_mode( 1 );
-		// GB mode - skip init2() to preserve ST_GB step
-		if (ap.getStep() == ST_GB) {
-			Serial.println("FP_COM_INI: GB mode active, skipping init2");
-		} else {
-			init2();
+	}
+}
+
+void rp_system::jobRcvQueue() {
+	rcv_job job;
+
+	while ( rcv_queue.pop( &job ) ) {
+		switch( job.com ) {
+
+		case FP_COM_VER:
+			Serial.printf("FP_COM_VER\n" );
+			break;
+
+		case FP_COM_ROM:
+			Serial.printf("FP_COM_ROM:%02x\n", job.dt[0] );
+			break;
+
+		case 0x05:
+			if (!m_apuSupported) {
+				Serial.println("APU supported ROM detected");
+				m_apuSupported = true;
+			}
+			m_com_ext_req = FC_COM_EXT_TRIES;
+			break;
+
+		case FP_COM_LOG:
+			Serial.printf( "FP_COM_LOG:" );
+			for( int j = 0 ; j < job.len; j++ ) {
+				Serial.printf( "%02x ", job.dt[j] );
+			}
+			Serial.println( "" );
+			break;
+
+		case FP_COM_DRQ:	// jobFP_COM_DRQ() が FC のステップを返した
+			Serial.printf("PF_DAT_STEP:%02x\n", job.dt[0] );
+			break;
+
+		case FP_COM_RST:
+			Serial.println( "FP_COM_RST" );
+			{
+				bool was_gb_mode = (ap.getStep() == ST_GB);
+				// core1 draws into the PPU buffers and reads the Canvas, which
+				// are both reset below. Let its frame finish; the next one is
+				// not started before loop() has run ap.main() again.
+				gbemu.waitFrame();
+				bool external = m_external_frames;
+				uint8_t direct_x = m_direct_x, direct_y = m_direct_y;
+				uint8_t direct_w = m_direct_w, direct_h = m_direct_h;
+				// PIO と DMA を作り直すので、その間は割り込みを止める
+				irq_set_enabled( PIO0_IRQ_0, false );
+				soft_reset();
+				irq_set_enabled( PIO0_IRQ_0, true );
+				// Restore GB mode after reset
+				if (was_gb_mode) {
+					Serial.println("FP_COM_RST: Restoring GB mode");
+					// core1 stays the only producer, the GB screen stays direct
+					m_external_frames = external;
+					setDirectRect( direct_x * 8, direct_y, direct_w * 8, direct_h );
+					gbemu.reset();
+					ap.setStep(ST_GB);
+				}
+			}
+			break;
+
+		case FP_COM_INI:
+			Serial.printf( "FP_COM_INI %02x\n", job.dt[0] );
+			setWDT_mode( 1 );
+			// GB mode - skip init2() to preserve ST_GB step
+			if (ap.getStep() == ST_GB) {
+				Serial.println("FP_COM_INI: GB mode active, skipping init2");
+			} else {
+				init2();
+			}
+			break;
 		}
-		break;
+	}
+}
+
 
-		
-	default:
-		setKeyData( dt );
-		ppu_dma();
-		sys.frame_draw = 0;
-		setWDT_mode( 1 );
-		break;
+void rp_system::addIrqCycles( uint32_t cycles ) {
+	m_irq_count++;
+	m_irq_cycles_sum += cycles;
+	if ( cycles > m_irq_cycles_max ) {
+		m_irq_cycles_max = cycles;
 	}
 }
 
+void rp_system::resetIrqStats() {
+	m_irq_count = 0;
+	m_irq_cycles_sum = 0;
+	m_irq_cycles_max = 0;
+}
+
 
 
 void rp_system::FadeIn() {
@@ -717,7 +936,7 @@ void rp_system::jobFP_COM_DRQ() {
 
 	if( m_FC_STEP ) {
 		drq_ret(PF_DAT_STEP, m_FC_STEP, 0 );
-		Serial.printf("PF_DAT_STEP:%02x\n", m_FC_STEP );
+		queueRcvJob( FP_COM_DRQ, &m_FC_STEP, 1 );	// log
 		setWDT_mode( 0 );
 		m_FC_STEP = 0;
 		return;
@@ -732,25 +951,16 @@ void rp_system::jobFP_COM_DRQ() {
 // JOB FP_COM_DLD
 //=================================================
 void rp_system::jobFP_COM_DLD( uint8_t adrh ) {
-	pio_sm_clear_fifos (pio0, SM_TRAN);
-	pio_sm_restart (pio0, SM_TRAN);
-	vram_dma.TransSM_DMA( (uint32_t *)&m_pDRQ[ adrh << 8 ] , 0x100  / sizeof( uint32_t ) );
+	m_link.sendData( &m_pDRQ[ adrh << 8 ] , 0x100  / sizeof( uint32_t ) );
 }
 
 void rp_system::rom_dma( uint8_t adrh ) {
-	pio_sm_clear_fifos (pio0, SM_TRAN);
-//	pio_sm_put_blocking ( pio0, SM_TRAN, 0x21212121 );
-//	pio_sm_put_blocking ( pio0, SM_TRAN, 0x43462321 );
-	pio_sm_restart (pio0, SM_TRAN);
-	vram_dma.TransSM_DMA( (uint32_t *)&_rom[ (adrh & 0x7f) << 8 ] , 0x7000 );
+	m_link.sendData( &_rom[ (adrh & 0x7f) << 8 ] , 0x7000 );
 }
 
 void rp_system::ver_dma() {
-	pio_sm_clear_fifos (pio0, SM_TRAN);
-	pio_sm_put_blocking ( pio0, SM_TRAN, 0x21212121 );
-	pio_sm_put_blocking ( pio0, SM_TRAN, 0x43462321 );
-	pio_sm_restart (pio0, SM_TRAN);
-	vram_dma.TransSM_DMA( (uint32_t *)&_rom[ 0x6FF0 ] , 0x10 / sizeof( uint32_t ) );
+	static const uint32_t head[2] = { 0x21212121, 0x43462321 };
+	m_link.sendData( &_rom[ 0x6FF0 ] , 0x10 / sizeof( uint32_t ), head, 2 );
 }
 
 
@@ -758,13 +968,10 @@ void rp_system::ver_dma() {
 // Data Request Response
 //=================================================
 void rp_system::drq_ret( uint8_t com, uint16_t adr, uint16_t size ) {
-	pio_sm_clear_fifos (pio0, SM_TRAN);
-	pio_sm_restart (pio0, SM_TRAN);
-	vram_dma.StopDMA();
-
-	uint32_t data = 0xFC00 + com + (adr << 16);
-	pio_sm_put_blocking ( pio0, SM_TRAN, data);
-	pio_sm_put_blocking ( pio0, SM_TRAN, size);
+	uint32_t head[2];
+	head[0] = 0xFC00 + com + (adr << 16);
+	head[1] = size;
+	m_link.sendData( NULL, 0, head, 2 );
 }
 
 //=================================================
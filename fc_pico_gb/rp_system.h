@@ -10,6 +10,7 @@
 #include "hardware/dma.h"
 //#include "hardware/address_map.h"	// アドレスマップ定義
 #include <hardware/watchdog.h>
+#include <atomic>
 
 #include "rp_debug.h"
 
@@ -20,6 +21,7 @@
 #endif
 
 #include "rp_dma.h"
+#include "rp_fclink.h"
 #include "ap_main.h"
 
 //---------------------------------------
@@ -62,46 +64,6 @@
 #define	SM_TRCNT	3
 
 
-//---------------------------------------
-// PICO->FC command
-//---------------------------------------
-enum{
-	PF_COM_NONE = 0,		// コマンドなし
-	PF_COM_DMOD = 1,		// 表示OFFにしてデータ転送モードへ
-	PF_COM_FDIN = 2,		// フェードイン	処理終了　FP_COM_ACK
-	PF_COM_FDOT = 3,		// フェードアウト	処理終了　FP_COM_ACK
-
-	PF_COM_SE   = 0x80,		// SEセット:0x80 + SE_NO
-	PF_COM_VRAM = 0xC0,		// VRAM 書き換え:adrH,ardL,dt
-
-
-	// データモードコマンド
-	PF_DAT_VRAM = 0x80,		//  VRAM 書き換え:adrH,ardL,size,data....
-							//  --> size = 0 は256バイト 256バイト以上送りたい場合は分割して送る
-	PF_DAT_RAM  = 0x81, 	//  VRAM 書き換え:adrH,ardL,size,data....
-
-	PF_DAT_STEP = 0x82, 	//  データモードを抜けてファミコンの指定ステップへ
-
-	PF_MAGIC_NO = 0xFC	// 受け取ったコマンドの可否チェックコード
-};
-
-//---------------------------------------
-// FC->PICO command
-//---------------------------------------
-enum{
-//	FP_COM_ACK	= 0x0F,		// FCからのコマンド正常終了応答
-//	FP_COM_NAK	= 0x1F,		// FCからのコマンド失敗終了応答
-	FP_COM_VER	= 0x2F,		// BIOS-ROM romvarsion
-	FP_COM_ROM	= 0x3F,		// BIOS-ROM romdeta load
-
-	FP_COM_LOG	= 0xBF,		// debug log
-	FP_COM_DRQ	= 0xCF,		// data request
-	FP_COM_DLD	= 0xDF,		// data load
-	FP_COM_RST	= 0xEF,		// PICO RESTART
-	FP_COM_INI	= 0xFF,		// PIC INIT
-};
-
-
 //---------------------------------------
 // Sound Effect NO
 //---------------------------------------
@@ -174,10 +136,8 @@ enum{
 #define MICROS_1S  (1000*1000)
 #define MICROS_1MS  (1000)
 
-#define FC_COM_BUF_SIZE	16
-
-
-#define PPU_COUNT_VAL	(15426 + FC_COM_BUF_SIZE)
+// FC_COM_BUF, the extended command area and PPU_COUNT_* are in rp_fclink.h
+#define FC_COM_EXT_TRIES	8	// enable requests sent after the APU notification
 
 
 
@@ -187,6 +147,17 @@ enum{
 //=================================================
 
 #define VRAM_BUF_SIZE ((36 * 2 * 240 + FC_COM_BUF_SIZE) / sizeof(uint32_t))
+
+// PPU data layout: one 16-bit word per 8 pixels (low byte = plane 0,
+// high byte = plane 1, MSB = leftmost pixel), 256 pixels per line.
+#define VRAM_TOP_WORDS	31		// words before line 0
+#define VRAM_LINE_WORDS	32		// words per line
+
+// Triple buffer: front (sent by DMA at each vsync), ready (newest complete
+// frame) and draw (being drawn by the producer)
+#define VRAM_BUF_NUM	3
+#define VRAM_FRESH		0x80	// m_vram_ready: not shown yet
+#define VRAM_INDEX		0x03
 //#define VRAM_BUF_SIZE ((32 * 2 * 240) / sizeof(uint32_t))
 
 
@@ -199,8 +170,41 @@ public:
     void update(void);
 	void soft_reset();
     void initVram();
-    void convVram();
-	void jobRcvCom();
+    void convVram();	// Canvas -> draw buffer
+	void publishVram();	// the draw buffer is complete, show it from the next vsync
+
+	// Frames are converted and published by their producer (the GB emulator
+	// on core1) instead of update()
+	void setExternalFrames( bool on ) { m_external_frames = on; }
+	uint32_t getFramesDropped() { return m_frames_dropped; }	// replaced before shown
+	uint32_t getFramesRepeated() { return m_frames_repeated; }	// vsyncs without a new frame
+	bool isComExt() { return m_com_ext; }	// the FC reads the extended command area
+	uint32_t getComDeferred() { return m_com_deferred; }	// frames with PAL/ATR left for later
+	uint32_t getApuExtPackets() { return m_apu_ext_packets; }	// APU records in the extended area
+	uint32_t getApuExtBytes() { return m_apu_ext_bytes; }	// and their size with the headers
+	uint32_t getLinkFramesLost() { return m_link.getFramesLost(); }	// vsyncs without a frame sent
+
+	// Direct PPU output: the owner of the rectangle writes PPU words into the
+	// back buffer itself, and convVram() leaves it alone. x and w must be
+	// multiples of 8. w = 0 disables the rectangle.
+	void setDirectRect( int x, int y, int w, int h );
+	uint16_t *getDrawLine( int y ) {
+		return (uint16_t *)vram_bufDraw + VRAM_TOP_WORDS + y * VRAM_LINE_WORDS;
+	}
+	void keepDirectLine( int y );	// copy line y of the rectangle from the last published buffer
+	uint8_t getDrawIndex() { return m_vram_draw; }
+	uint8_t getLastIndex() { return m_vram_last; }
+	void markCanvasDirty() { m_canvas_dirty = (1 << VRAM_BUF_NUM) - 1; }	// every buffer needs converting
+	void jobRcvCom();	// PIO IRQ: drains the FC->PICO FIFO, never waits
+	void jobRcvQueue();	// main loop: the commands jobRcvCom() left for later
+
+	// pio0_itr0() duration, in CPU cycles
+	void addIrqCycles( uint32_t cycles );
+	uint32_t getIrqCount() { return m_irq_count; }
+	uint32_t getIrqCyclesAvg() { return m_irq_count ? m_irq_cycles_sum / m_irq_count : 0; }
+	uint32_t getIrqCyclesMax() { return m_irq_cycles_max; }
+	uint32_t getRcvDropped() { return m_rcv_dropped; }	// commands lost to a full queue
+	void resetIrqStats();
 
     void ppu_dma(void);
     void ver_dma();
@@ -216,7 +220,7 @@ public:
 	void sendApuCommands();        // Full APU update (0xAx)
 	void sendApuSilence();         // Quick silence (0xC0)
 	void sendApuPerChannel(uint8_t channel, bool writeReg3);  // Per-channel update (0xBx)
-	void resetApuWriteFlags();     // Reset write flags at start of each frame
+	void resetApuWriteFlags();     // Reset write flags after each APU packet
 	void resetApuState();          // Reset APU state for new track
 
 
@@ -241,20 +245,27 @@ public:
 	void setAtr( uint8_t lx, uint8_t ly, uint8_t dt );
 	void setFcStep( uint8_t step ) { m_FC_STEP = step; }
 
-	uint32_t ppu_count;
 	uint8_t frame_draw;
 
 private:
 	void initFC_COM_BUF();
+	void nextFC_COM_BUF();
+	uint8_t *allocFC_EXT( uint8_t type, uint8_t len );
+	bool setEXT_VRAM( uint16_t vadr, uint8_t dt );
 	void jobFP_COM_DRQ();
 	void jobFP_COM_DLD( uint8_t adrh );
     void rom_dma( uint8_t adrh );
 	void drq_ret( uint8_t com, uint16_t adr, uint16_t size );
 
-	uint8_t getRcvCom();
-
 	uint8_t m_waitFP_COM_DRQ;
 
+	void queueRcvJob( uint8_t com, const uint8_t *dt, uint8_t len );
+	uint8_t m_rcv_com;			// IRQ: command waiting for its argument byte
+	uint32_t m_rcv_dropped;
+	volatile uint32_t m_irq_count;
+	volatile uint32_t m_irq_cycles_sum;
+	volatile uint32_t m_irq_cycles_max;
+
 	uint8_t m_key_imp;
 	uint8_t m_key_new;
 	uint8_t m_key_trg;
@@ -273,9 +284,18 @@ private:
 	uint8_t m_ATR_W_old[0x40];
 	uint8_t m_ATR_CHG;
 
-	uint8_t FC_COM_BUF[ FC_COM_BUF_SIZE ];
+	// Command tail of the next frame, in m_link (rp_fclink::comBuf())
+	uint8_t *FC_COM_BUF;
 	uint8_t m_FC_COM_IDX;
 
+	// Extended command area: filled by update(), sent after FC_COM_BUF
+	uint8_t *FC_COM_EXT;
+	uint8_t m_FC_EXT_IDX;
+	uint8_t m_FC_EXT_VRAM;		// header of the open PF_EXT_VRAM record, 0 = none
+	volatile bool m_com_ext;	// IRQ: the last frame was read with the extended area
+	uint8_t m_com_ext_req;		// enable requests left to send
+	uint32_t m_com_deferred;
+
 	bool m_apuSupported;	// FC ROM が APU 対応かどうか
 
 	// APU レジスタバッファ
@@ -290,18 +310,43 @@ private:
 	// 前回送信したperiod値 (変化検出用)
 	uint8_t m_apuRegPrev[APU_REG_COUNT];
 
-
-	uint32_t vram_buf0[VRAM_BUF_SIZE];
-	uint32_t vram_buf1[VRAM_BUF_SIZE];	// バックバッファ
-
-	uint32_t *vram_buf;
-	uint32_t *vram_bufDraw;
+	// APU deltas in the extended area: what the FC was last sent, and the
+	// packets left until the next full block
+	static const uint8_t APU_REFRESH_FRAMES = 60;
+	uint8_t m_apuRegSent[APU_REG_COUNT];
+	uint8_t m_apuRefresh;
+	volatile bool m_apu_resync;	// IRQ: a packet may have been lost, send a full block
+	uint32_t m_apu_ext_bytes;
+	uint32_t m_apu_ext_packets;
+
+
+	uint32_t vram_bufs[VRAM_BUF_NUM][VRAM_BUF_SIZE];
+
+	uint32_t *vram_buf;		// front, IRQ only
+	uint32_t *vram_bufDraw;	// draw, producer only
+
+	// Only m_vram_ready is shared: the IRQ and the producer each exchange
+	// their own buffer with it
+	std::atomic<uint8_t> m_vram_ready;	// index | VRAM_FRESH
+	uint8_t m_vram_front;	// IRQ
+	uint8_t m_vram_draw;	// producer
+	uint8_t m_vram_last;	// producer: newest published buffer
+	bool m_external_frames;
+	volatile uint32_t m_frames_dropped;
+	volatile uint32_t m_frames_repeated;
+
+	// Direct PPU output rectangle, in words (x, w) and lines (y, h)
+	uint8_t m_direct_x;
+	uint8_t m_direct_y;
+	uint8_t m_direct_w;
+	uint8_t m_direct_h;
+	uint8_t m_canvas_dirty;	// buffers convVram() must convert, a bit per index
 
 	uint8_t *vram;
 
 	uint8_t m_FC_STEP;
 
-	rp_dma vram_dma;
+	rp_fclink m_link;		// PIO/DMA link to the FC
 
 #if DFPLAYER_MINI
 	DFRobotDFPlayerMini mp3;
@@ -0,0 +1,108 @@
+/*
+    rp_wavecache.h - Classification cache for the GB wave RAM contents
+    Header only, without Arduino dependencies, so that host tools can use it
+
+    Games switch between a few wave patterns, so the result of
+    rp_gbapu::analyzeWaveform() is kept for the last WAVECACHE_SIZE
+    patterns. Entries are found by a 64-bit hash of the 16 bytes and
+    verified against the bytes themselves, so a hash collision is a miss,
+    never a wrong wave type. The least recently used entry is replaced.
+*/
+
+#ifndef rp_wavecache_h
+#define rp_wavecache_h
+
+#include <stdint.h>
+#include <string.h>
+
+#include "rp_gbapu.h"
+
+#define WAVECACHE_SIZE   8
+#define WAVECACHE_BYTES  16   // Wave RAM, 32 4-bit samples
+
+struct wavecache_entry {
+    uint64_t hash;
+    uint8_t wave[WAVECACHE_BYTES];
+    uint32_t used;  // Use counter value at the last hit, 0=empty
+    WaveType type;
+};
+
+// Mixes both halves of the wave RAM with 64-bit multiplies (2 per pattern)
+static inline uint64_t wavecacheHash(const uint8_t* wave) {
+    uint64_t lo, hi;
+    memcpy(&lo, wave, sizeof(lo));
+    memcpy(&hi, wave + 8, sizeof(hi));
+    uint64_t h = (lo ^ 0x9E3779B97F4A7C15ull) * 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 31;
+    h = (h ^ hi) * 0x94D049BB133111EBull;
+    return h ^ (h >> 29);
+}
+
+class rp_wavecache {
+public:
+    rp_wavecache() {
+        clear();
+        m_hits = 0;
+        m_misses = 0;
+    }
+
+    void clear() {
+        memset(m_entries, 0, sizeof(m_entries));
+        m_used = 0;
+    }
+
+    // Entry holding wave, or -1
+    int8_t find(const uint8_t* wave, uint64_t hash) {
+        for (uint8_t i = 0; i < WAVECACHE_SIZE; i++) {
+            wavecache_entry& e = m_entries[i];
+            if (e.used && e.hash == hash && memcmp(e.wave, wave, WAVECACHE_BYTES) == 0) {
+                e.used = ++m_used;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Into an empty entry, else over the least recently used one
+    void insert(const uint8_t* wave, uint64_t hash, WaveType type) {
+        uint8_t oldest = 0;
+        for (uint8_t i = 0; i < WAVECACHE_SIZE; i++) {
+            if (m_entries[i].used < m_entries[oldest].used) {
+                oldest = i;
+            }
+        }
+        wavecache_entry& e = m_entries[oldest];
+        e.hash = hash;
+        memcpy(e.wave, wave, WAVECACHE_BYTES);
+        e.used = ++m_used;
+        e.type = type;
+    }
+
+    // Wave type of the pattern, from the cache or from analyze()
+    template <typename F>
+    WaveType classify(const uint8_t* wave, F analyze) {
+        uint64_t hash = wavecacheHash(wave);
+        int8_t i = find(wave, hash);
+        if (i >= 0) {
+            m_hits++;
+            return m_entries[i].type;
+        }
+        m_misses++;
+        WaveType type = analyze();
+        insert(wave, hash, type);
+        return type;
+    }
+
+    const wavecache_entry& at(uint8_t i) const { return m_entries[i]; }
+
+    uint32_t getHits() const { return m_hits; }
+    uint32_t getMisses() const { return m_misses; }
+
+private:
+    wavecache_entry m_entries[WAVECACHE_SIZE];
+    uint32_t m_used;    // Use counter, for the LRU order
+    uint32_t m_hits;
+    uint32_t m_misses;
+};
+
+#endif
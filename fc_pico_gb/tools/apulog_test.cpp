@@ -0,0 +1,216 @@
+/*
+    apulog_test.cpp - Host test for the GB APU write log (rp_apulog.h)
+
+    Feeds scripted register write sequences, as Peanut-GB passes them to
+    audio_write() with the cycle counter, and checks the channel events
+    that scan() finds in them: triggers, pitch changes, stops, notes
+    shorter than a frame, writes while the APU is off, log overflow and
+    cycle counter wrap-around.
+
+    Build: g++ -O2 -I.. apulog_test.cpp -o apulog_test
+    Usage: ./apulog_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rp_apulog.h"
+#include "check.h"
+
+static uint8_t regs[APULOG_REGS];
+static rp_apulog apulog;
+static apulog_event ev[APULOG_SIZE];
+
+// A frame starting at cycle start, with the APU on and all channels quiet
+static void begin(uint32_t start) {
+    memset(regs, 0, sizeof(regs));
+    regs[NR52] = 0x80;
+    apulog.beginFrame(start, regs, true);
+}
+
+static void write(uint32_t cycle, uint8_t reg, uint8_t val) {
+    apulog.add(cycle, reg, val);
+}
+
+static bool isEvent(const apulog_event& e, uint32_t cycle, uint8_t ch, uint8_t type) {
+    return e.cycle == cycle && e.ch == ch && e.type == type;
+}
+
+// Pulse 1 note, stopped by its DAC 4000 cycles later (a drum hit)
+static void testShortNote() {
+    begin(1000000);
+    write(1001000, NR12, 0xF1);
+    write(1001004, NR13, 0xD6);
+    write(1001008, NR14, 0x86);
+    write(1005000, NR12, 0x00);
+
+    uint8_t n = apulog.scan(ev, APULOG_SIZE);
+    CHECK(n == 3);
+    CHECK(isEvent(ev[0], 1004, 0, APULOG_EV_PITCH) && ev[0].freq == 0x0D6);
+    CHECK(isEvent(ev[1], 1008, 0, APULOG_EV_TRIGGER));
+    CHECK(ev[1].freq == 0x6D6 && ev[1].volume == 15);
+    CHECK(isEvent(ev[2], 5000, 0, APULOG_EV_STOP));
+
+    apulog_event trig;
+    CHECK(apulogShortNote(ev, n, 0, &trig));
+    CHECK(trig.cycle == 1008 && trig.freq == 0x6D6);
+    CHECK(!apulogShortNote(ev, n, 1, &trig));
+}
+
+// A note that is still playing at the end of the frame is not short, even
+// if an earlier one was stopped
+static void testRetrigger() {
+    begin(0);
+    write(100, NR22, 0xA0);
+    write(104, NR24, 0x87);
+    write(8000, NR22, 0x00);
+    write(9000, NR22, 0x90);
+    write(9004, NR24, 0x87);
+
+    uint8_t n = apulog.scan(ev, APULOG_SIZE);
+    CHECK(n == 3);
+    CHECK(isEvent(ev[0], 104, 1, APULOG_EV_TRIGGER) && ev[0].volume == 10);
+    CHECK(isEvent(ev[1], 8000, 1, APULOG_EV_STOP));
+    CHECK(isEvent(ev[2], 9004, 1, APULOG_EV_TRIGGER) && ev[2].volume == 9);
+
+    apulog_event trig;
+    CHECK(!apulogShortNote(ev, n, 1, &trig));
+}
+
+// Arpeggio on pulse 2: three pitches within the frame, no retrigger.
+// Writing the same value again is not a change.
+static void testArpeggio() {
+    begin(0);
+    write(10, NR22, 0xF0);
+    write(20, NR23, 0x00);
+    write(24, NR24, 0x87);
+    write(20000, NR23, 0x40);
+    write(40000, NR23, 0x80);
+    write(40004, NR24, 0x07);
+    write(50000, NR23, 0x80);
+    write(60000, NR24, 0x06);
+
+    uint8_t n = apulog.scan(ev, APULOG_SIZE);
+    CHECK(n == 4);
+    CHECK(isEvent(ev[0], 24, 1, APULOG_EV_TRIGGER) && ev[0].freq == 0x700);
+    CHECK(isEvent(ev[1], 20000, 1, APULOG_EV_PITCH) && ev[1].freq == 0x740);
+    CHECK(isEvent(ev[2], 40000, 1, APULOG_EV_PITCH) && ev[2].freq == 0x780);
+    CHECK(isEvent(ev[3], 60000, 1, APULOG_EV_PITCH) && ev[3].freq == 0x680);
+}
+
+// Noise drum roll: the same drum retriggered 4 times in a frame
+static void testDrumRoll() {
+    begin(0);
+    write(0, NR42, 0xC1);
+    write(4, NR43, 0x21);
+    for (uint32_t i = 0; i < 4; i++) {
+        write(100 + i * 16000, NR44, 0x80);
+    }
+
+    uint8_t n = apulog.scan(ev, APULOG_SIZE);
+    CHECK(n == 5);
+    CHECK(isEvent(ev[0], 4, 3, APULOG_EV_PITCH) && ev[0].freq == 0x21);
+    for (uint8_t i = 0; i < 4; i++) {
+        CHECK(isEvent(ev[1 + i], 100 + i * 16000, 3, APULOG_EV_TRIGGER));
+        CHECK(ev[1 + i].volume == 12 && ev[1 + i].freq == 0x21);
+    }
+}
+
+// Wave: volume level at the trigger, a stop by volume 0 and by the DAC
+static void testWave() {
+    begin(0);
+    write(0, NR30, 0x80);
+    write(4, NR32, 0x40);
+    write(8, NR33, 0x00);
+    write(12, NR34, 0x87);
+    write(3000, NR32, 0x00);
+    write(6000, NR30, 0x00);
+
+    uint8_t n = apulog.scan(ev, APULOG_SIZE);
+    CHECK(n == 3);
+    CHECK(isEvent(ev[0], 12, 2, APULOG_EV_TRIGGER));
+    CHECK(ev[0].volume == 2 && ev[0].freq == 0x700);
+    CHECK(isEvent(ev[1], 3000, 2, APULOG_EV_STOP));
+    CHECK(isEvent(ev[2], 6000, 2, APULOG_EV_STOP));
+}
+
+// NR52 off stops every channel and clears the registers. Writes while it is
+// off are ignored, as rp_gbapu::write() does, except the wave RAM.
+static void testApuOff() {
+    begin(0);
+    write(0, NR12, 0xF0);
+    write(4, NR52, 0x00);
+    write(8, NR14, 0x87);
+    write(12, WAVE_RAM_START, 0x12);
+    write(16, NR52, 0x80);
+    write(20, NR14, 0x87);
+
+    uint8_t n = apulog.scan(ev, APULOG_SIZE);
+    CHECK(n == 5);
+    for (uint8_t ch = 0; ch < 4; ch++) {
+        CHECK(isEvent(ev[ch], 4, ch, APULOG_EV_STOP));
+    }
+    // NR12 was cleared: the note starts at volume 0
+    CHECK(isEvent(ev[4], 20, 0, APULOG_EV_TRIGGER) && ev[4].volume == 0);
+
+    // A frame that starts with the APU off
+    memset(regs, 0, sizeof(regs));
+    apulog.beginFrame(0, regs, false);
+    write(0, NR44, 0x80);
+    CHECK(apulog.scan(ev, APULOG_SIZE) == 0);
+}
+
+// The registers at the start of the frame are used for the first events
+static void testStartRegs() {
+    memset(regs, 0, sizeof(regs));
+    regs[NR52] = 0x80;
+    regs[NR12] = 0x70;
+    regs[NR13] = 0x34;
+    regs[NR14] = 0x05;
+    apulog.beginFrame(0, regs, true);
+    write(50, NR14, 0x85);
+    write(60, NR14, 0x06);
+
+    uint8_t n = apulog.scan(ev, APULOG_SIZE);
+    CHECK(n == 2);
+    CHECK(isEvent(ev[0], 50, 0, APULOG_EV_TRIGGER));
+    CHECK(ev[0].freq == 0x534 && ev[0].volume == 7);
+    CHECK(isEvent(ev[1], 60, 0, APULOG_EV_PITCH) && ev[1].freq == 0x634);
+}
+
+// More writes than the log holds are counted, and the event output stops
+// at max. The frame may start just before the cycle counter wraps.
+static void testLimits() {
+    uint32_t lost = apulog.getLost();
+    begin(0xFFFFFF00u);
+    write(0xFFFFFF80u, NR22, 0xF0);
+    write(0x00000100u, NR24, 0x80);
+    CHECK(apulog.at(0).cycle == 0x80);
+    CHECK(apulog.at(1).cycle == 0x200);
+
+    for (uint32_t i = 0; i < APULOG_SIZE; i++) {
+        write(0x200 + i * 8, NR44, 0x80);
+    }
+    CHECK(apulog.count() == APULOG_SIZE);
+    CHECK(apulog.getLost() == lost + 2);
+
+    uint8_t n = apulog.scan(ev, 10);
+    CHECK(n == 10);
+    CHECK(isEvent(ev[0], 0x200, 1, APULOG_EV_TRIGGER));
+    CHECK(isEvent(ev[1], 0x300, 3, APULOG_EV_TRIGGER));
+    CHECK(isEvent(ev[9], 0x300 + 8 * 8, 3, APULOG_EV_TRIGGER));
+}
+
+int main() {
+    testShortNote();
+    testRetrigger();
+    testArpeggio();
+    testDrumRoll();
+    testWave();
+    testApuOff();
+    testStartRegs();
+    testLimits();
+
+    return checkResult();
+}
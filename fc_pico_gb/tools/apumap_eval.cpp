@@ -0,0 +1,693 @@
+/*
+    apumap_eval.cpp - Offline quality and cost check of the GB to NES APU mapping
+
+    Runs a ROM through Peanut-GB with rp_gbapu hooked in as on the Pico,
+    and with minigb_apu (the reference APU of the Peanut-GB SDL2 example)
+    fed the same register writes. The NES register writes that rp_gbapu
+    makes go through the link encoding of rp_system::sendApuCommands()
+    (extended command area, rp_apupkt.h) and are applied to a software NES
+    APU, as the FC would, one packet per GB frame.
+
+    Writes <prefix>_nes.wav (the NES APU), <prefix>_gb.wav (minigb_apu)
+    and <prefix>.csv (one line per frame), and prints:
+    - mapping CPU time per frame: rp_gbapu's part of the APU writes, the
+      frame sequencer catch-up and updatePulsePriority()
+    - command bytes per frame sent over the link
+    - pitch error: per frame and channel, cents between the GB note
+      (minigb_apu) and the NES note, and frames where only one of them is
+      heard (pulse 1/2 to pulse 1/2, wave to triangle)
+    - onset error: GB note triggers against the next note started on the
+      NES channel within ONSET_WINDOW frames, and NES notes started
+      without a GB trigger (phase register writes, channels coming back)
+
+    The link model follows rp_system, including the phase register write
+    flags, which are reset after each packet.
+
+    Build: gcc -O2 -c -DMINIGB_APU_AUDIO_FORMAT_S16SYS ../peanut-gb/examples/sdl2/minigb_apu/minigb_apu.c
+           g++ -O2 -I.. apumap_eval.cpp ../rp_gbapu.cpp minigb_apu.o -o apumap_eval
+    Usage: ./apumap_eval rom.gb [frames] [prefix]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "rp_gbapu.h"
+#include "rp_gbfreq.h"
+#include "rp_apupkt.h"
+
+#define MINIGB_APU_AUDIO_FORMAT_S16SYS
+extern "C" {
+#include "peanut-gb/examples/sdl2/minigb_apu/minigb_apu.h"
+}
+
+// Peanut-GB calls these, so that both APUs get the writes
+static uint8_t evalAudioRead(uint16_t addr);
+static void evalAudioWrite(uint16_t addr, uint8_t val, uint32_t cycles);
+#define audio_read evalAudioRead
+#define audio_write evalAudioWrite
+#define ENABLE_SOUND 1
+#define PEANUT_GB_AUDIO_WRITE_CYCLES 1
+#define ENABLE_LCD 0
+#include "peanut-gb/peanut_gb.h"
+#undef audio_read
+#undef audio_write
+
+#define FRAME_CYCLES        70224
+#define FRAME_RATE          (4194304.0 / FRAME_CYCLES)
+#define NES_CPU_CLOCK       1789773.0
+#define APU_REFRESH_FRAMES  60   // rp_system::APU_REFRESH_FRAMES
+#define ONSET_WINDOW        4    // Frames a NES onset may be late
+#define PITCH_OFF_CENTS     50   // A frame this far off counts as a wrong note
+
+extern rp_gbapu gbapu;
+
+//=================================================
+//      NES APU (NTSC, without DMC)
+//=================================================
+
+static const uint8_t NES_LENGTH_TABLE[32] = {
+    10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+    12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+static const uint8_t NES_DUTY[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1},
+};
+
+struct nes_env {
+    bool start;
+    uint8_t divider;
+    uint8_t decay;
+};
+
+struct nes_apu {
+    uint8_t reg[APUPKT_REGS];
+    uint8_t length[4];
+    nes_env env[3];       // Pulse 1, pulse 2, noise
+    double phase[3];      // Timer position: pulse 0-8, triangle 0-32
+    double noise_clock;
+    uint16_t lfsr;
+    uint8_t linear;
+    bool linear_reload;
+    double frame_clock;   // CPU cycles to the next quarter frame
+    bool half;
+    double dc_in, dc_out;
+};
+
+static void nesInit(nes_apu* a) {
+    memset(a, 0, sizeof(*a));
+    a->lfsr = 1;
+    a->frame_clock = NES_CPU_CLOCK / 240;
+}
+
+static uint16_t nesPeriod(const nes_apu* a, uint8_t ch) {
+    return a->reg[ch * 4 + 2] | ((a->reg[ch * 4 + 3] & 0x07) << 8);
+}
+
+static bool nesEnabled(const nes_apu* a, uint8_t ch) {
+    return (a->reg[0x15] >> ch) & 1;
+}
+
+static uint8_t nesVolume(const nes_apu* a, uint8_t ch) {
+    uint8_t r = a->reg[ch * 4];
+    uint8_t e = (ch == 3) ? 2 : ch;
+    return (r & 0x10) ? (r & 0x0F) : a->env[e].decay;
+}
+
+// Heard at the end of the frame, and at what frequency
+static bool nesSounding(const nes_apu* a, uint8_t ch, double* hz) {
+    if (!nesEnabled(a, ch) || a->length[ch] == 0) {
+        return false;
+    }
+    uint16_t t = nesPeriod(a, ch);
+    switch (ch) {
+        case 0: case 1:
+            *hz = NES_CPU_CLOCK / (16.0 * (t + 1));
+            return t >= 8 && nesVolume(a, ch) > 0;
+        case 2:
+            *hz = NES_CPU_CLOCK / (32.0 * (t + 1));
+            return t >= 2 && a->linear > 0;
+        default:
+            *hz = 0;
+            return nesVolume(a, 3) > 0;
+    }
+}
+
+// A register write as the FC makes it. Returns true if it restarts a note.
+static bool nesWrite(nes_apu* a, uint8_t reg, uint8_t val) {
+    a->reg[reg] = val;
+    uint8_t ch = reg >> 2;
+    switch (reg) {
+        case 0x03: case 0x07: case 0x0B: case 0x0F:
+            if (nesEnabled(a, ch)) {
+                a->length[ch] = NES_LENGTH_TABLE[val >> 3];
+            }
+            if (ch < 2) {
+                a->phase[ch] = 0;
+                a->env[ch].start = true;
+            } else if (ch == 2) {
+                a->linear_reload = true;
+            } else {
+                a->env[2].start = true;
+            }
+            return true;
+        case 0x15:
+            for (uint8_t i = 0; i < 4; i++) {
+                if (!((val >> i) & 1)) {
+                    a->length[i] = 0;
+                }
+            }
+            break;
+    }
+    return false;
+}
+
+static void nesQuarterFrame(nes_apu* a) {
+    static const uint8_t env_reg[3] = {0x00, 0x04, 0x0C};
+    for (uint8_t e = 0; e < 3; e++) {
+        nes_env& v = a->env[e];
+        uint8_t r = a->reg[env_reg[e]];
+        if (v.start) {
+            v.start = false;
+            v.decay = 15;
+            v.divider = r & 0x0F;
+        } else if (v.divider == 0) {
+            v.divider = r & 0x0F;
+            if (v.decay > 0) {
+                v.decay--;
+            } else if (r & 0x20) {
+                v.decay = 15;
+            }
+        } else {
+            v.divider--;
+        }
+    }
+
+    if (a->linear_reload) {
+        a->linear = a->reg[0x08] & 0x7F;
+    } else if (a->linear > 0) {
+        a->linear--;
+    }
+    if (!(a->reg[0x08] & 0x80)) {
+        a->linear_reload = false;
+    }
+
+    a->half = !a->half;
+    if (a->half) {
+        static const uint8_t halt_reg[4] = {0x00, 0x04, 0x08, 0x0C};
+        static const uint8_t halt_bit[4] = {0x20, 0x20, 0x80, 0x20};
+        for (uint8_t ch = 0; ch < 4; ch++) {
+            if (a->length[ch] > 0 && !(a->reg[halt_reg[ch]] & halt_bit[ch])) {
+                a->length[ch]--;
+            }
+        }
+    }
+}
+
+static int16_t nesSample(nes_apu* a, double cycles) {
+    a->frame_clock -= cycles;
+    while (a->frame_clock <= 0) {
+        nesQuarterFrame(a);
+        a->frame_clock += NES_CPU_CLOCK / 240;
+    }
+
+    double pulse = 0;
+    for (uint8_t ch = 0; ch < 2; ch++) {
+        uint16_t t = nesPeriod(a, ch);
+        a->phase[ch] = fmod(a->phase[ch] + cycles / (2.0 * (t + 1)), 8.0);
+        if (nesEnabled(a, ch) && a->length[ch] > 0 && t >= 8) {
+            uint8_t duty = a->reg[ch * 4] >> 6;
+            pulse += NES_DUTY[duty][(int)a->phase[ch]] * nesVolume(a, ch);
+        }
+    }
+
+    // The triangle holds its output when it is stopped
+    uint16_t t = nesPeriod(a, 2);
+    if (nesEnabled(a, 2) && a->length[2] > 0 && a->linear > 0 && t >= 2) {
+        a->phase[2] = fmod(a->phase[2] + cycles / (t + 1), 32.0);
+    }
+    int step = (int)a->phase[2];
+    double triangle = (step < 16) ? 15 - step : step - 16;
+
+    a->noise_clock -= cycles;
+    while (a->noise_clock <= 0) {
+        uint8_t tap = (a->reg[0x0E] & 0x80) ? 6 : 1;
+        uint16_t bit = (a->lfsr ^ (a->lfsr >> tap)) & 1;
+        a->lfsr = (a->lfsr >> 1) | (bit << 14);
+        a->noise_clock += NES_NOISE_PERIODS[a->reg[0x0E] & 0x0F];
+    }
+    double noise = 0;
+    if (nesEnabled(a, 3) && a->length[3] > 0 && !(a->lfsr & 1)) {
+        noise = nesVolume(a, 3);
+    }
+
+    // Non-linear mixer, then a DC blocker
+    double out = 0;
+    if (pulse > 0) {
+        out += 95.88 / (8128.0 / pulse + 100);
+    }
+    double tnd = triangle / 8227 + noise / 12241;
+    if (tnd > 0) {
+        out += 159.79 / (1 / tnd + 100);
+    }
+    double y = out - a->dc_in + 0.995 * a->dc_out;
+    a->dc_in = out;
+    a->dc_out = y;
+    double s = y * 40000;
+    return (int16_t)((s > 32767) ? 32767 : (s < -32768) ? -32768 : s);
+}
+
+//=================================================
+//      Link: rp_system::queueApuWrite() / sendApuCommands()
+//=================================================
+
+struct link_state {
+    uint8_t latest[APUPKT_REGS];  // m_apuRegLatest
+    uint8_t prev[APUPKT_REGS];    // m_apuRegPrev
+    uint8_t sent[APUPKT_REGS];    // m_apuRegSent
+    uint8_t write_mask;           // m_apuWriteMask
+    uint8_t write_mask_prev;      // m_apuWriteMaskPrev
+    uint8_t refresh;              // m_apuRefresh
+};
+
+static link_state fc_link;
+
+// rp_system::resetApuState()
+static void linkInit() {
+    memset(fc_link.latest, 0, sizeof(fc_link.latest));
+    memset(fc_link.prev, 0xFF, sizeof(fc_link.prev));
+    memset(fc_link.sent, 0, sizeof(fc_link.sent));
+    fc_link.write_mask = 0x0F;
+    fc_link.write_mask_prev = 0x00;
+    fc_link.refresh = 0;
+}
+
+void gbapuHostWrite(uint8_t reg, uint8_t value) {
+    if (reg >= APUPKT_REGS) return;
+    fc_link.write_mask |= apuPktWriteFlag(reg);
+    fc_link.latest[reg] = value;
+}
+
+// The packet of a frame, 0 bytes in a quiet frame. Returns its length
+// with the record header byte, as rp_system counts m_apu_ext_bytes.
+static uint8_t linkSend(uint8_t* pkt, bool* full) {
+    uint8_t writeMask = apuPktWriteMask(fc_link.latest, fc_link.prev,
+                                        fc_link.write_mask, fc_link.write_mask_prev);
+    memcpy(fc_link.prev, fc_link.latest, sizeof(fc_link.prev));
+    // rp_system::resetApuWriteFlags(), called by update() after the packet
+    fc_link.write_mask_prev = fc_link.write_mask;
+    fc_link.write_mask = 0;
+
+    uint8_t regs[APUPKT_REGS];
+    apuPktRegs(regs, fc_link.latest);
+    uint8_t len = APUPKT_FULL_LEN;
+    *full = true;
+    if (fc_link.refresh != 0) {
+        len = apuPktDelta(pkt, regs, fc_link.sent, writeMask);
+        if (len == 0) {
+            return 0;
+        }
+    }
+    if (len >= APUPKT_FULL_LEN) {
+        apuPktFull(pkt, regs, writeMask);
+        memcpy(fc_link.sent, regs, sizeof(fc_link.sent));
+        fc_link.refresh = APU_REFRESH_FRAMES;
+        len = APUPKT_FULL_LEN;
+    } else {
+        *full = false;
+        fc_link.refresh--;
+    }
+    return 1 + len;
+}
+
+//=================================================
+//      Peanut-GB front-end
+//=================================================
+
+struct gb_priv {
+    uint8_t* rom;
+    size_t rom_size;
+    uint8_t* cart_ram;
+};
+
+static uint8_t gbRomRead(struct gb_s* gb, const uint_fast32_t addr) {
+    const gb_priv* p = (const gb_priv*)gb->direct.priv;
+    return (addr < p->rom_size) ? p->rom[addr] : 0xFF;
+}
+
+static uint8_t gbCartRamRead(struct gb_s* gb, const uint_fast32_t addr) {
+    return ((gb_priv*)gb->direct.priv)->cart_ram[addr];
+}
+
+static void gbCartRamWrite(struct gb_s* gb, const uint_fast32_t addr, const uint8_t val) {
+    ((gb_priv*)gb->direct.priv)->cart_ram[addr] = val;
+}
+
+static void gbError(struct gb_s* gb, const enum gb_error_e err, const uint16_t addr) {
+    (void)gb;
+    fprintf(stderr, "GB error %d at %04X\n", (int)err, addr);
+    exit(1);
+}
+
+//=================================================
+//      Both APUs
+//=================================================
+
+static minigb_apu_ctx mini;
+static uint8_t gb_regs[GB_APU_REG_SIZE];  // Latest GB APU register writes
+static bool gb_triggered[4];              // Since the APU was powered on
+static double map_ns;                     // rp_gbapu time in this frame
+static uint32_t frame_start;
+static uint32_t frame_no;
+
+struct onset {
+    double frame;  // In frames, with the position in the frame
+    uint8_t ch;
+    bool matched;
+};
+
+static std::vector<onset> gb_onsets, nes_onsets;
+
+static uint8_t evalAudioRead(uint16_t addr) {
+    return gbapu.read(addr);
+}
+
+// A trigger with the DAC on starts a note
+static bool gbTriggerHeard(uint8_t offset, uint8_t val, uint8_t* ch) {
+    if (!(val & 0x80)) return false;
+    switch (offset) {
+        case NR14: *ch = 0; break;
+        case NR24: *ch = 1; break;
+        case NR34: *ch = 2; break;
+        case NR44: *ch = 3; break;
+        default: return false;
+    }
+    gb_triggered[*ch] = true;
+    switch (*ch) {
+        case 0: return (gb_regs[NR12] & 0xF8) != 0;
+        case 1: return (gb_regs[NR22] & 0xF8) != 0;
+        case 2: return (gb_regs[NR30] & 0x80) != 0 && (gb_regs[NR32] & 0x60) != 0;
+        default: return (gb_regs[NR42] & 0xF8) != 0;
+    }
+}
+
+static void evalAudioWrite(uint16_t addr, uint8_t val, uint32_t cycles) {
+    auto t0 = std::chrono::steady_clock::now();
+    audio_write(addr, val, cycles);
+    auto t1 = std::chrono::steady_clock::now();
+    map_ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+    minigb_apu_audio_write(&mini, addr, val);
+
+    if (addr < GB_APU_REG_START || addr > GB_APU_REG_END) return;
+    uint8_t offset = addr - GB_APU_REG_START;
+    gb_regs[offset] = val;
+    if (offset == NR52 && !(val & 0x80)) {
+        memset(gb_triggered, 0, sizeof(gb_triggered));
+    }
+    uint8_t ch;
+    if (gbTriggerHeard(offset, val, &ch)) {
+        onset o = { frame_no + (double)(cycles - frame_start) / FRAME_CYCLES, ch, false };
+        gb_onsets.push_back(o);
+    }
+}
+
+// minigb_apu channel heard at the end of the frame, and its frequency.
+// minigb_apu enables a channel with its DAC, the GB only at a trigger.
+static bool gbSounding(uint8_t ch, double* hz) {
+    const chan& c = mini.chans[ch];
+    if (!gb_triggered[ch] || !c.enabled || !c.powered || c.volume == 0) {
+        return false;
+    }
+    *hz = (ch == 2) ? 65536.0 / (2048 - c.freq) : 131072.0 / (2048 - c.freq);
+    return true;
+}
+
+//=================================================
+//      Output
+//=================================================
+
+static void putLe(FILE* f, uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        fputc((v >> (i * 8)) & 0xFF, f);
+    }
+}
+
+static void writeWav(const char* name, const std::vector<int16_t>& pcm, uint16_t channels) {
+    FILE* f = fopen(name, "wb");
+    if (!f) {
+        perror(name);
+        return;
+    }
+    uint32_t bytes = (uint32_t)(pcm.size() * 2);
+    fwrite("RIFF", 1, 4, f);
+    putLe(f, 36 + bytes, 4);
+    fwrite("WAVEfmt ", 1, 8, f);
+    putLe(f, 16, 4);
+    putLe(f, 1, 2);  // PCM
+    putLe(f, channels, 2);
+    putLe(f, AUDIO_SAMPLE_RATE, 4);
+    putLe(f, AUDIO_SAMPLE_RATE * channels * 2, 4);
+    putLe(f, channels * 2, 2);
+    putLe(f, 16, 2);
+    fwrite("data", 1, 4, f);
+    putLe(f, bytes, 4);
+    for (int16_t s : pcm) {
+        putLe(f, (uint16_t)s, 2);
+    }
+    fclose(f);
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+// Each GB onset takes the first free NES onset on its channel that is not
+// before it (onsets are in time order)
+static void matchOnsets(uint32_t* matched, double* err_sum, double* err_max) {
+    for (onset& g : gb_onsets) {
+        for (onset& n : nes_onsets) {
+            if (n.ch != g.ch || n.matched || n.frame < g.frame) continue;
+            if (n.frame - g.frame > ONSET_WINDOW) break;
+            n.matched = true;
+            g.matched = true;
+            matched[g.ch]++;
+            double ms = (n.frame - g.frame) * 1000 / FRAME_RATE;
+            *err_sum += ms;
+            *err_max = std::max(*err_max, ms);
+            break;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s rom.gb [frames] [prefix]\n", argv[0]);
+        return 1;
+    }
+    uint32_t frames = (argc > 2) ? (uint32_t)atoi(argv[2]) : 3600;
+    const char* prefix = (argc > 3) ? argv[3] : "apumap";
+
+    FILE* rf = fopen(argv[1], "rb");
+    if (!rf) {
+        perror(argv[1]);
+        return 1;
+    }
+    gb_priv priv;
+    fseek(rf, 0, SEEK_END);
+    priv.rom_size = ftell(rf);
+    fseek(rf, 0, SEEK_SET);
+    priv.rom = (uint8_t*)malloc(priv.rom_size);
+    if (fread(priv.rom, 1, priv.rom_size, rf) != priv.rom_size) {
+        perror(argv[1]);
+        return 1;
+    }
+    fclose(rf);
+
+    static struct gb_s gb;
+    priv.cart_ram = NULL;
+    enum gb_init_error_e ret = gb_init(&gb, gbRomRead, gbCartRamRead, gbCartRamWrite, gbError, &priv);
+    if (ret != GB_INIT_NO_ERROR) {
+        fprintf(stderr, "gb_init error %d\n", (int)ret);
+        return 1;
+    }
+    gb_init_rom_ptr(&gb, priv.rom, priv.rom_size);
+    priv.cart_ram = (uint8_t*)calloc(1, gb_get_save_size(&gb) + 1);
+
+    minigb_apu_audio_init(&mini);
+    gbapu.init();
+    linkInit();
+    static nes_apu nes;
+    nesInit(&nes);
+
+    char name[256];
+    snprintf(name, sizeof(name), "%s.csv", prefix);
+    FILE* csv = fopen(name, "w");
+    if (!csv) {
+        perror(name);
+        return 1;
+    }
+    fprintf(csv, "frame,map_ns,apu_writes,nes_writes,link_bytes,full,cents_p1,cents_p2,cents_tri\n");
+
+    std::vector<int16_t> pcm_gb, pcm_nes;
+    std::vector<double> map_times;
+    static audio_sample_t stream[AUDIO_SAMPLES_TOTAL];
+    double cycles_per_sample = NES_CPU_CLOCK / AUDIO_SAMPLE_RATE;
+    uint8_t apu_tick = 0;
+    uint64_t link_bytes = 0;
+    uint32_t link_max = 0, packets_full = 0, packets_delta = 0, quiet = 0;
+    uint32_t voiced[3] = {0}, wrong_note[3] = {0}, only_gb[3] = {0}, only_nes[3] = {0};
+    double cents_sum[3] = {0};
+    bool nes_heard[4] = {false};
+
+    for (frame_no = 0; frame_no < frames; frame_no++) {
+        frame_start = gb.counter.cycles;
+        map_ns = 0;
+        size_t onsets_before = gb_onsets.size();
+
+        // As rp_gbemu::runFrame()
+        uint16_t div = (uint16_t)((gb.hram_io[IO_DIV] << 8) + gb.counter.div_count +
+                                  (gb.counter.cycles - gb.counter.sync_cycles));
+        auto t0 = std::chrono::steady_clock::now();
+        gbapu.beginFrame(gb.counter.cycles, div);
+        auto t1 = std::chrono::steady_clock::now();
+        gb_run_frame(&gb);
+        auto t2 = std::chrono::steady_clock::now();
+        gbapu.clockTo(gb.counter.cycles);
+        gbapu.updatePulsePriority(apu_tick);
+        apu_tick = (apu_tick + 1) % 3;
+        auto t3 = std::chrono::steady_clock::now();
+        map_ns += std::chrono::duration<double, std::nano>((t1 - t0) + (t3 - t2)).count();
+        map_times.push_back(map_ns);
+
+        // The frame on both APUs. The NES plays the registers of the packet
+        // sent after the previous frame.
+        minigb_apu_audio_callback(&mini, stream);
+        for (unsigned i = 0; i < AUDIO_SAMPLES_TOTAL; i++) {
+            pcm_gb.push_back(stream[i]);
+        }
+        for (unsigned i = 0; i < AUDIO_SAMPLES; i++) {
+            pcm_nes.push_back(nesSample(&nes, cycles_per_sample));
+        }
+
+        // Packet of this frame, applied by the FC at its end
+        uint8_t pkt[APUPKT_FULL_LEN + APUPKT_DELTA_MAX];
+        bool full = false;
+        uint8_t len = linkSend(pkt, &full);
+        uint8_t fc[APUPKT_REGS];
+        uint32_t writes[APUPKT_REGS] = {0};
+        memcpy(fc, nes.reg, sizeof(fc));
+        if (len == 0) {
+            quiet++;
+        } else if (full) {
+            packets_full++;
+            apuPktApplyFull(pkt, fc, writes);
+        } else {
+            packets_delta++;
+            apuPktApplyDelta(pkt, fc, writes);
+        }
+        link_bytes += len;
+        link_max = std::max<uint32_t>(link_max, len);
+
+        // In the order the 6502 writes them: $4015 last
+        bool restart[4] = {false};
+        uint32_t nes_writes = 0;
+        for (uint8_t r = 0; r < APUPKT_REGS; r++) {
+            if (writes[r] && r != 0x15) {
+                restart[r >> 2] |= nesWrite(&nes, r, fc[r]);
+                nes_writes++;
+            }
+        }
+        if (writes[0x15]) {
+            nesWrite(&nes, 0x15, fc[0x15]);
+            nes_writes++;
+        }
+        for (uint8_t ch = 0; ch < 4; ch++) {
+            double hz;
+            bool heard = nesSounding(&nes, ch, &hz);
+            if (heard && (restart[ch] || !nes_heard[ch])) {
+                onset o = { (double)frame_no + 1, ch, false };
+                nes_onsets.push_back(o);
+            }
+            nes_heard[ch] = heard;
+        }
+
+        // Notes at the end of the frame
+        double cents[3] = {0};
+        for (uint8_t ch = 0; ch < 3; ch++) {
+            double gb_hz = 0, nes_hz = 0;
+            bool g = gbSounding(ch, &gb_hz);
+            bool n = nesSounding(&nes, ch, &nes_hz);
+            if (g && n) {
+                cents[ch] = 1200 * log2(nes_hz / gb_hz);
+                voiced[ch]++;
+                cents_sum[ch] += fabs(cents[ch]);
+                if (fabs(cents[ch]) > PITCH_OFF_CENTS) wrong_note[ch]++;
+            } else if (g) {
+                only_gb[ch]++;
+            } else if (n) {
+                only_nes[ch]++;
+            }
+        }
+
+        fprintf(csv, "%u,%.0f,%u,%u,%u,%d,%.1f,%.1f,%.1f\n",
+                frame_no, map_ns, (unsigned)(gb_onsets.size() - onsets_before), nes_writes,
+                len, full ? 1 : 0, cents[0], cents[1], cents[2]);
+    }
+    fclose(csv);
+
+    snprintf(name, sizeof(name), "%s_nes.wav", prefix);
+    writeWav(name, pcm_nes, 1);
+    snprintf(name, sizeof(name), "%s_gb.wav", prefix);
+    writeWav(name, pcm_gb, 2);
+
+    uint32_t matched[4] = {0};
+    double err_sum = 0, err_max = 0;
+    matchOnsets(matched, &err_sum, &err_max);
+    uint32_t total_matched = matched[0] + matched[1] + matched[2] + matched[3];
+
+    char title[17];
+    printf("ROM: %s, %u frames (%.1f s)\n", gb_get_rom_name(&gb, title), frames, frames / FRAME_RATE);
+
+    double sum = 0, max = 0;
+    for (double t : map_times) {
+        sum += t;
+        max = std::max(max, t);
+    }
+    printf("Mapping CPU:  %.2f us/frame average, %.2f us p99, %.2f us max\n",
+           sum / frames / 1000, percentile(map_times, 0.99) / 1000, max / 1000);
+    printf("Link:         %.2f bytes/frame average, %u max; %u full, %u delta, %u quiet frames\n",
+           (double)link_bytes / frames, link_max, packets_full, packets_delta, quiet);
+
+    static const char* names[3] = {"Pulse 1", "Pulse 2", "Wave   "};
+    for (uint8_t ch = 0; ch < 3; ch++) {
+        uint32_t gb_frames = voiced[ch] + only_gb[ch];
+        printf("Pitch %s: %.1f cents average over %u frames, %u off by >%d cents; "
+               "%u of %u GB frames not heard, %u NES frames extra\n",
+               names[ch], voiced[ch] ? cents_sum[ch] / voiced[ch] : 0.0, voiced[ch],
+               wrong_note[ch], PITCH_OFF_CENTS, only_gb[ch], gb_frames, only_nes[ch]);
+    }
+
+    printf("Onsets:       %u of %u GB notes found on the NES (", total_matched, (unsigned)gb_onsets.size());
+    for (uint8_t ch = 0; ch < 4; ch++) {
+        uint32_t n = 0;
+        for (const onset& g : gb_onsets) n += (g.ch == ch);
+        printf("%s%u/%u", ch ? " " : "", matched[ch], n);
+    }
+    uint32_t extra = 0;
+    for (const onset& n : nes_onsets) extra += !n.matched;
+    printf("), %u extra\n", extra);
+    printf("Onset error:  %.1f ms late on average, %.1f ms max\n",
+           total_matched ? err_sum / total_matched : 0.0, err_max);
+    return 0;
+}
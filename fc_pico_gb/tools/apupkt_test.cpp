@@ -0,0 +1,175 @@
+/*
+    apupkt_test.cpp - Host round-trip test for the APU register packets
+
+    Feeds random register streams through rp_system::queueApuWrite() and
+    the encoder of rp_system::sendApuCommands() (rp_apupkt.h): the phase
+    register write flags, reset after each packet, a delta packet per
+    frame, a full block every APU_REFRESH_FRAMES packets and after a lost
+    frame. Some channels have a driver that writes the phase register
+    every frame, which must not restart the phase each time.
+    A model of the FC applies them, and after every frame it must hold the
+    same registers, with the same phase register writes, as an FC that is
+    sent the full block every frame. Also prints the bytes per frame.
+
+    Build: g++ -O2 -I.. apupkt_test.cpp -o apupkt_test
+    Usage: ./apupkt_test [frames] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rp_apupkt.h"
+
+#define APU_REFRESH_FRAMES 60  // rp_system::APU_REFRESH_FRAMES
+#define LOSS_RATE 500          // about 1 frame in LOSS_RATE is not read by the FC
+
+static uint32_t rnd_state;
+
+static uint32_t rnd() {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = (argc > 1) ? (uint32_t)atoi(argv[1]) : 1000000;
+    rnd_state = (argc > 2) ? (uint32_t)atoi(argv[2]) : 1;
+    if (rnd_state == 0) {
+        rnd_state = 1;
+    }
+
+    uint8_t latest[APUPKT_REGS];   // m_apuRegLatest
+    uint8_t prev[APUPKT_REGS];     // m_apuRegPrev
+    uint8_t sent[APUPKT_REGS];     // m_apuRegSent
+    uint8_t fc[APUPKT_REGS];       // FC fed the packets
+    uint8_t ref[APUPKT_REGS];      // FC fed the full block every frame
+    memset(latest, 0, sizeof(latest));
+    memset(prev, 0xFF, sizeof(prev));
+    memset(sent, 0, sizeof(sent));
+    memset(fc, 0, sizeof(fc));
+    memset(ref, 0, sizeof(ref));
+
+    uint8_t flags = 0x0F;          // m_apuWriteMask
+    uint8_t flags_prev = 0x00;     // m_apuWriteMaskPrev
+    uint8_t every_frame = 0;       // Channels whose driver rewrites the phase register
+    uint32_t phase_writes = 0;
+    uint8_t refresh = 0;
+    bool resync = false;
+    uint32_t errors = 0;
+    uint32_t lost = 0, full = 0, delta = 0, quiet = 0;
+    uint64_t bytes = 0;
+    uint32_t max_len = 0;
+
+    for (uint32_t f = 0; f < frames && errors < 10; f++) {
+        // The game, through rp_system::queueApuWrite(): most frames change
+        // a register or two, some a lot. A new song now and then changes
+        // which channels rewrite their phase register every frame.
+        if (f % 600 == 0) {
+            every_frame = (uint8_t)(rnd() & 0x0F);
+        }
+        uint32_t changes = rnd() % 8;
+        if (changes > 3) {
+            changes = (changes == 7) ? rnd() % 24 : 0;
+        }
+        for (uint32_t i = 0; i < changes; i++) {
+            uint8_t reg = (uint8_t)(rnd() % APUPKT_REGS);
+            latest[reg] = (uint8_t)rnd();
+            flags |= apuPktWriteFlag(reg);
+        }
+        flags |= every_frame;
+
+        uint8_t writeMask = apuPktWriteMask(latest, prev, flags, flags_prev);
+        memcpy(prev, latest, sizeof(prev));
+        flags_prev = flags;  // rp_system::resetApuWriteFlags()
+        flags = 0;
+        for (uint8_t ch = 0; ch < 4; ch++) {
+            phase_writes += (writeMask >> ch) & 1;
+        }
+
+        uint8_t regs[APUPKT_REGS];
+        apuPktRegs(regs, latest);
+
+        // rp_system::sendApuCommands(), extended area
+        if (resync) {
+            resync = false;
+            refresh = 0;
+        }
+        uint8_t pkt[APUPKT_DELTA_MAX];
+        uint8_t len = APUPKT_FULL_LEN;
+        if (refresh != 0) {
+            len = apuPktDelta(pkt, regs, sent, writeMask);
+        }
+        bool is_full = (len >= APUPKT_FULL_LEN);
+        if (is_full) {
+            apuPktFull(pkt, regs, writeMask);
+            memcpy(sent, regs, sizeof(sent));
+            refresh = APU_REFRESH_FRAMES;
+            len = APUPKT_FULL_LEN;
+        } else if (len != 0) {
+            refresh--;
+        }
+
+        uint8_t ref_pkt[APUPKT_FULL_LEN];
+        uint32_t ref_writes[APUPKT_REGS] = {0};
+        apuPktFull(ref_pkt, regs, writeMask);
+        apuPktApplyFull(ref_pkt, ref, ref_writes);
+
+        // rp_system::ppu_dma(): the FC misses a frame now and then
+        if (rnd() % LOSS_RATE == 0) {
+            lost++;
+            resync = true;
+            // A lost note start is not resent (that would reset the phase
+            // again later), so only the other registers are recovered
+            for (uint8_t reg = 0; reg < APUPKT_REGS; reg++) {
+                if (apuPktPhaseReg(reg)) {
+                    fc[reg] = ref[reg];
+                }
+            }
+            continue;
+        }
+
+        uint32_t writes[APUPKT_REGS] = {0};
+        if (is_full) {
+            full++;
+            apuPktApplyFull(pkt, fc, writes);
+        } else if (len != 0) {
+            delta++;
+            apuPktApplyDelta(pkt, fc, writes);
+        } else {
+            quiet++;
+        }
+        if (len != 0) {
+            bytes += 1 + len;  // record header
+        }
+        if (len > max_len) {
+            max_len = len;
+        }
+
+        for (uint8_t reg = 0; reg < APUPKT_REGS; reg++) {
+            if (!((APUPKT_REG_MASK >> reg) & 1)) {
+                continue;
+            }
+            if (fc[reg] != ref[reg]) {
+                printf("frame %u: $40%02X = %02X, expected %02X\n", f, reg, fc[reg], ref[reg]);
+                errors++;
+            }
+            if (apuPktPhaseReg(reg) && (writes[reg] != 0) != (ref_writes[reg] != 0)) {
+                printf("frame %u: $40%02X written %u times, expected %u\n",
+                       f, reg, writes[reg], ref_writes[reg]);
+                errors++;
+            }
+        }
+    }
+
+    uint32_t sent_frames = full + delta + quiet;
+    printf("%u frames: %u full, %u delta, %u without a packet, %u lost\n",
+           sent_frames + lost, full, delta, quiet, lost);
+    printf("%.2f bytes per frame (full block: %d), largest packet %u bytes\n",
+           sent_frames ? (double)bytes / sent_frames : 0.0, 1 + APUPKT_FULL_LEN, max_len);
+    printf("%.2f phase register writes per frame\n",
+           frames ? (double)phase_writes / frames : 0.0);
+    printf("%u errors\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+/*
+    apuseq_test.cpp - Host test of the GB APU frame sequencer (rp_gbapu)
+
+    Plays scripted notes through rp_gbapu and through minigb_apu (the
+    reference APU of the Peanut-GB SDL2 example) and compares when the
+    volume envelope steps, the length counters expire and the sweep
+    changes the frequency.
+
+    minigb_apu runs these per audio sample and from the time of the
+    trigger, while the GB (and rp_gbapu) runs them from the frame
+    sequencer, which is aligned to DIV. So a step may come up to one
+    sequencer period apart, plus one frame as both are looked at once per
+    frame. minigb_apu also sweeps once right at the trigger, a period
+    earlier than the GB does.
+
+    Build: gcc -O2 -c -DMINIGB_APU_AUDIO_FORMAT_S16SYS ../peanut-gb/examples/sdl2/minigb_apu/minigb_apu.c
+           g++ -O2 -I.. apuseq_test.cpp ../rp_gbapu.cpp minigb_apu.o -o apuseq_test
+    Usage: ./apuseq_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rp_gbapu.h"
+
+#define MINIGB_APU_AUDIO_FORMAT_S16SYS
+extern "C" {
+#include "peanut-gb/examples/sdl2/minigb_apu/minigb_apu.h"
+#include "check.h"
+}
+
+#define FRAME_CYCLES  70224
+#define FRAMES        120
+#define FRAME_RATE    (4194304.0 / FRAME_CYCLES)
+
+extern rp_gbapu gbapu;
+
+// NES APU writes of rp_gbapu are not looked at here
+void gbapuHostWrite(uint8_t reg, uint8_t value) {
+    (void)reg;
+    (void)value;
+}
+
+static minigb_apu_ctx mini;
+static audio_sample_t stream[AUDIO_SAMPLES_TOTAL];
+
+// Channel state at the end of each frame
+struct trace {
+    uint8_t volume[FRAMES];
+    uint16_t freq[FRAMES];
+    bool active[FRAMES];
+};
+
+static trace rp_trace, mini_trace;
+
+static void start() {
+    minigb_apu_audio_init(&mini);
+    gbapu.init();
+    gbapu.beginFrame(0, 0);
+    minigb_apu_audio_write(&mini, 0xFF26, 0x80);
+    audio_write(0xFF26, 0x80, 0);
+}
+
+// Writes at the start of the first frame
+static void write(uint16_t addr, uint8_t val) {
+    minigb_apu_audio_write(&mini, addr, val);
+    audio_write(addr, val, 0);
+}
+
+// DIV counts from 0 at cycle 0, as the frame sequencer does
+static void run(uint8_t ch) {
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        uint32_t cycles = f * FRAME_CYCLES;
+        gbapu.beginFrame(cycles, (uint16_t)cycles);
+        gbapu.clockTo(cycles + FRAME_CYCLES);
+        minigb_apu_audio_callback(&mini, stream);
+
+        const gb_channel& c = gbapu.getChannel(ch);
+        rp_trace.volume[f] = c.volume;
+        rp_trace.freq[f] = c.freq;
+        rp_trace.active[f] = c.active;
+        mini_trace.volume[f] = mini.chans[ch].volume;
+        mini_trace.freq[f] = mini.chans[ch].freq;
+        mini_trace.active[f] = mini.chans[ch].enabled;
+    }
+}
+
+// Frames both models may be apart for a clock of hz / period
+static uint32_t tolerance(double hz, uint32_t period) {
+    return (uint32_t)(period * FRAME_RATE / hz) + 1;
+}
+
+// First frame each model reaches step k of progress[], a count of the
+// steps taken by the end of each frame, and the two compared
+static void compareSteps(const char* name, const uint32_t* rp, const uint32_t* ref,
+                         uint32_t steps, uint32_t tol) {
+    for (uint32_t k = 1; k <= steps; k++) {
+        int32_t rp_frame = -1, ref_frame = -1;
+        for (int32_t f = 0; f < FRAMES; f++) {
+            if (rp_frame < 0 && rp[f] >= k) rp_frame = f;
+            if (ref_frame < 0 && ref[f] >= k) ref_frame = f;
+        }
+        if (rp_frame < 0 || ref_frame < 0 || abs(rp_frame - ref_frame) > (int32_t)tol) {
+            printf("%s: step %u at frame %d, reference %d (tolerance %u)\n",
+                   name, k, rp_frame, ref_frame, tol);
+            errors++;
+        }
+    }
+}
+
+static void compareEnvelope(const char* name, uint8_t initial, uint8_t last, uint8_t period) {
+    uint32_t rp[FRAMES], ref[FRAMES];
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        rp[f] = abs(rp_trace.volume[f] - initial);
+        ref[f] = abs(mini_trace.volume[f] - initial);
+    }
+    compareSteps(name, rp, ref, abs(last - initial), tolerance(64, period));
+    CHECK(rp_trace.volume[FRAMES - 1] == last);
+    CHECK(mini_trace.volume[FRAMES - 1] == last);
+}
+
+static void compareLength(const char* name, uint32_t length) {
+    uint32_t rp[FRAMES], ref[FRAMES];
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        rp[f] = !rp_trace.active[f];
+        ref[f] = !mini_trace.active[f];
+    }
+    compareSteps(name, rp, ref, 1, tolerance(256, 1));
+
+    // Not before the length has run out
+    uint32_t earliest = (uint32_t)(length * FRAME_RATE / 256) - 1;
+    CHECK(rp_trace.active[earliest - 1]);
+}
+
+// The frequencies the sweep goes through, up to an overflow
+static uint32_t sweepSteps(uint16_t freq, uint8_t shift, bool down, uint16_t* seq, uint32_t max) {
+    uint32_t n = 0;
+    seq[n++] = freq;
+    while (n < max) {
+        uint16_t delta = freq >> shift;
+        if (down) {
+            if (delta == 0) break;
+            freq -= delta;
+        } else {
+            if (freq + delta > 2047) break;
+            freq += delta;
+        }
+        seq[n++] = freq;
+    }
+    return n;
+}
+
+static uint32_t sweepIndex(const uint16_t* seq, uint32_t n, uint16_t freq) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (seq[i] == freq) return i;
+    }
+    return 0xFFFF;
+}
+
+static void compareSweep(const char* name, uint16_t freq, uint8_t period, uint8_t shift, bool down) {
+    uint16_t seq[64];
+    uint32_t n = sweepSteps(freq, shift, down, seq, 64);
+    uint32_t rp[FRAMES], ref[FRAMES];
+    uint32_t ref_last = 0;
+    for (uint32_t f = 0; f < FRAMES; f++) {
+        // The GB stops at the last frequency, as the next one would
+        // overflow. minigb_apu stores the overflowed one when it stops.
+        rp[f] = sweepIndex(seq, n, rp_trace.freq[f]);
+        if (mini_trace.active[f]) ref_last = sweepIndex(seq, n, mini_trace.freq[f]);
+        ref[f] = ref_last;
+        CHECK(rp[f] != 0xFFFF && ref[f] != 0xFFFF);
+    }
+    compareSteps(name, rp, ref, n - 1, tolerance(128, period + 1));
+}
+
+static void testEnvelopeDown() {
+    start();
+    write(0xFF10, 0x00);
+    write(0xFF12, 0xF2);
+    write(0xFF13, 0x00);
+    write(0xFF14, 0x86);
+    run(0);
+    compareEnvelope(__func__, 15, 0, 2);
+}
+
+static void testEnvelopeUp() {
+    start();
+    write(0xFF17, 0x3D);
+    write(0xFF18, 0x00);
+    write(0xFF19, 0x87);
+    run(1);
+    compareEnvelope(__func__, 3, 15, 5);
+}
+
+static void testNoiseEnvelope() {
+    start();
+    write(0xFF21, 0xA7);
+    write(0xFF22, 0x22);
+    write(0xFF23, 0x80);
+    run(3);
+    compareEnvelope(__func__, 10, 0, 7);
+}
+
+static void testPulseLength() {
+    start();
+    write(0xFF16, 0x90);  // 64 - 16 = 48 clocks
+    write(0xFF17, 0xF0);
+    write(0xFF18, 0x00);
+    write(0xFF19, 0xC7);
+    run(1);
+    compareLength(__func__, 48);
+}
+
+static void testWaveLength() {
+    start();
+    for (uint16_t addr = 0xFF30; addr < 0xFF40; addr++) {
+        write(addr, (addr & 1) ? 0x9C : 0x63);
+    }
+    write(0xFF1A, 0x80);
+    write(0xFF1B, 0x40);  // 256 - 64 = 192 clocks
+    write(0xFF1C, 0x20);
+    write(0xFF1D, 0x00);
+    write(0xFF1E, 0xC7);
+    run(2);
+    compareLength(__func__, 192);
+}
+
+static void testNoiseLength() {
+    start();
+    write(0xFF20, 0x20);  // 64 - 32 = 32 clocks
+    write(0xFF21, 0xF0);
+    write(0xFF22, 0x11);
+    write(0xFF23, 0xC0);
+    run(3);
+    compareLength(__func__, 32);
+}
+
+// Without the length enabled, the length counter does not stop the note
+static void testLengthDisabled() {
+    start();
+    write(0xFF16, 0xBF);
+    write(0xFF17, 0xF0);
+    write(0xFF19, 0x87);
+    run(1);
+    CHECK(rp_trace.active[FRAMES - 1]);
+    CHECK(mini_trace.active[FRAMES - 1]);
+}
+
+// Goes up until the overflow stops the channel. The GB checks the next
+// frequency too and stops a period before minigb_apu does.
+static void testSweepUp() {
+    start();
+    write(0xFF10, 0x23);  // Period 2, up, shift 3
+    write(0xFF12, 0xF0);
+    write(0xFF13, 0x00);
+    write(0xFF14, 0x81);
+    run(0);
+    compareSweep(__func__, 0x100, 2, 3, false);
+    CHECK(!rp_trace.active[FRAMES - 1]);
+    CHECK(!mini_trace.active[FRAMES - 1]);
+}
+
+// Goes down until the step is 0, then the frequency stays
+static void testSweepDown() {
+    start();
+    write(0xFF10, 0x1A);  // Period 1, down, shift 2
+    write(0xFF12, 0xF0);
+    write(0xFF13, 0x00);
+    write(0xFF14, 0x87);
+    run(0);
+    compareSweep(__func__, 0x700, 1, 2, true);
+    CHECK(rp_trace.freq[FRAMES - 1] == mini_trace.freq[FRAMES - 1]);
+    CHECK(rp_trace.active[FRAMES - 1]);
+}
+
+// A slow envelope, a second note and a DIV that does not start at 0: the
+// sequencer keeps its phase over frames of any length
+static void testRetrigger() {
+    start();
+    write(0xFF17, 0xF7);
+    write(0xFF19, 0x87);
+    for (uint32_t f = 0; f < 30; f++) {
+        gbapu.beginFrame(f * FRAME_CYCLES, (uint16_t)(f * FRAME_CYCLES + 0x1234));
+    }
+    gbapu.clockTo(30 * FRAME_CYCLES);
+    // 30 frames: 0.5s, 32 envelope clocks, 4 steps of period 7
+    CHECK(gbapu.getChannel(1).volume == 11);
+
+    audio_write(0xFF17, 0xF1, 30 * FRAME_CYCLES);
+    audio_write(0xFF19, 0x87, 30 * FRAME_CYCLES);
+    CHECK(gbapu.getChannel(1).volume == 15);
+    gbapu.clockTo(40 * FRAME_CYCLES);
+    CHECK(gbapu.getChannel(1).volume == 5 || gbapu.getChannel(1).volume == 4);
+}
+
+int main() {
+    testEnvelopeDown();
+    testEnvelopeUp();
+    testNoiseEnvelope();
+    testPulseLength();
+    testWaveLength();
+    testNoiseLength();
+    testLengthDisabled();
+    testSweepUp();
+    testSweepDown();
+    testRetrigger();
+
+    return checkResult();
+}
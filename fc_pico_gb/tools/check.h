@@ -0,0 +1,29 @@
+/*
+    check.h - Failure counting for the host tests in tools/
+
+    CHECK() prints a condition that does not hold and counts it.
+    checkResult() prints the count and returns the exit code for main().
+    Each test is a single source file, so the counter is kept here.
+*/
+
+#ifndef check_h
+#define check_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+static uint32_t errors = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: %s\n", __func__, __LINE__, #cond); \
+            errors++; \
+        } \
+    } while (0)
+
+static inline int checkResult() {
+    printf("%s: %lu errors\n", errors ? "FAIL" : "OK", (unsigned long)errors);
+    return errors ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+    gbapu_bench.cpp - Host benchmark for the per-frame GB APU mapping
+
+    Plays four GB channels whose pitch changes every frame (pulse
+    arpeggios, a wave bass line, noise retriggers) and times
+    rp_gbapu::updatePulsePriority(), the per-frame mapping that runs on
+    core1 after each GB frame. Also times the frequency conversions alone,
+    the run-time formulas against the lookup tables of rp_gbfreq.h.
+
+    Build: g++ -O2 -I.. gbapu_bench.cpp ../rp_gbapu.cpp -o gbapu_bench
+    Usage: ./gbapu_bench [frames]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "rp_gbapu.h"
+#include "rp_gbfreq.h"
+
+#define FRAME_CYCLES 70224
+
+extern rp_gbapu gbapu;
+
+static uint32_t nes_writes = 0;
+
+void gbapuHostWrite(uint8_t reg, uint8_t value) {
+    (void)reg;
+    (void)value;
+    nes_writes++;
+}
+
+static uint32_t cycles = 0;
+
+static void write(uint16_t addr, uint8_t val) {
+    audio_write(addr, val, cycles);
+}
+
+static void start() {
+    gbapu.init();
+    gbapu.beginFrame(0, 0);
+    write(0xFF26, 0x80);
+
+    for (uint16_t addr = 0xFF30; addr < 0xFF40; addr++) {
+        write(addr, (uint8_t)((addr - 0xFF30) * 0x11));  // Sawtooth
+    }
+    write(0xFF10, 0x00);
+    write(0xFF11, 0x80);
+    write(0xFF12, 0xF0);
+    write(0xFF14, 0x86);
+    write(0xFF16, 0x40);
+    write(0xFF17, 0xA0);
+    write(0xFF19, 0x86);
+    write(0xFF1A, 0x80);
+    write(0xFF1C, 0x20);
+    write(0xFF1E, 0x85);
+    write(0xFF21, 0xC1);
+    write(0xFF23, 0x80);
+}
+
+// Register writes of a frame: new pitches everywhere
+static void frameWrites(uint32_t f) {
+    static const uint8_t arp[3] = {0x00, 0x40, 0x80};
+    write(0xFF13, arp[f % 3]);
+    write(0xFF18, arp[(f + 1) % 3] + 0x10);
+    write(0xFF1D, (uint8_t)(f * 7));
+    write(0xFF22, (uint8_t)(f * 13));
+    if ((f & 3) == 0) {
+        write(0xFF23, 0x80);
+    }
+}
+
+static double benchUpdate(uint32_t frames) {
+    double total = 0;
+    for (uint32_t f = 0; f < frames; f++) {
+        gbapu.beginFrame(cycles, (uint16_t)cycles);
+        frameWrites(f);
+        cycles += FRAME_CYCLES;
+        gbapu.clockTo(cycles);
+
+        auto t0 = std::chrono::steady_clock::now();
+        gbapu.updatePulsePriority((uint8_t)(f % 3));
+        auto t1 = std::chrono::steady_clock::now();
+        total += std::chrono::duration<double, std::nano>(t1 - t0).count();
+    }
+    return total / frames;
+}
+
+// volatile, so that the formulas are run, not folded by the compiler
+static volatile uint16_t input;
+static volatile uint32_t sink;
+
+template <typename F>
+static double timeConv(F conv, uint32_t size, uint32_t rounds) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t x = 0; x < size; x++) {
+            input = (uint16_t)x;
+            sink = conv(input);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)rounds * size);
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = (argc > 1) ? atoi(argv[1]) : 100000;
+
+    start();
+    benchUpdate(1000);  // Warm up
+    nes_writes = 0;
+    double t_update = benchUpdate(frames);
+    printf("updatePulsePriority: %8.1f ns/frame, %.1f NES writes/frame\n",
+           t_update, (double)nes_writes / frames);
+
+    uint32_t rounds = 2000;
+    double t_pulse = timeConv([](uint16_t x) { return gbfreqPulse(x); }, GBFREQ_SIZE, rounds);
+    double t_pulse_tbl = timeConv([](uint16_t x) { return GBFREQ_TABLES.pulse[x & (GBFREQ_SIZE - 1)]; },
+                                  GBFREQ_SIZE, rounds);
+    double t_noise = timeConv([](uint16_t x) { return gbfreqNoise((uint8_t)x); }, GBFREQ_NOISE_SIZE, rounds);
+    double t_noise_tbl = timeConv([](uint16_t x) { return GBFREQ_TABLES.noise[(uint8_t)x]; },
+                                  GBFREQ_NOISE_SIZE, rounds);
+
+    printf("pulse period:  formula %6.2f ns, table %6.2f ns\n", t_pulse, t_pulse_tbl);
+    printf("noise period:  formula %6.2f ns, table %6.2f ns\n", t_noise, t_noise_tbl);
+    return 0;
+}
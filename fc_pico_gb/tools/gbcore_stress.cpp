@@ -0,0 +1,202 @@
+/*
+    gbcore_stress.cpp - Host stress test for the core0/core1 frame hand-off
+
+    Two std::threads stand in for the cores. "core1" plays rp_gbemu's
+    emulating side: it takes a frame request, fills the PPU draw buffer,
+    publishes it (rp_system::publishVram) and answers with a done message.
+    "core0" plays the vsync IRQ and loop(): it picks up the newest published
+    buffer (rp_system::ppu_dma), checks that it holds exactly one complete
+    frame while core1 may be drawing the next one, and starts the next
+    frame with its input. The rings are the same rp_spsc.h used on the
+    Pico, the triple buffer uses the same exchange protocol.
+
+    Every RESET_EVERY vsyncs core0 also plays FP_COM_RST, which may come in
+    while core1 is drawing: it waits for the frame in flight
+    (rp_gbemu::waitFrame) and then clears the buffers and sets all three
+    indices back as rp_system::initVram() does, core1's draw index too.
+
+    Build: g++ -O2 -std=c++17 -pthread -I.. gbcore_stress.cpp -o gbcore_stress
+    (add -fsanitize=thread to let TSan check the hand-off as well)
+    Usage: ./gbcore_stress [frames]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+#include "rp_spsc.h"
+
+#define WORDS (32 * 144)  // GB screen area of one PPU buffer
+#define RESET_EVERY 997   // vsyncs between resets
+
+struct frame_req {
+    uint32_t seq;     // Frame number
+    uint8_t joypad;   // Input, derived from seq
+};
+
+struct frame_done {
+    uint32_t seq;
+};
+
+static rp_spsc<frame_req, 2> req_ring;
+static rp_spsc<frame_done, 2> done_ring;
+
+// PPU triple buffer as in rp_system
+#define VRAM_BUF_NUM 3
+#define VRAM_FRESH 0x80
+#define VRAM_INDEX 0x03
+static uint32_t bufs[VRAM_BUF_NUM][WORDS];
+static std::atomic<uint8_t> ready(2);
+static uint8_t front = 0;  // core0 (IRQ)
+static uint8_t draw = 1;   // core1, and core0 while core1 is idle
+static uint32_t dropped = 0;
+static std::atomic<bool> drawing(false);  // core1 is inside a frame
+
+static std::atomic<bool> quit(false);
+static std::atomic<uint32_t> errors(0);
+
+static uint8_t joypadFor(uint32_t seq) {
+    return (uint8_t)(seq * 37 + 11);
+}
+
+// Emulating core: rp_gbemu::serviceFrame()
+static void core1() {
+    uint32_t expect = 1;
+    uint32_t spin = 0;
+
+    while (!quit.load(std::memory_order_relaxed)) {
+        frame_req req;
+        if (!req_ring.pop(&req)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (req.seq != expect || req.joypad != joypadFor(req.seq)) {
+            printf("core1: got frame %u (joypad %02x), expected %u\n",
+                   req.seq, req.joypad, expect);
+            errors++;
+        }
+        expect = req.seq + 1;
+        drawing.store(true, std::memory_order_relaxed);
+
+        // Draw the frame. Lines are written one by one and some frames are
+        // slow, so that core0 sees frames that are not done at vsync.
+        frame_done done;
+        done.seq = req.seq;
+        for (int i = 0; i < WORDS; i++) {
+            bufs[draw][i] = req.seq ^ (uint32_t)i;
+            if (i == WORDS / 2 && (++spin % 7) == 0) {
+                std::this_thread::yield();
+            }
+        }
+
+        uint8_t prev = ready.exchange(draw | VRAM_FRESH, std::memory_order_acq_rel);
+        if (prev & VRAM_FRESH) {
+            dropped++;
+        }
+        draw = prev & VRAM_INDEX;
+        drawing.store(false, std::memory_order_relaxed);
+        done_ring.push(done);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = (argc > 1) ? (uint32_t)atoi(argv[1]) : 200000;
+
+    std::thread t(core1);
+
+    // core0: rp_system::ppu_dma() + loop() + rp_gbemu::startFrame()
+    uint32_t shown = 0;      // Frame in the front buffer
+    uint32_t done_seq = 0;   // Last frame reported done
+    uint32_t next = 1;       // Next frame to start
+    uint32_t repeats = 0;    // Vsyncs without a new frame
+    uint32_t resets = 0;
+    uint32_t vsyncs = 0;
+    bool busy = false;
+
+    // rp_gbemu::isFrameBusy()
+    auto frameBusy = [&]() {
+        frame_done done;
+        if (busy && done_ring.pop(&done)) {
+            busy = false;
+            if (done.seq != done_seq + 1) {
+                printf("core0: frame %u done, expected %u\n", done.seq, done_seq + 1);
+                errors++;
+            }
+            done_seq = done.seq;
+        }
+        return busy;
+    };
+
+    while (done_seq < frames) {
+        // FP_COM_RST in loop(): rp_gbemu::waitFrame(), then initVram()
+        if (++vsyncs % RESET_EVERY == 0) {
+            while (frameBusy()) {
+                std::this_thread::yield();
+            }
+            if (drawing.load(std::memory_order_relaxed)) {
+                printf("core0: reset while core1 draws frame %u\n", next - 1);
+                errors++;
+            }
+            memset(bufs, 0, sizeof(bufs));
+            front = 0;
+            draw = 1;
+            ready.store(2, std::memory_order_relaxed);
+            shown = 0;
+            resets++;
+        }
+
+        // vsync: take the newest published frame, otherwise send the old one
+        if (ready.load(std::memory_order_relaxed) & VRAM_FRESH) {
+            uint8_t prev = ready.exchange(front, std::memory_order_acq_rel);
+            front = prev & VRAM_INDEX;
+        } else {
+            if (shown != 0) {
+                repeats++;
+            }
+            std::this_thread::yield();
+        }
+
+        // "DMA" the front buffer: one complete frame, never older than the
+        // last one shown
+        uint32_t seq = bufs[front][0];
+        if (seq != 0 || shown != 0) {
+            if (seq < shown) {
+                printf("core0: frame %u shown after %u\n", seq, shown);
+                errors++;
+            }
+            for (int i = 0; i < WORDS; i++) {
+                if (bufs[front][i] != (seq ^ (uint32_t)i)) {
+                    printf("core0: frame %u torn at word %d\n", seq, i);
+                    errors++;
+                    break;
+                }
+            }
+            shown = seq;
+        }
+
+        // loop(): start the next frame once the last one is done
+        if (!frameBusy()) {
+            frame_req req;
+            req.seq = next++;
+            req.joypad = joypadFor(req.seq);
+            busy = true;
+            if (!req_ring.push(req)) {
+                printf("core0: request ring full\n");
+                errors++;
+            }
+        }
+
+        if (errors.load() > 10) {
+            break;
+        }
+    }
+
+    quit = true;
+    t.join();
+
+    printf("%u frames, %u dropped, %u vsyncs repeated the last frame, %u resets, %u errors\n",
+           done_seq, dropped, repeats, resets, errors.load());
+    return errors.load() ? 1 : 0;
+}
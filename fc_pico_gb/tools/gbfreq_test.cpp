@@ -0,0 +1,126 @@
+/*
+    gbfreq_test.cpp - Host test for the GB to NES frequency tables (rp_gbfreq.h)
+
+    Checks every entry of the compile-time tables against the run-time
+    conversions rp_gbapu used before them, and against the constexpr
+    formulas called at run time.
+
+    Build: g++ -O2 -I.. gbfreq_test.cpp -o gbfreq_test
+    Usage: ./gbfreq_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rp_gbfreq.h"
+#include "check.h"
+
+// rp_gbapu::gbToNesPulsePeriod() before the tables
+static uint16_t refPulse(uint16_t gbFreqReg) {
+    if (gbFreqReg >= 2048) return 0;
+
+    uint32_t divisor = 2048 - gbFreqReg;
+    if (divisor == 0) return 2047;
+
+    uint32_t numerator = (uint32_t)1789773 * divisor;
+    uint32_t period = (numerator + 1048576) / 2097152;
+
+    if (period == 0) return 8;
+    period -= 1;
+
+    if (period < 8) period = 8;
+    if (period > 2047) period = 2047;
+
+    return (uint16_t)period;
+}
+
+// rp_gbapu::gbToNesTrianglePeriod() before the tables
+static uint16_t refTriangle(uint16_t gbFreqReg) {
+    if (gbFreqReg >= 2048) return 0;
+
+    uint32_t divisor = 2048 - gbFreqReg;
+    if (divisor == 0) return 2047;
+
+    uint32_t numerator = (uint32_t)1789773 * divisor;
+    uint32_t period = (numerator + 1048576) / 2097152;
+
+    if (period == 0) return 2;
+    period -= 1;
+
+    if (period < 2) period = 2;
+    if (period > 2047) period = 2047;
+
+    return (uint16_t)period;
+}
+
+// rp_gbapu::gbNoiseToNesPeriod() before the tables
+static uint8_t refNoise(uint8_t gbNR43) {
+    static const uint16_t nes_periods[16] = {
+        4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+    };
+    static const uint8_t gb_divisors[8] = {8, 16, 32, 48, 64, 80, 96, 112};
+
+    uint8_t shift = (gbNR43 >> 4) & 0x0F;
+    uint8_t divisor = gb_divisors[gbNR43 & 0x07];
+
+    uint32_t divider = (uint32_t)divisor * (1 << shift);
+    if (divider == 0) return 0x0F;
+
+    uint32_t gbFreq = 262144 / divider;
+    if (gbFreq == 0) return 0x0F;
+
+    uint8_t bestIdx = 0;
+    uint32_t bestDiff = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < 16; i++) {
+        uint32_t nesFreq = 1789773 / nes_periods[i];
+        uint32_t diff = (gbFreq > nesFreq) ? (gbFreq - nesFreq) : (nesFreq - gbFreq);
+        if (diff < bestDiff) {
+            bestDiff = diff;
+            bestIdx = i;
+        }
+    }
+    return bestIdx;
+}
+
+// Known points: A4 (440Hz) is pulse 1750 on the GB and 253 on the NES. The
+// wave and the triangle are both an octave lower, so they map the same.
+static_assert(GBFREQ_TABLES.pulse[1750] == 253, "pulse A4");
+static_assert(GBFREQ_TABLES.triangle[1750] == 253, "triangle A4");
+static_assert(GBFREQ_TABLES.pulse[2047] == 8, "pulse clamp");
+static_assert(GBFREQ_TABLES.triangle[2047] == 2, "triangle clamp");
+static_assert(GBFREQ_TABLES.noise[0xF7] == 0x0F, "noise lowest");
+
+// volatile, so that the formulas are run, not folded by the compiler
+static volatile uint16_t input;
+
+static void testPulse() {
+    for (uint16_t x = 0; x < GBFREQ_SIZE; x++) {
+        input = x;
+        CHECK(GBFREQ_TABLES.pulse[x] == refPulse(input));
+        CHECK(GBFREQ_TABLES.pulse[x] == gbfreqPulse(input));
+    }
+}
+
+static void testTriangle() {
+    for (uint16_t x = 0; x < GBFREQ_SIZE; x++) {
+        input = x;
+        CHECK(GBFREQ_TABLES.triangle[x] == refTriangle(input));
+        CHECK(GBFREQ_TABLES.triangle[x] == gbfreqTriangle(input));
+    }
+}
+
+static void testNoise() {
+    for (uint16_t x = 0; x < GBFREQ_NOISE_SIZE; x++) {
+        input = x;
+        CHECK(GBFREQ_TABLES.noise[x] == refNoise((uint8_t)input));
+        CHECK(GBFREQ_TABLES.noise[x] == gbfreqNoise((uint8_t)input));
+    }
+}
+
+int main() {
+    testPulse();
+    testTriangle();
+    testNoise();
+
+    return checkResult();
+}
@@ -0,0 +1,683 @@
+/*
+    linksim.cpp - Host simulator of the FC <-> Pico link
+
+    Implements rp_linkhal.h against a simulated FC and runs the real link
+    protocol (rp_fclink.cpp) on the Pico side, in simulated time:
+
+    - The FC reads the PPU stream at the NTSC rate: 15426 reads spread over
+      the rendered lines, then FC_COM_BUF (and the extended area) in the
+      NMI, then the key write that raises the Pico's PIO IRQ.
+    - The Pico IRQ runs after a configurable latency (base, random jitter
+      and rare long stalls), as rp_system::jobRcvCom() would.
+    - The Pico queues VRAM pokes into the command tail like
+      rp_system::setPF_VRAM(), and the FC checks that they arrive in order.
+    - Every few seconds the Pico asks for the data mode (PF_COM_DMOD), and
+      the FC runs the DRQ/DLD handshake for a palette and an attribute
+      table, checking the replies and the data.
+    - Every FC read of a frame is checked against the stream of a single
+      buffer with the command tail copied to its end, which is what the
+      chained frame + tail DMA has to reproduce.
+
+    Prints the link bandwidth, the command tail usage, lost frames and
+    pokes, and the data mode results.
+
+    Build: g++ -O2 -I.. linksim.cpp ../rp_fclink.cpp -o linksim
+    Usage: ./linksim [options] [frames]
+        -e       the FC reads the extended command area
+        -p n     VRAM pokes queued per frame, on average (default 2)
+        -l us    IRQ latency (default 2)
+        -j us    mean random extra IRQ latency (default 0)
+        -s n     one IRQ in n stalls for -S us (default 0 = never)
+        -S us    stall length (default 2000)
+        -d n     data mode every n frames (default 600, 0 = never)
+        -w us    FC wait between a DRQ/DLD write and reading the reply (default 50)
+        -u n     the main loop misses one vsync in n (default 0 = never)
+        -r n     random seed
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <deque>
+#include <vector>
+
+#include "rp_linkhal.h"
+#include "rp_fclink.h"
+
+// NTSC timing in microseconds
+#define DOT_US          (1.0 / 5.369318)       // PPU dot
+#define CPU_US          (1.0 / 1.789773)       // CPU cycle
+#define LINE_DOTS       341
+#define FRAME_DOTS      89341.5
+#define NMI_LINE        241
+#define PRERENDER_LINE  261
+#define PPU_READS       (PPU_COUNT_VAL - FC_COM_BUF_SIZE)
+
+// FC CPU cycles per byte read from $2007 in the NMI / data mode loops
+#define TAIL_CYCLES     8
+#define EXT_CYCLES      14   // fc_rom/patch_apu.py NMI hook
+#define DATA_CYCLES     8
+
+#define RECV_FIFO_DEPTH 8    // SM_RECV, RX joined
+#define FRAME_WORDS     ((PPU_COUNT_EXT + 3) / 4)
+#define PPU_DRAWN       ((31 + 240 * 32) * 2)  // rp_system.h VRAM_TOP_WORDS, VRAM_LINE_WORDS
+
+static double opt_irq_us = 2.0;
+static double opt_jitter_us = 0.0;
+static uint32_t opt_stall = 0;
+static double opt_stall_us = 2000.0;
+static double opt_pokes = 2.0;
+static uint32_t opt_dmode = 600;
+static uint32_t opt_miss = 0;
+static double opt_wait_us = 50.0;
+static bool opt_ext = false;
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd() {
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static double rndUnit() {
+    return (rnd() >> 8) / 16777216.0;
+}
+
+//=================================================
+// rp_linkhal.h: PIO state machines and DMA, seen from the FC bus
+//=================================================
+
+static double now_us;
+static std::deque<uint8_t> recv_fifo;   // SM_RECV
+static std::deque<uint8_t> tran_fifo;   // SM_TRAN FIFO, words put by the CPU
+static const uint8_t* dma_src;          // DMA channel feeding SM_TRAN
+static uint32_t dma_left;               // bytes
+static const uint8_t* dma_src2;         // chained channel, after dma_src
+static uint32_t dma_left2;
+static uint32_t tran_reads;             // SM_TRCNT
+static uint8_t bus;                     // last byte driven by SM_TRAN
+
+static uint64_t stat_reads;
+static uint64_t stat_starved;           // reads with nothing to send
+static uint32_t stat_recv_overflow;
+
+void linkInit() {
+}
+
+bool linkRecvEmpty() {
+    return recv_fifo.empty();
+}
+
+uint8_t linkRecvGet() {
+    if (recv_fifo.empty()) {
+        // The Pico would wait here for the FC, which cannot happen in one thread
+        printf("%.0f us: Pico waits for a byte the FC has not written\n", now_us);
+        exit(2);
+    }
+    uint8_t b = recv_fifo.front();
+    recv_fifo.pop_front();
+    return b;
+}
+
+void linkTranRestart() {
+    tran_fifo.clear();
+}
+
+void linkTranPut(uint32_t w) {
+    for (int i = 0; i < 4; i++) {
+        tran_fifo.push_back((uint8_t)(w >> (i * 8)));
+    }
+}
+
+static bool tranNext(uint8_t* b) {
+    if (!tran_fifo.empty()) {
+        *b = tran_fifo.front();
+        tran_fifo.pop_front();
+        return true;
+    }
+    if (dma_left != 0) {
+        *b = *dma_src++;
+        dma_left--;
+        return true;
+    }
+    if (dma_left2 != 0) {
+        *b = *dma_src2++;
+        dma_left2--;
+        return true;
+    }
+    return false;
+}
+
+void linkTranSkip() {
+    uint8_t b;
+    tranNext(&b);
+}
+
+void linkDmaStart(const void* buf, uint32_t words) {
+    dma_src = (const uint8_t*)buf;
+    dma_left = words * 4;
+    dma_left2 = 0;
+}
+
+void linkDmaChain(const void* buf, uint32_t words, const void* buf2, uint32_t words2) {
+    linkDmaStart(buf, words);
+    dma_src2 = (const uint8_t*)buf2;
+    dma_left2 = words2 * 4;
+}
+
+void linkDmaStop() {
+    dma_left = 0;
+    dma_left2 = 0;
+}
+
+uint32_t linkTakeReadCount() {
+    uint32_t n = tran_reads;
+    tran_reads = 0;
+    return n;
+}
+
+//=================================================
+// Pico: rp_system's side of the link
+//=================================================
+
+static rp_fclink fclink;
+
+static bool irq_pending;
+static double irq_time;
+static double irq_latency_max;
+static double irq_latency_sum;
+static uint32_t irq_count;
+
+// PPU buffers: a new frame every vsync, numbered in the first 4 bytes
+static uint32_t frame_bufs[2][FRAME_WORDS + 1];
+static uint32_t frame_seq;
+
+static uint8_t frameByte(uint32_t seq, uint32_t i) {
+    if (i < 4) {
+        return (uint8_t)(seq >> (i * 8));
+    }
+    if (i >= PPU_DRAWN) {
+        return 0;
+    }
+    return (uint8_t)(seq * 31 + i * 7 + (i >> 8));
+}
+
+// The FC reads of the frame sent last, as one buffer with the tail copied in
+static uint8_t ref_stream[PPU_COUNT_EXT];
+static uint32_t ref_pos;
+static uint32_t ref_len;                // 0: no frame
+static uint64_t stat_ref_bytes;
+static uint64_t stat_ref_diffs;
+
+static void refFrame(const uint32_t* buf, uint32_t count, uint32_t read_count) {
+    memcpy(ref_stream, buf, PPU_COUNT_VAL - FC_COM_BUF_SIZE);
+    memcpy(ref_stream + PPU_COUNT_VAL - FC_COM_BUF_SIZE, fclink.comBuf(), FC_COM_BUF_SIZE);
+    memcpy(ref_stream + PPU_COUNT_VAL, fclink.extBuf(), FC_COM_EXT_SIZE);
+    ref_pos = (read_count < count) ? count - read_count : 0;
+    ref_len = PPU_COUNT_EXT;
+}
+
+// Command tail for the next vsync (rp_fclink::comBuf(), extBuf())
+static uint8_t* com;
+static uint8_t* ext;
+static uint32_t poke_next;              // id of the next poke to queue
+static uint32_t poke_queued;            // oldest poke not in a tail yet
+static std::vector<uint32_t> poke_born; // frame each poke was queued in
+static uint8_t tail_n;                  // pokes in com/ext
+static bool tail_dmode;
+static bool dmode_req;
+static uint64_t stat_tail_bytes;        // command bytes used in the sent tails
+static uint64_t stat_tail_room;
+
+// The pokes carry their id: adr = $2000 + id[11:0], dt = id[19:12]
+static void pokeBytes(uint32_t id, uint8_t* p, bool legacy) {
+    uint16_t adr = 0x2000 + (id & 0xFFF);
+    p[0] = (uint8_t)(adr >> 8) | (legacy ? PF_COM_VRAM : 0);
+    p[1] = (uint8_t)adr;
+    p[2] = (uint8_t)(id >> 12);
+}
+
+static bool ext_on;                     // rp_system::m_com_ext
+
+// rp_system::update(): initFC_COM_BUF(), then the pokes as they fit
+static void picoUpdate(uint32_t frame) {
+    com = fclink.comBuf();
+    ext = fclink.extBuf();
+    memset(com, 0, FC_COM_BUF_SIZE);
+    com[1] = PF_MAGIC_NO;
+    memset(ext, 0, FC_COM_EXT_SIZE);
+    ext[0] = PF_MAGIC_NO;
+    fclink.prepareTail();
+    tail_n = 0;
+
+    // New pokes of this frame
+    double mean = opt_pokes;
+    while (mean > 0 && rndUnit() < mean / (mean + 1)) {
+        poke_born.push_back(frame);
+        poke_next++;
+    }
+
+    uint8_t idx = 2;
+    tail_dmode = dmode_req;
+    if (dmode_req) {
+        com[idx++] = PF_COM_DMOD;
+    }
+    uint32_t id = poke_queued;
+    while (id != poke_next && idx + 3 <= FC_COM_BUF_SIZE) {
+        pokeBytes(id, &com[idx], true);
+        idx += 3;
+        tail_n++;
+        id++;
+    }
+    uint8_t used = idx - 2;
+    if (ext_on && id != poke_next) {
+        uint8_t len = 0;
+        while (id != poke_next && 1 + 1 + len + 3 <= FC_COM_EXT_SIZE) {
+            pokeBytes(id, &ext[2 + len], false);
+            len += 3;
+            tail_n++;
+            id++;
+        }
+        ext[1] = PF_EXT_VRAM | len;
+        used += 1 + len;
+    }
+    stat_tail_bytes += used;
+    stat_tail_room += (FC_COM_BUF_SIZE - 2) + (ext_on ? FC_COM_EXT_SIZE - 1 : 0);
+}
+
+// The tail was sent: its pokes leave the queue
+static void tailSent() {
+    poke_queued += tail_n;
+    tail_n = 0;
+    if (tail_dmode) {
+        dmode_req = false;
+        tail_dmode = false;
+    }
+}
+
+// Data mode: what rp_system::jobFP_COM_DRQ() sends, and the FC's copy
+static uint8_t pal_data[0x20];
+static uint8_t atr_data[0x40];
+static uint8_t drq_step;
+
+static void picoDRQ() {
+    uint32_t head[2];
+    if (drq_step == 0) {
+        head[0] = 0xFC00 + PF_DAT_VRAM + (0x3F00 << 16);
+        head[1] = sizeof(pal_data);
+    } else if (drq_step == 1) {
+        head[0] = 0xFC00 + PF_DAT_VRAM + (0x23C0 << 16);
+        head[1] = sizeof(atr_data);
+    } else {
+        head[0] = 0xFC00 + PF_COM_NONE;
+        head[1] = 0;
+    }
+    drq_step++;
+    ref_len = 0;
+    fclink.sendData(NULL, 0, head, 2);
+}
+
+static void picoDLD(uint8_t adrh) {
+    const uint8_t* src = (drq_step == 1) ? pal_data : atr_data;
+    ref_len = 0;
+    fclink.sendData(&src[adrh << 8], 0x100 / 4);
+}
+
+// PIO IRQ: rp_system::jobRcvCom() until the FIFO is empty. DLD's page byte
+// may come with a later IRQ.
+static uint8_t rcv_com;
+
+static void picoIrq(uint32_t frame) {
+    while (!fclink.isRcvEmpty()) {
+        uint8_t dt = fclink.getRcvCom();
+        if (rcv_com == FP_COM_DLD) {
+            rcv_com = 0;
+            picoDLD(dt);
+            continue;
+        }
+        switch (dt) {
+        case FP_COM_DRQ:
+            picoDRQ();
+            break;
+        case FP_COM_DLD:
+            rcv_com = dt;
+            break;
+        default: {
+            // Key data: ppu_dma()
+            uint32_t count = fclink.beginFrame();
+            uint32_t* buf = frame_bufs[frame_seq & 1];
+            if (count != 0) {
+                ext_on = (count == PPU_COUNT_EXT);
+                refFrame(buf, count, fclink.getReadCount());
+                fclink.sendFrame(count, buf);
+                tailSent();
+            } else {
+                // The tail is rebuilt with the same pokes for the next vsync
+                fclink.stopFrame();
+                ref_len = 0;
+            }
+
+            // loop(): the next frame and its tail
+            frame_seq++;
+            uint8_t* p = (uint8_t*)frame_bufs[frame_seq & 1];
+            for (uint32_t i = 0; i < PPU_READS; i++) {
+                p[i] = frameByte(frame_seq, i);
+            }
+            if (opt_dmode && frame % opt_dmode == opt_dmode - 1) {
+                dmode_req = true;
+            }
+            if (opt_miss == 0 || rnd() % opt_miss != 0) {
+                picoUpdate(frame);
+            }
+            break;
+        }
+        }
+    }
+}
+
+static uint32_t cur_frame;
+
+// Run the Pico IRQ if it is due by time t
+static void advance(double t) {
+    while (irq_pending && irq_time <= t) {
+        now_us = irq_time;
+        irq_pending = false;
+        picoIrq(cur_frame);
+    }
+    now_us = t;
+}
+
+static double irqLatency() {
+    double us = opt_irq_us;
+    if (opt_jitter_us > 0) {
+        us += -log(1.0 - rndUnit()) * opt_jitter_us;
+    }
+    if (opt_stall && rnd() % opt_stall == 0) {
+        us += opt_stall_us;
+    }
+    return us;
+}
+
+//=================================================
+// FC
+//=================================================
+
+static uint8_t fcRead(double t) {
+    advance(t);
+    stat_reads++;
+    tran_reads++;
+    uint8_t b;
+    if (tranNext(&b)) {
+        bus = b;
+    } else {
+        stat_starved++;
+    }
+    if (ref_pos < ref_len) {
+        stat_ref_bytes++;
+        stat_ref_diffs += (bus != ref_stream[ref_pos++]);
+    }
+    return bus;
+}
+
+static void fcWrite(double t, uint8_t b) {
+    advance(t);
+    if (recv_fifo.size() >= RECV_FIFO_DEPTH) {
+        stat_recv_overflow++;
+        return;
+    }
+    recv_fifo.push_back(b);
+    if (!irq_pending) {
+        double lat = irqLatency();
+        irq_pending = true;
+        irq_time = t + lat;
+        irq_latency_sum += lat;
+        irq_count++;
+        if (lat > irq_latency_max) {
+            irq_latency_max = lat;
+        }
+    }
+}
+
+static uint32_t fc_poke_expect;         // next poke id
+static bool fc_poke_resync;
+static uint32_t stat_pokes_ok;
+static uint32_t stat_pokes_superseded;  // in the frame skipped for the data mode
+static uint32_t stat_pokes_bad;         // out of order
+static uint32_t stat_poke_latency_max;  // frames from queueing to the FC
+static uint64_t stat_poke_latency_sum;
+
+static void fcPoke(uint8_t adrh, uint8_t adrl, uint8_t dt, uint32_t frame) {
+    uint32_t id = (((adrh & 0x3F) << 8 | adrl) - 0x2000) | ((uint32_t)dt << 12);
+    if (fc_poke_resync) {
+        // The data mode sent PAL and ATR whole, as rp_system does
+        fc_poke_resync = false;
+        stat_pokes_superseded += id - fc_poke_expect;
+        fc_poke_expect = id;
+    }
+    if (id != fc_poke_expect) {
+        stat_pokes_bad++;
+        fc_poke_expect = id + 1;
+        return;
+    }
+    stat_pokes_ok++;
+    uint32_t lat = frame - poke_born[fc_poke_expect];
+    stat_poke_latency_sum += lat;
+    if (lat > stat_poke_latency_max) {
+        stat_poke_latency_max = lat;
+    }
+    fc_poke_expect++;
+}
+
+// FC_COM_BUF and the extended area as read in the NMI. Returns true when
+// the Pico asked for the data mode.
+static bool fcParseTail(const uint8_t* tail, const uint8_t* etail, uint32_t frame) {
+    if (tail[1] != PF_MAGIC_NO) {
+        return false;
+    }
+    bool dmode = false;
+    for (int i = 2; i < FC_COM_BUF_SIZE && tail[i] != 0; ) {
+        if ((tail[i] & 0xC0) == PF_COM_VRAM && i + 2 < FC_COM_BUF_SIZE) {
+            fcPoke(tail[i], tail[i + 1], tail[i + 2], frame);
+            i += 3;
+        } else {
+            dmode |= (tail[i] == PF_COM_DMOD);
+            i++;
+        }
+    }
+    if (etail != NULL && etail[0] == PF_MAGIC_NO) {
+        for (int i = 1; i < FC_COM_EXT_SIZE && etail[i] != PF_EXT_END; ) {
+            uint8_t len = etail[i] & PF_EXT_LEN_MASK;
+            if ((etail[i] & ~PF_EXT_LEN_MASK) == PF_EXT_VRAM) {
+                for (int j = i + 1; j + 3 <= i + 1 + len && j + 3 <= FC_COM_EXT_SIZE; j += 3) {
+                    fcPoke(etail[j], etail[j + 1], etail[j + 2], frame);
+                }
+            }
+            i += 1 + len;
+        }
+    }
+    return dmode;
+}
+
+static uint32_t stat_dmode_sessions;
+static uint32_t stat_dmode_retries;
+static uint32_t stat_dmode_errors;
+static double stat_dmode_us_max;
+
+// Data mode: DRQ until PF_COM_NONE, DLD for each page of data
+static double fcDataMode(double t) {
+    double t0 = t;
+    int items = 0;
+    drq_step = 0;
+    stat_dmode_sessions++;
+
+    for (int tries = 0; tries < 16; ) {
+        fcWrite(t, FP_COM_DRQ);
+        t += opt_wait_us;
+        uint8_t head[8];
+        for (int i = 0; i < 8; i++) {
+            head[i] = fcRead(t);
+            t += DATA_CYCLES * CPU_US;
+        }
+        if (head[1] != PF_MAGIC_NO) {
+            stat_dmode_retries++;
+            tries++;
+            continue;
+        }
+        uint8_t com_dt = head[0];
+        uint16_t adr = head[2] | (head[3] << 8);
+        uint32_t size = head[4] | (head[5] << 8);
+        if (com_dt != PF_DAT_VRAM) {
+            break;
+        }
+
+        const uint8_t* expect = (adr == 0x3F00) ? pal_data : atr_data;
+        uint32_t expect_size = (adr == 0x3F00) ? sizeof(pal_data) : sizeof(atr_data);
+        bool ok = (size == expect_size) && (adr == 0x3F00 || adr == 0x23C0) && items == (adr == 0x3F00 ? 0 : 1);
+        for (uint32_t page = 0; page * 0x100 < size; page++) {
+            fcWrite(t, FP_COM_DLD);
+            fcWrite(t + 8 * CPU_US, (uint8_t)page);
+            t += opt_wait_us;
+            uint32_t n = size - page * 0x100;
+            if (n > 0x100) {
+                n = 0x100;
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                uint8_t b = fcRead(t);
+                t += DATA_CYCLES * CPU_US;
+                if (ok && b != expect[page * 0x100 + i]) {
+                    ok = false;
+                }
+            }
+        }
+        if (!ok) {
+            stat_dmode_errors++;
+        }
+        items++;
+    }
+    if (items != 2) {
+        stat_dmode_errors++;
+    }
+    if (t - t0 > stat_dmode_us_max) {
+        stat_dmode_us_max = t - t0;
+    }
+    return t;
+}
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "ep:l:j:s:S:d:w:u:r:")) != -1) {
+        switch (opt) {
+        case 'e': opt_ext = true; break;
+        case 'p': opt_pokes = atof(optarg); break;
+        case 'l': opt_irq_us = atof(optarg); break;
+        case 'j': opt_jitter_us = atof(optarg); break;
+        case 's': opt_stall = (uint32_t)atoi(optarg); break;
+        case 'S': opt_stall_us = atof(optarg); break;
+        case 'd': opt_dmode = (uint32_t)atoi(optarg); break;
+        case 'w': opt_wait_us = atof(optarg); break;
+        case 'u': opt_miss = (uint32_t)atoi(optarg); break;
+        case 'r': rnd_state = (uint32_t)atoi(optarg) | 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-e] [-p pokes] [-l us] [-j us] [-s n] [-S us] "
+                            "[-d frames] [-w us] [-u n] [-r seed] [frames]\n", argv[0]);
+            return 1;
+        }
+    }
+    uint32_t frames = (optind < argc) ? (uint32_t)atoi(argv[optind]) : 36000;
+
+    for (uint32_t i = 0; i < sizeof(pal_data); i++) {
+        pal_data[i] = (uint8_t)(i * 3 + 1) & 0x3F;
+    }
+    for (uint32_t i = 0; i < sizeof(atr_data); i++) {
+        atr_data[i] = (uint8_t)(i * 5 + 7);
+    }
+
+    fclink.init();
+    picoUpdate(0);
+
+    const double frame_us = FRAME_DOTS * DOT_US;
+    const double read_us = (240.0 * LINE_DOTS + 16) * DOT_US / PPU_READS;
+    double t_nmi = NMI_LINE * LINE_DOTS * DOT_US;
+    uint32_t frames_ok = 0, frames_bad = 0, frames_dmode = 0;
+    uint32_t shown_seq = 0;
+
+    for (cur_frame = 0; cur_frame < frames; cur_frame++) {
+        // NMI: FC_COM_BUF, then the extended area, then the key write
+        double t = t_nmi + 30 * CPU_US;
+        uint8_t tail[FC_COM_BUF_SIZE];
+        uint8_t etail[FC_COM_EXT_SIZE];
+        for (int i = 0; i < FC_COM_BUF_SIZE; i++) {
+            tail[i] = fcRead(t);
+            t += TAIL_CYCLES * CPU_US;
+        }
+        if (opt_ext) {
+            for (int i = 0; i < FC_COM_EXT_SIZE; i++) {
+                etail[i] = fcRead(t);
+                t += EXT_CYCLES * CPU_US;
+            }
+        }
+        bool dmode = fcParseTail(tail, opt_ext ? etail : NULL, cur_frame);
+        t += 20 * CPU_US;
+        fcWrite(t, 0x00);
+
+        if (dmode) {
+            // Display off until the data is in, then back to the next NMI
+            t = fcDataMode(t + 200.0);
+            fc_poke_resync = true;
+            frames_dmode++;
+            while (t_nmi < t) {
+                t_nmi += frame_us;
+            }
+            advance(t_nmi - frame_us + PRERENDER_LINE * LINE_DOTS * DOT_US);
+            continue;
+        }
+
+        // Rendering: the pre-render line fetches the first tiles
+        double t_read = t_nmi + (PRERENDER_LINE - NMI_LINE) * LINE_DOTS * DOT_US + 320 * DOT_US;
+        uint32_t seq = 0;
+        bool ok = true;
+        for (uint32_t i = 0; i < PPU_READS; i++) {
+            uint8_t b = fcRead(t_read + i * read_us);
+            if (i < 4) {
+                seq |= (uint32_t)b << (i * 8);
+            } else if (b != frameByte(seq, i)) {
+                ok = false;
+            }
+        }
+        if (ok && seq > shown_seq) {
+            frames_ok++;
+            shown_seq = seq;
+        } else {
+            frames_bad++;
+        }
+        t_nmi += frame_us;
+    }
+    advance(t_nmi);
+
+    double secs = now_us / 1e6;
+    printf("%u FC frames in %.1f s: %u shown, %u not (%u vsyncs without a frame sent), %u in data mode\n",
+           frames, secs, frames_ok, frames_bad, fclink.getFramesLost(), frames_dmode);
+    printf("link: %.1f kB/s read by the FC, %llu reads with nothing sent, %u SM_RECV overflows\n",
+           stat_reads / secs / 1000.0, (unsigned long long)stat_starved, stat_recv_overflow);
+    printf("frame + tail DMA: %llu bytes checked, %llu differ from a single buffer, "
+           "%u tails cleared in the IRQ\n",
+           (unsigned long long)stat_ref_bytes, (unsigned long long)stat_ref_diffs,
+           fclink.getTailsCleared());
+    printf("IRQ: %u, latency %.1f us average, %.1f us max\n",
+           irq_count, irq_count ? irq_latency_sum / irq_count : 0.0, irq_latency_max);
+    printf("command tail: %.1f%% used (%s), %u pokes queued, %u arrived, "
+           "%u superseded by the data mode, %u out of order\n",
+           stat_tail_room ? 100.0 * stat_tail_bytes / stat_tail_room : 0.0,
+           ext_on ? "with the extended area" : "FC_COM_BUF only",
+           poke_next, stat_pokes_ok, stat_pokes_superseded, stat_pokes_bad);
+    printf("poke latency: %.2f frames average, %u max\n",
+           stat_pokes_ok ? (double)stat_poke_latency_sum / stat_pokes_ok : 0.0,
+           stat_poke_latency_max);
+    printf("data mode: %u sessions, %u DRQ retries, %u errors, %.0f us longest\n",
+           stat_dmode_sessions, stat_dmode_retries, stat_dmode_errors, stat_dmode_us_max);
+    return (stat_pokes_bad || stat_dmode_errors || stat_ref_diffs) ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/*
+    wavecache_test.cpp - Host test for the wave type cache (rp_wavecache.h)
+
+    Checks hits and misses, the LRU replacement and that a hash collision
+    is caught by the byte compare. Then plays wave RAM patterns through
+    rp_gbapu and checks that the per-frame mapping does not classify the
+    wave, and that only wave RAM writes that change it make getWaveType()
+    classify it again.
+
+    Build: g++ -O2 -I.. wavecache_test.cpp ../rp_gbapu.cpp -o wavecache_test
+    Usage: ./wavecache_test
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rp_gbapu.h"
+#include "rp_wavecache.h"
+#include "check.h"
+
+extern rp_gbapu gbapu;
+
+void gbapuHostWrite(uint8_t reg, uint8_t value) {
+    (void)reg;
+    (void)value;
+}
+
+// Pattern n: a square wave of duty n + 1 (in 16ths), so all differ
+static void pattern(uint8_t n, uint8_t* wave) {
+    for (uint8_t i = 0; i < WAVECACHE_BYTES; i++) {
+        wave[i] = (i <= n) ? 0xFF : 0x00;
+    }
+}
+
+static uint32_t analyzed = 0;
+
+static WaveType classify(rp_wavecache& cache, const uint8_t* wave, WaveType type) {
+    return cache.classify(wave, [&]() { analyzed++; return type; });
+}
+
+static void testHitMiss() {
+    rp_wavecache cache;
+    uint8_t a[WAVECACHE_BYTES], b[WAVECACHE_BYTES];
+    pattern(0, a);
+    pattern(1, b);
+    analyzed = 0;
+
+    CHECK(classify(cache, a, WAVE_TYPE_PULSE_12) == WAVE_TYPE_PULSE_12);
+    CHECK(classify(cache, b, WAVE_TYPE_PULSE_25) == WAVE_TYPE_PULSE_25);
+    // Found: the type passed in is not used
+    CHECK(classify(cache, a, WAVE_TYPE_SAWTOOTH) == WAVE_TYPE_PULSE_12);
+    CHECK(classify(cache, b, WAVE_TYPE_SAWTOOTH) == WAVE_TYPE_PULSE_25);
+    CHECK(analyzed == 2);
+    CHECK(cache.getHits() == 2 && cache.getMisses() == 2);
+}
+
+// The least recently used pattern goes when the cache is full
+static void testLru() {
+    rp_wavecache cache;
+    uint8_t wave[WAVECACHE_BYTES];
+    for (uint8_t n = 0; n < WAVECACHE_SIZE; n++) {
+        pattern(n, wave);
+        classify(cache, wave, WAVE_TYPE_PULSE_50);
+    }
+    pattern(0, wave);
+    classify(cache, wave, WAVE_TYPE_PULSE_50);  // 1 is the oldest now
+    CHECK(cache.getHits() == 1);
+
+    pattern(WAVECACHE_SIZE, wave);
+    classify(cache, wave, WAVE_TYPE_PULSE_50);
+
+    pattern(0, wave);
+    CHECK(cache.find(wave, wavecacheHash(wave)) >= 0);
+    pattern(1, wave);
+    CHECK(cache.find(wave, wavecacheHash(wave)) < 0);
+    for (uint8_t n = 2; n <= WAVECACHE_SIZE; n++) {
+        pattern(n, wave);
+        CHECK(cache.find(wave, wavecacheHash(wave)) >= 0);
+    }
+}
+
+// Two patterns with the same hash are told apart by their bytes
+static void testCollision() {
+    rp_wavecache cache;
+    uint8_t a[WAVECACHE_BYTES], b[WAVECACHE_BYTES];
+    pattern(3, a);
+    pattern(4, b);
+    uint64_t hash = wavecacheHash(a);
+    cache.insert(a, hash, WAVE_TYPE_TRIANGLE);
+    CHECK(cache.find(b, hash) < 0);
+    CHECK(cache.find(a, hash) >= 0);
+
+    // Patterns that differ in one sample only get different hashes
+    for (uint8_t i = 0; i < WAVECACHE_BYTES; i++) {
+        memcpy(b, a, WAVECACHE_BYTES);
+        b[i] ^= 0x01;
+        CHECK(wavecacheHash(b) != hash);
+    }
+}
+
+static void writeWave(const uint8_t* wave) {
+    for (uint8_t i = 0; i < WAVECACHE_BYTES; i++) {
+        audio_write(0xFF30 + i, wave[i], 0);
+    }
+}
+
+static void frame() {
+    gbapu.updatePulsePriority(0);
+}
+
+static void testApu() {
+    gbapu.init();
+    gbapu.beginFrame(0, 0);
+    audio_write(0xFF26, 0x80, 0);
+    const rp_wavecache& cache = gbapu.getWaveCache();
+    uint32_t hits = cache.getHits();
+    uint32_t misses = cache.getMisses();
+
+    uint8_t square[WAVECACHE_BYTES], noise[WAVECACHE_BYTES];
+    for (uint8_t i = 0; i < WAVECACHE_BYTES; i++) {
+        square[i] = (i < 8) ? 0xFF : 0x00;
+        noise[i] = 0xF0;  // High and low in every byte
+    }
+    writeWave(square);
+    audio_write(0xFF1A, 0x80, 0);
+    audio_write(0xFF1C, 0x20, 0);
+    audio_write(0xFF1E, 0x87, 0);
+    frame();
+    // The mapping does not use the wave type, so it does not classify
+    CHECK(cache.getMisses() == misses && cache.getHits() == hits);
+    CHECK(gbapu.getWaveType() == WAVE_TYPE_PULSE_50);
+    CHECK(gbapu.getChannel(2).detected_wave_type == WAVE_TYPE_PULSE_50);
+    CHECK(cache.getMisses() == misses + 1);
+
+    // No wave RAM change: no lookup at all
+    audio_write(0xFF1D, 0x40, 0);
+    writeWave(square);
+    frame();
+    frame();
+    CHECK(gbapu.getWaveType() == WAVE_TYPE_PULSE_50);
+    CHECK(cache.getMisses() == misses + 1 && cache.getHits() == hits);
+
+    writeWave(noise);
+    frame();
+    CHECK(gbapu.getWaveType() == WAVE_TYPE_NOISE_LIKE);
+    CHECK(cache.getMisses() == misses + 2);
+
+    // Back to a known pattern
+    writeWave(square);
+    frame();
+    CHECK(gbapu.getWaveType() == WAVE_TYPE_PULSE_50);
+    CHECK(cache.getMisses() == misses + 2 && cache.getHits() == hits + 1);
+}
+
+int main() {
+    testHitMiss();
+    testLru();
+    testCollision();
+    testApu();
+
+    return checkResult();
+}
@@ -50,6 +50,11 @@ FC PICO では、Pico から FC へのデータ転送に PPU データストリ
   $41 = 0x60
   判定条件: $40 == 0xC0 && $41 == 0x60
 
+■ 拡張コマンド領域の有効化 (0xD0)
+  $40 = 0xD0
+  $41 = 0x70
+  判定条件: $40 == 0xD0 && $41 == 0x70
+
 【位相リセット問題と解決策】
 NES APU の $4003, $4007, $400B, $400F レジスタに書き込むと、
 対応するチャンネルの位相がリセットされる。これを毎フレーム行うと
@@ -71,12 +76,49 @@ NES APU の $4003, $4007, $400B, $400F レジスタに書き込むと、
 2. JSR $9536 (毎フレーム呼ばれる PPU 転送ルーチン) をフック
    - 元のルーチンを呼び出した後、FC_COM_BUF をチェック
    - APU コマンドであれば対応する APU レジスタに書き込み
+   - 拡張コマンド領域の APU レコードを処理
+
+3. NMI 内の FC_COM_BUF 読み込み直後 ($ED8E) をフック
+   - 拡張コマンド領域を読み込み、VRAM レコードを VBlank 中に書き込む
 
 【APU 対応 ROM の通知】
 古い FC ROM では FC_COM_BUF ($40-$4F) がワーク RAM として使用されている
 可能性があり、APU データを書き込むとクラッシュする恐れがある。
 そのため、パッチ済み ROM は起動時に Pico へ「APU 対応」を通知する。
 Pico は通知を受け取るまで APU コマンドを送信しない。
+
+【拡張コマンド領域】
+FC_COM_BUF は 16 バイトしかないため、パレットや属性の書き換えがある
+フレームでは APU データを送れなかった。
+パッチ済み ROM は 0xD0 コマンドを受け取ると、以降の NMI で FC_COM_BUF に
+続けてさらに 32 バイトを $0580-$059F に読み込む。
+Pico は 1 フレームの PPU 読み出し回数から、FC がどちらの長さで
+読んでいるかを判定する。有効化されるまで読み出し回数は変わらないため、
+他の FC PICO ソフトウェアもそのまま動作する。
+
+  $0580 = 0xFC (検証バイト。一致しなければ領域全体を無視)
+  $0581 以降 = レコードの並び。各レコードは
+        ヘッダ (上位3ビット: 種類、下位5ビット: データ長) + データ
+        ヘッダが 0x00 か領域の末尾で終了。未知の種類は長さ分読み飛ばす。
+
+  0x20 | 16: APU 全レジスタ (データは Full APU Update の 16 バイトと同じ)
+  0x40 | 0 : APU 消音
+  0x60 | 3n: VRAM 書き換え (adrH, adrL, dt) x n
+             パレット ($3Fxx) はフェード用のコピー ($0110-$012F) にも反映
+  0x80 | 3+n: APU 差分 (前回から変わったレジスタだけ)
+             3 バイトのビットマスク (ビット k = $4000+k、リトルエンディアン) に
+             続けて、立っているビットのレジスタ値を昇順に n バイト。
+             $4010-$4017 のうち書き込むのは $4015 のみ ($4014 の OAM DMA や
+             $4016/$4017 を誤って叩かないようにマスクする)。
+             $4003/$4007/$400B/$400F は Full APU Update の writeMask と同じく
+             位相リセットが必要な時だけ Pico がビットを立てる。
+
+VRAM レコードは NMI の VBlank 中 (読み込み直後) に、APU レコードは
+JSR $9536 のフックで処理する。32 バイトの読み込みと 4 件の VRAM 書き換えで
+VBlank を約 850 サイクル使う。
+音が変わらないフレームの APU 差分は 0 バイト (レコードなし)、
+1 音の変化でも 5-7 バイト程度なので、残りはパレットや属性の書き換えに使える。
+Pico は一定間隔と取りこぼしの後に APU 全レジスタを送り直す。
 """
 
 import sys
@@ -142,14 +184,308 @@ APU_NOTIFY_CMD = 0x05
 # (毎フレーム $2007 に書き込むと VRAM が壊れるため)
 APU_NOTIFY_FLAG_ZP = 0x3F
 
+# =============================================================================
+# 拡張コマンド領域
+# =============================================================================
+
+# 拡張コマンド領域の処理コードを配置する ROM アドレス
+# $D30B-$DFFF は元の ROM で未使用の空き領域
+COM_EXT_CODE_ADDR = 0xD380
+
+# フックする NMI 内の命令のアドレス
+# $ED8E: LDA #$08 / STA $2006 (FC_COM_BUF の 16 バイトを読み込んだ直後)
+COM_EXT_HOOK_ADDR = 0xED8E
+COM_EXT_HOOK_ORIGINAL = bytes([0xA9, 0x08, 0x8D, 0x06, 0x20])
+
+# 拡張コマンド領域の RAM ($0500 ページは先頭 $35 バイトのみ使用されている)
+COM_EXT_BUF = 0x0580        # $0580-$059F: 受信データ
+COM_EXT_SIZE = 32
+COM_EXT_FLAG = 0x05A0       # 0 以外: 拡張コマンド領域を読み込む
+COM_EXT_NEXT = 0x05A1       # レコード走査の作業用 (次のレコードの位置)
+COM_EXT_WORK = 0x05A2       # $05A2-$05A4: APU 差分のビットマスク (作業用)
+
+# 有効化コマンド ($40/$41)
+COM_EXT_MAGIC = 0xD0
+COM_EXT_CHECK = 0x70
+
+# 拡張コマンド領域の先頭の検証バイト
+COM_EXT_VALID = 0xFC
+
+# レコードヘッダ: 種類 (上位3ビット) | データ長 (下位5ビット)
+REC_TYPE_MASK = 0xE0
+REC_LEN_MASK = 0x1F
+REC_APU_FULL = 0x20         # データ 16 バイト (Full APU Update と同じ配置)
+REC_APU_SILENCE = 0x40      # データなし
+REC_VRAM = 0x60             # adrH, adrL, dt の繰り返し
+REC_APU_DELTA = 0x80        # ビットマスク 3 バイト + 変化したレジスタ値
+
+# APU 差分で書き込むレジスタの範囲 ($4000-$4015)
+APU_DELTA_REGS = 0x16
+# ビットマスク 3 バイト目 ($4010-$4017) のうち書き込みを許すビット ($4015)
+APU_DELTA_HI_ALLOWED = 0x20
+
+# Full APU Update のデータ配置: (データ位置, APU レジスタ下位, writeMask ビット)
+# writeMask ビットが 0 以外のレジスタは、そのビットが立っている時のみ書き込む
+APU_FULL_LAYOUT = [
+    (2, 0x0E, 0),       # Noise Mode/Period
+    (3, 0x0F, 0x08),    # Noise Length
+    (4, 0x00, 0),       # Pulse1 Duty/Volume
+    (5, 0x01, 0),       # Pulse1 Sweep
+    (6, 0x02, 0),       # Pulse1 Freq Lo
+    (7, 0x03, 0x01),    # Pulse1 Freq Hi
+    (8, 0x04, 0),       # Pulse2 Duty/Volume
+    (9, 0x05, 0),       # Pulse2 Sweep
+    (10, 0x06, 0),      # Pulse2 Freq Lo
+    (11, 0x07, 0x02),   # Pulse2 Freq Hi
+    (12, 0x08, 0),      # Triangle Linear Counter
+    (13, 0x0A, 0),      # Triangle Freq Lo
+    (14, 0x0B, 0x04),   # Triangle Freq Hi
+    (15, 0x15, 0),      # APU Status/Enable (最後に書き込む)
+]
+
+
+def emit_record_walk(code, base_addr, handlers):
+    """拡張コマンド領域のレコードを順に処理するサブルーチンを生成
+
+    各ハンドラは X = データの先頭位置で呼ばれ、COM_EXT_NEXT に次の
+    レコードの位置が入っている。X は戻った後に COM_EXT_NEXT から
+    設定し直すので、ハンドラはレジスタを保存しなくてよい。
+
+    Args:
+        code: コードのリスト (末尾に追加する)
+        base_addr: code[0] の ROM アドレス
+        handlers: [(レコード種類, ハンドラのアドレス), ...]
+    """
+    # 検証バイトが一致しなければ何もしない
+    code += bytes([0xAD, COM_EXT_BUF & 0xFF, COM_EXT_BUF >> 8])   # LDA $0580
+    code += bytes([0xC9, COM_EXT_VALID])                          # CMP #$FC
+    code += bytes([0xD0])                                         # BNE done
+    bne_done = len(code)
+    code += bytes([0x00])
+    code += bytes([0xA2, 0x01])                                   # LDX #$01
+
+    loop_addr = base_addr + len(code)
+    code += bytes([0xE0, COM_EXT_SIZE])                           # CPX #$20 (領域の末尾?)
+    code += bytes([0xB0])                                         # BCS done
+    bcs_done = len(code)
+    code += bytes([0x00])
+    code += bytes([0xBD, COM_EXT_BUF & 0xFF, COM_EXT_BUF >> 8])   # LDA $0580,X (ヘッダ)
+    code += bytes([0xF0])                                         # BEQ done (終端)
+    beq_done = len(code)
+    code += bytes([0x00])
+    code += bytes([0xE8])                                         # INX (データの先頭)
+    code += bytes([0x48])                                         # PHA
+
+    # COM_EXT_NEXT = X + データ長
+    code += bytes([0x29, REC_LEN_MASK])                           # AND #$1F
+    code += bytes([0x8E, COM_EXT_NEXT & 0xFF, COM_EXT_NEXT >> 8]) # STX $05A1
+    code += bytes([0x18])                                         # CLC
+    code += bytes([0x6D, COM_EXT_NEXT & 0xFF, COM_EXT_NEXT >> 8]) # ADC $05A1
+    code += bytes([0x8D, COM_EXT_NEXT & 0xFF, COM_EXT_NEXT >> 8]) # STA $05A1
+
+    # 種類ごとにハンドラを呼ぶ (該当しなければ読み飛ばす)
+    code += bytes([0x68])                                         # PLA
+    code += bytes([0x29, REC_TYPE_MASK])                          # AND #$E0
+    jmp_next = []
+    for rec_type, handler_addr in handlers:
+        code += bytes([0xC9, rec_type])                           # CMP #type
+        code += bytes([0xD0, 0x06])                               # BNE +6 (次の種類へ)
+        code += bytes([0x20, handler_addr & 0xFF, handler_addr >> 8])  # JSR handler
+        code += bytes([0x4C])                                     # JMP next
+        jmp_next.append(len(code))
+        code += bytes([0x00, 0x00])
+
+    # next: 次のレコードへ
+    next_addr = base_addr + len(code)
+    for lo in jmp_next:
+        code[lo] = next_addr & 0xFF
+        code[lo + 1] = next_addr >> 8
+    code += bytes([0xAE, COM_EXT_NEXT & 0xFF, COM_EXT_NEXT >> 8]) # LDX $05A1
+    code += bytes([0x4C, loop_addr & 0xFF, loop_addr >> 8])       # JMP loop
+
+    # done
+    done_offset = len(code)
+    for br in (bne_done, bcs_done, beq_done):
+        code[br] = done_offset - br - 1
+    code += bytes([0x60])                                         # RTS
+
+
+def create_com_ext_code():
+    """拡張コマンド領域用の 6502 マシンコードを生成
+
+    生成されるコードの構成:
+    1. レコードハンドラ: APU 全レジスタ、APU 差分、APU 消音、VRAM 書き換え
+    2. NMI フック: 拡張コマンド領域の読み込み → VRAM レコード処理
+    3. APU レコード処理: JSR $9536 のフックから呼ばれる
+
+    Returns:
+        tuple: (バイト列, nmi_hook_offset, apu_walk_offset)
+    """
+    code = []
+
+    # =========================================================================
+    # APU 全レジスタ (REC_APU_FULL)
+    # =========================================================================
+    #
+    # データは Full APU Update ($40-$4F) と同じ 16 バイト。
+    # X = データの先頭位置なので、$0580+n,X で n バイト目を読む。
+    #
+    apu_full_offset = len(code)
+
+    # データ 1 → $400C (Noise Volume、上位2ビットは検証用なので除去)
+    code += bytes([0xBD, (COM_EXT_BUF + 1) & 0xFF, (COM_EXT_BUF + 1) >> 8])  # LDA $0581,X
+    code += bytes([0x29, 0x3F])                                   # AND #$3F
+    code += bytes([0x8D, 0x0C, 0x40])                             # STA $400C
+
+    for n, reg, mask_bit in APU_FULL_LAYOUT:
+        if mask_bit:
+            # writeMask (データ 0 の下位4ビット) が立っている時のみ書き込む
+            code += bytes([0xBD, COM_EXT_BUF & 0xFF, COM_EXT_BUF >> 8])  # LDA $0580,X
+            code += bytes([0x29, mask_bit])                       # AND #bit
+            code += bytes([0xF0, 0x06])                           # BEQ +6 (スキップ)
+        addr = COM_EXT_BUF + n
+        code += bytes([0xBD, addr & 0xFF, addr >> 8])             # LDA $0580+n,X
+        code += bytes([0x8D, reg, 0x40])                          # STA $40xx
+    code += bytes([0x60])                                         # RTS
+
+    # =========================================================================
+    # APU 差分 (REC_APU_DELTA)
+    # =========================================================================
+    #
+    # 24 ビットのマスクを右シフトしながら Y = $00-$15 を数え、
+    # キャリーが立ったレジスタに次のデータを書き込む。
+    # STA $4000,Y はページをまたがないので、書き込み先以外を読むことはない。
+    #
+    apu_delta_offset = len(code)
+    for n in range(3):
+        work = COM_EXT_WORK + n
+        code += bytes([0xBD, (COM_EXT_BUF + n) & 0xFF, (COM_EXT_BUF + n) >> 8])  # LDA $0580+n,X
+        if n == 2:
+            code += bytes([0x29, APU_DELTA_HI_ALLOWED])           # AND #$20 ($4015 のみ)
+        code += bytes([0x8D, work & 0xFF, work >> 8])             # STA $05A2+n
+    code += bytes([0xE8, 0xE8, 0xE8])                             # INX x3 (レジスタ値の先頭)
+    code += bytes([0xA0, 0x00])                                   # LDY #$00
+
+    apu_delta_loop = len(code)
+    code += bytes([0x4E, (COM_EXT_WORK + 2) & 0xFF, (COM_EXT_WORK + 2) >> 8])  # LSR $05A4
+    code += bytes([0x6E, (COM_EXT_WORK + 1) & 0xFF, (COM_EXT_WORK + 1) >> 8])  # ROR $05A3
+    code += bytes([0x6E, COM_EXT_WORK & 0xFF, COM_EXT_WORK >> 8]) # ROR $05A2
+    code += bytes([0x90, 0x07])                                   # BCC +7 (変化なし)
+    code += bytes([0xBD, COM_EXT_BUF & 0xFF, COM_EXT_BUF >> 8])   # LDA $0580,X
+    code += bytes([0x99, 0x00, 0x40])                             # STA $4000,Y
+    code += bytes([0xE8])                                         # INX
+    code += bytes([0xC8])                                         # INY
+    code += bytes([0xC0, APU_DELTA_REGS])                         # CPY #$16
+    code += bytes([0xD0, (apu_delta_loop - (len(code) + 2)) & 0xFF])  # BNE loop
+    code += bytes([0x60])                                         # RTS
+
+    # =========================================================================
+    # APU 消音 (REC_APU_SILENCE)
+    # =========================================================================
+    apu_silence_offset = len(code)
+    code += bytes([0xA9, 0x00])                                   # LDA #$00
+    code += bytes([0x8D, 0x15, 0x40])                             # STA $4015
+    code += bytes([0x60])                                         # RTS
+
+    # =========================================================================
+    # VRAM 書き換え (REC_VRAM)
+    # =========================================================================
+    #
+    # VBlank 中に呼ばれるので、そのまま $2006/$2007 に書き込む。
+    # パレットは元の ROM ($E260) と同様に $0110 のコピーにも反映する。
+    #
+    vram_offset = len(code)
+    vram_loop_offset = len(code)
+    code += bytes([0xEC, COM_EXT_NEXT & 0xFF, COM_EXT_NEXT >> 8]) # CPX $05A1
+    code += bytes([0x90, 0x01])                                   # BCC +1
+    code += bytes([0x60])                                         # RTS (レコードの末尾)
+
+    code += bytes([0xBD, COM_EXT_BUF & 0xFF, COM_EXT_BUF >> 8])   # LDA $0580,X (adrH)
+    code += bytes([0x29, 0x3F])                                   # AND #$3F
+    code += bytes([0x8D, 0x06, 0x20])                             # STA $2006
+    code += bytes([0xA8])                                         # TAY (adrH を保存)
+    code += bytes([0xBD, (COM_EXT_BUF + 1) & 0xFF, (COM_EXT_BUF + 1) >> 8])  # LDA $0581,X (adrL)
+    code += bytes([0x8D, 0x06, 0x20])                             # STA $2006
+    code += bytes([0xBD, (COM_EXT_BUF + 2) & 0xFF, (COM_EXT_BUF + 2) >> 8])  # LDA $0582,X (dt)
+    code += bytes([0x8D, 0x07, 0x20])                             # STA $2007
+
+    # パレット ($3Fxx) ならコピーを更新
+    code += bytes([0xC0, 0x3F])                                   # CPY #$3F
+    code += bytes([0xD0, 0x0C])                                   # BNE +12
+    code += bytes([0xBD, (COM_EXT_BUF + 1) & 0xFF, (COM_EXT_BUF + 1) >> 8])  # LDA $0581,X
+    code += bytes([0x29, 0x1F])                                   # AND #$1F
+    code += bytes([0xA8])                                         # TAY
+    code += bytes([0xBD, (COM_EXT_BUF + 2) & 0xFF, (COM_EXT_BUF + 2) >> 8])  # LDA $0582,X
+    code += bytes([0x99, 0x10, 0x01])                             # STA $0110,Y
+
+    code += bytes([0xE8, 0xE8, 0xE8])                             # INX x3
+    vram_loop_addr = COM_EXT_CODE_ADDR + vram_loop_offset
+    code += bytes([0x4C, vram_loop_addr & 0xFF, vram_loop_addr >> 8])  # JMP vram_loop
+
+    # =========================================================================
+    # VBlank 中のレコード処理
+    # =========================================================================
+    vblank_walk_offset = len(code)
+    emit_record_walk(code, COM_EXT_CODE_ADDR,
+                     [(REC_VRAM, COM_EXT_CODE_ADDR + vram_offset)])
+
+    # =========================================================================
+    # NMI フック: 拡張コマンド領域の読み込み
+    # =========================================================================
+    #
+    # 元のコード ($ED8E): LDA #$08 / STA $2006
+    # パッチ後:           JSR (このフック) / NOP / NOP
+    #
+    # FC_COM_BUF の 16 バイトに続けて $2007 から 32 バイトを読み込む。
+    # X を $E0 から数え上げ、INX のゼロフラグでループを終える (1 バイト 14 サイクル)。
+    # NMI の入口で A/X/Y は保存済みなので、ここでは保存しない。
+    #
+    nmi_hook_offset = len(code)
+    code += bytes([0xAD, COM_EXT_FLAG & 0xFF, COM_EXT_FLAG >> 8]) # LDA $05A0
+    code += bytes([0xF0])                                         # BEQ skip_read (無効なら読まない)
+    beq_skip_read = len(code)
+    code += bytes([0x00])
+    code += bytes([0xA2, 0x100 - COM_EXT_SIZE])                   # LDX #$E0
+    read_base = COM_EXT_BUF - (0x100 - COM_EXT_SIZE)
+    code += bytes([0xAD, 0x07, 0x20])                             # LDA $2007
+    code += bytes([0x9D, read_base & 0xFF, read_base >> 8])       # STA $04A0,X
+    code += bytes([0xE8])                                         # INX
+    code += bytes([0xD0, 0xF7])                                   # BNE -9
+    vblank_walk_addr = COM_EXT_CODE_ADDR + vblank_walk_offset
+    code += bytes([0x20, vblank_walk_addr & 0xFF, vblank_walk_addr >> 8])  # JSR vblank_walk
+
+    # skip_read: 置き換えた元の命令
+    code[beq_skip_read] = len(code) - beq_skip_read - 1
+    code += bytes([0xA9, 0x08])                                   # LDA #$08
+    code += bytes([0x8D, 0x06, 0x20])                             # STA $2006
+    code += bytes([0x60])                                         # RTS
+
+    # =========================================================================
+    # APU レコード処理 (JSR $9536 のフックから呼ばれる)
+    # =========================================================================
+    #
+    # VBlank 外でよいので、NMI の最後で処理する。
+    # 無効な間は $0580 が 0 のままなので何もしない。
+    #
+    apu_walk_offset = len(code)
+    emit_record_walk(code, COM_EXT_CODE_ADDR,
+                     [(REC_APU_DELTA, COM_EXT_CODE_ADDR + apu_delta_offset),
+                      (REC_APU_FULL, COM_EXT_CODE_ADDR + apu_full_offset),
+                      (REC_APU_SILENCE, COM_EXT_CODE_ADDR + apu_silence_offset)])
 
-def create_apu_code():
+    return bytes(code), nmi_hook_offset, apu_walk_offset
+
+
+def create_apu_code(ext_apu_walk_addr):
     """APU 制御用の 6502 マシンコードを生成
 
     生成されるコードの構成:
     1. Reset ハンドラ: APU 初期化 → 元の Reset へジャンプ
     2. JSR フック: 元のルーチン呼び出し → APU コマンド処理 → 復帰
 
+    Args:
+        ext_apu_walk_addr: 拡張コマンド領域の APU レコード処理のアドレス
+
     Returns:
         tuple: (バイト列, new_reset_offset, jsr_hook_offset)
                new_reset_offset: 新 Reset ハンドラのオフセット
@@ -269,6 +605,23 @@ def create_apu_code():
     skip_notify_offset = len(code)
     code[bne_skip_notify] = skip_notify_offset - bne_skip_notify - 1
 
+    # =========================================================================
+    # 拡張コマンド領域の有効化 (0xD0)
+    # =========================================================================
+    #
+    # $40 == 0xD0 && $41 == 0x70 なら、次の NMI から拡張コマンド領域を読む。
+    # $40 をクリアするので、以降の APU コマンド判定はどれにも一致しない。
+    #
+    code += bytes([0xA5, FC_COM_BUF_ZP])     # LDA $40
+    code += bytes([0xC9, COM_EXT_MAGIC])     # CMP #$D0
+    code += bytes([0xD0, 0x0D])              # BNE +13 (不一致なら次へ)
+    code += bytes([0xA5, FC_COM_BUF_ZP + 1]) # LDA $41
+    code += bytes([0xC9, COM_EXT_CHECK])     # CMP #$70
+    code += bytes([0xD0, 0x07])              # BNE +7
+    code += bytes([0x8D, COM_EXT_FLAG & 0xFF, COM_EXT_FLAG >> 8])  # STA $05A0 (0x70: 有効)
+    code += bytes([0xA9, 0x00])              # LDA #$00
+    code += bytes([0x85, FC_COM_BUF_ZP])     # STA $40 (マジックバイトをクリア)
+
     # =========================================================================
     # APU コマンド判定
     # =========================================================================
@@ -545,6 +898,10 @@ def create_apu_code():
     code[jmp_skip_from_silence_lo] = skip_apu_addr & 0xFF
     code[jmp_skip_from_silence_lo + 1] = (skip_apu_addr >> 8) & 0xFF
 
+    # 拡張コマンド領域の APU レコードを処理
+    code += bytes([0x20, ext_apu_walk_addr & 0xFF,
+                   (ext_apu_walk_addr >> 8) & 0xFF])  # JSR apu_walk
+
     # レジスタを復元 (保存時と逆順)
     code += bytes([0x68])                    # PLA
     code += bytes([0xA8])                    # TAY (Y を復元)
@@ -573,17 +930,36 @@ def patch_rom(input_path, output_path):
     print(f"入力 ROM: {input_path}")
     print(f"ROM サイズ: {len(rom_data)} bytes")
 
-    # APU 制御コードを生成
-    apu_code, new_reset_offset, jsr_hook_offset = create_apu_code()
+    # 拡張コマンド領域のコードと APU 制御コードを生成
+    ext_code, nmi_hook_offset, apu_walk_offset = create_com_ext_code()
+    apu_code, new_reset_offset, jsr_hook_offset = create_apu_code(
+        COM_EXT_CODE_ADDR + apu_walk_offset)
 
     print(f"APU コードサイズ: {len(apu_code)} bytes")
     print(f"APU コード配置: ${APU_CODE_ADDR:04X}")
     print(f"新 Reset ハンドラ: ${APU_CODE_ADDR + new_reset_offset:04X}")
     print(f"JSR フック: ${APU_CODE_ADDR + jsr_hook_offset:04X}")
-
-    # APU コードを ROM の空き領域に書き込む
-    apu_code_offset = rom_to_file(APU_CODE_ADDR)
-    rom_data[apu_code_offset:apu_code_offset + len(apu_code)] = apu_code
+    print(f"拡張コマンド領域コードサイズ: {len(ext_code)} bytes")
+    print(f"拡張コマンド領域コード配置: ${COM_EXT_CODE_ADDR:04X}")
+
+    # 各コードを ROM の空き領域 ($FF) に書き込む
+    for addr, block in ((APU_CODE_ADDR, apu_code), (COM_EXT_CODE_ADDR, ext_code)):
+        offset = rom_to_file(addr)
+        if any(b != 0xFF for b in rom_data[offset:offset + len(block)]):
+            print(f"エラー: ${addr:04X} からの {len(block)} バイトは空き領域ではありません")
+            return False
+        rom_data[offset:offset + len(block)] = block
+
+    # NMI 内の LDA #$08 / STA $2006 を拡張コマンド領域の読み込みに変更
+    hook_offset = rom_to_file(COM_EXT_HOOK_ADDR)
+    if rom_data[hook_offset:hook_offset + len(COM_EXT_HOOK_ORIGINAL)] != COM_EXT_HOOK_ORIGINAL:
+        print(f"エラー: ${COM_EXT_HOOK_ADDR:04X} の命令が想定と異なります")
+        return False
+    nmi_hook_addr = COM_EXT_CODE_ADDR + nmi_hook_offset
+    rom_data[hook_offset:hook_offset + 5] = bytes([
+        0x20, nmi_hook_addr & 0xFF, (nmi_hook_addr >> 8) & 0xFF,  # JSR nmi_hook
+        0xEA, 0xEA])                                              # NOP, NOP
+    print(f"NMI @ ${COM_EXT_HOOK_ADDR:04X}: LDA #$08 / STA $2006 → JSR ${nmi_hook_addr:04X}")
 
     # Reset ベクタ ($FFFC-$FFFD) を新しいハンドラに変更
     new_reset_addr = APU_CODE_ADDR + new_reset_offset
@@ -610,11 +986,12 @@ def patch_rom(input_path, output_path):
 
     # デバッグ: パッチ部分をダンプ
     print("\n--- パッチ部分のダンプ ---")
-    for i in range(0, len(apu_code), 16):
-        addr = APU_CODE_ADDR + i
-        chunk = apu_code[i:i+16]
-        hex_str = ' '.join(f'{b:02X}' for b in chunk)
-        print(f"${addr:04X}: {hex_str}")
+    for base, block in ((APU_CODE_ADDR, apu_code), (COM_EXT_CODE_ADDR, ext_code)):
+        for i in range(0, len(block), 16):
+            addr = base + i
+            chunk = block[i:i+16]
+            hex_str = ' '.join(f'{b:02X}' for b in chunk)
+            print(f"${addr:04X}: {hex_str}")
 
     return True
 